@@ -11,13 +11,16 @@ License:        GPLv2+
 URL:            https://github.com/altlinux/ALTMediaWriter
 Source:         %oname-%version.tar
 
+BuildRequires:  bzlib-devel
 BuildRequires:  libGConf
 BuildRequires:  libappstream-glib
 BuildRequires:  liblzma-devel
 BuildRequires:  libnss-mdns
 BuildRequires:  libyaml-cpp-devel
+BuildRequires:  libzstd-devel
 BuildRequires:  qt5-declarative-devel
 BuildRequires:  qt5-x11extras-devel
+BuildRequires:  zlib-devel
 
 Requires:       qt5-quickcontrols
 Requires:       qt5-quickcontrols2
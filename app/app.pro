@@ -4,46 +4,11 @@ include($$top_srcdir/deployment.pri)
 
 TARGET = $$MEDIAWRITER_NAME
 
-QT += qml quick widgets network
-
-LIBS += -lisomd5
-linux {
-    LIBS += -lyaml-cpp
-}
-windows {
-    # NOTE: "-lyaml-cpp" ignores static linking option and links to dynamic "yaml.cpp.dll.a", so have to manually link to static file
-    LIBS += -l:libyaml-cpp.a
-}
+include(sources.pri)
 
 CONFIG += c++11
 
-HEADERS += \
-    drivemanager.h \
-    releasemanager.h \
-    network.h \
-    notifications.h \
-    image_download.h \
-    progress.h \
-    file_type.h \
-    architecture.h \
-    release.h \
-    release_model.h \
-    units.h \
-    variant.h
-
-SOURCES += main.cpp \
-    drivemanager.cpp \
-    releasemanager.cpp \
-    network.cpp \
-    notifications.cpp \
-    image_download.cpp \
-    progress.cpp \
-    file_type.cpp \
-    architecture.cpp \
-    release.cpp \
-    release_model.cpp \
-    units.cpp \
-    variant.cpp
+SOURCES += main.cpp
 
 RESOURCES += qml.qrc \
     assets.qrc \
@@ -65,11 +30,6 @@ target.path = $$BINDIR
 INSTALLS += target
 
 linux {
-    QT += dbus x11extras
-
-    HEADERS += linuxdrivemanager.h
-    SOURCES += linuxdrivemanager.cpp
-
     icon.path = "$$DATADIR/icons/hicolor"
     icon.files = assets/icon/16x16 \
                  assets/icon/22x22 \
@@ -88,12 +48,8 @@ linux {
     INSTALLS += icon desktopfile appdatafile
 }
 win32 {
-    HEADERS += windrivemanager.h
-    SOURCES += windrivemanager.cpp
     RESOURCES += windowsicon.qrc
 
-    LIBS += -ldbghelp
-
     # Until I find out how (or if it's even possible at all) to run a privileged process from an unprivileged one, the main binary will be privileged too
     DISTFILES += windows.manifest
     QMAKE_MANIFEST = $${PWD}/windows.manifest
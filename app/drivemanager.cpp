@@ -28,11 +28,16 @@
 #include "linuxdrivemanager.h"
 #endif // __linux__
 
+#ifdef WITH_UDEV
+#include "udevdrivemanager.h"
+#endif // WITH_UDEV
+
 #ifdef _WIN32
 #include "windrivemanager.h"
 #endif // _WIN32
 
 #include <QFile>
+#include <QSettings>
 #include <QtQml>
 
 // NOTE: when installed, helper will be in the same directory as the mediawriter executable, so this is just for running from a build directory where they are in separate dirs.
@@ -227,6 +232,13 @@ DriveProvider *DriveProvider::create(DriveManager *parent) {
 #endif // _WIN32
 
 #ifdef __linux__
+#ifdef WITH_UDEV
+    const QString backend = QSettings().value("Drives/backend", "udisks").toString();
+    if (backend == "udev") {
+        return new UdevDriveProvider(parent);
+    }
+#endif // WITH_UDEV
+
     return new LinuxDriveProvider(parent);
 #endif // linux
 }
@@ -253,6 +265,14 @@ Drive::Drive(DriveProvider *parent, const QString &name, const uint64_t size, co
         }
     }();
     m_variant = nullptr;
+
+    m_probeStatus = NOT_PROBED;
+    m_readSpeed = 0;
+    m_writeSpeed = 0;
+    m_randomReadSpeed = 0;
+    m_randomWriteSpeed = 0;
+    m_fakeCapacity = false;
+    m_ioErrors = false;
 }
 
 Progress *Drive::progress() const {
@@ -295,6 +315,38 @@ Drive::RestoreStatus Drive::restoreStatus() {
     return m_restoreStatus;
 }
 
+Drive::ProbeStatus Drive::probeStatus() const {
+    return m_probeStatus;
+}
+
+qreal Drive::readSpeed() const {
+    return m_readSpeed;
+}
+
+qreal Drive::writeSpeed() const {
+    return m_writeSpeed;
+}
+
+qreal Drive::randomReadSpeed() const {
+    return m_randomReadSpeed;
+}
+
+qreal Drive::randomWriteSpeed() const {
+    return m_randomWriteSpeed;
+}
+
+bool Drive::fakeCapacity() const {
+    return m_fakeCapacity;
+}
+
+bool Drive::ioErrors() const {
+    return m_ioErrors;
+}
+
+// NOTE: probing is only implemented on linux
+void Drive::probe() {
+}
+
 bool Drive::write(Variant *variant) {
     m_variant = variant;
     m_variant->setErrorString(QString());
@@ -141,6 +141,13 @@ protected:
  * @property name name of the drive, should be human-readable, in ideal case the model of the drive and its size
  * @property size the size of the drive, in bytes
  * @property restoreStatus the status of restoring the drive
+ * @property probeStatus the status of measuring speed and capacity of the drive
+ * @property readSpeed sequential read speed, in MB/s
+ * @property writeSpeed sequential write speed, in MB/s
+ * @property randomReadSpeed read speed of small blocks at random offsets, in MB/s
+ * @property randomWriteSpeed write speed of small blocks at random offsets, in MB/s
+ * @property fakeCapacity true if the drive is smaller than it reports
+ * @property ioErrors true if reading or writing failed during the probe
  */
 class Drive : public QObject {
     Q_OBJECT
@@ -150,6 +157,14 @@ class Drive : public QObject {
     Q_PROPERTY(QString readableSize READ readableSize CONSTANT)
     Q_PROPERTY(qreal size READ size CONSTANT)
     Q_PROPERTY(RestoreStatus restoreStatus READ restoreStatus NOTIFY restoreStatusChanged)
+
+    Q_PROPERTY(ProbeStatus probeStatus READ probeStatus NOTIFY probeChanged)
+    Q_PROPERTY(qreal readSpeed READ readSpeed NOTIFY probeChanged)
+    Q_PROPERTY(qreal writeSpeed READ writeSpeed NOTIFY probeChanged)
+    Q_PROPERTY(qreal randomReadSpeed READ randomReadSpeed NOTIFY probeChanged)
+    Q_PROPERTY(qreal randomWriteSpeed READ randomWriteSpeed NOTIFY probeChanged)
+    Q_PROPERTY(bool fakeCapacity READ fakeCapacity NOTIFY probeChanged)
+    Q_PROPERTY(bool ioErrors READ ioErrors NOTIFY probeChanged)
 public:
     enum RestoreStatus {
         CLEAN = 0,
@@ -160,6 +175,14 @@ public:
     };
     Q_ENUMS(RestoreStatus)
 
+    enum ProbeStatus {
+        NOT_PROBED = 0,
+        PROBING,
+        PROBED,
+        PROBE_ERROR,
+    };
+    Q_ENUMS(ProbeStatus)
+
     Drive(DriveProvider *parent, const QString &name, const uint64_t size, const bool containsLive = false);
 
     Progress *progress() const;
@@ -171,9 +194,18 @@ public:
     virtual qreal size() const;
     virtual RestoreStatus restoreStatus();
 
+    ProbeStatus probeStatus() const;
+    qreal readSpeed() const;
+    qreal writeSpeed() const;
+    qreal randomReadSpeed() const;
+    qreal randomWriteSpeed() const;
+    bool fakeCapacity() const;
+    bool ioErrors() const;
+
     Q_INVOKABLE virtual bool write(Variant *variant);
     Q_INVOKABLE virtual void cancel();
     Q_INVOKABLE virtual void restore() = 0;
+    Q_INVOKABLE virtual void probe();
 
     bool operator==(const Drive &other) const;
 
@@ -182,6 +214,7 @@ public slots:
 
 signals:
     void restoreStatusChanged();
+    void probeChanged();
 
 protected:
     Variant *m_variant;
@@ -190,6 +223,14 @@ protected:
     uint64_t m_size;
     RestoreStatus m_restoreStatus;
     QString m_error;
+
+    ProbeStatus m_probeStatus;
+    qreal m_readSpeed;
+    qreal m_writeSpeed;
+    qreal m_randomReadSpeed;
+    qreal m_randomWriteSpeed;
+    bool m_fakeCapacity;
+    bool m_ioErrors;
 };
 
 #endif // DRIVEMANAGER_H
@@ -2,6 +2,9 @@
 #include "file_type.h"
 
 #include <QObject>
+#include <QPair>
+
+#include <algorithm>
 
 const QList<FileType> file_type_all = []() {
     QList<FileType> out;
@@ -23,6 +26,8 @@ QStringList file_type_strings(const FileType file_type) {
         case FileType_IMG: return {"img"};
         case FileType_IMG_GZ: return {"igz", "img.gz"};
         case FileType_IMG_XZ: return {"ixz", "img.xz"};
+        case FileType_IMG_ZST: return {"izst", "img.zst"};
+        case FileType_IMG_BZ2: return {"ibz2", "img.bz2"};
         case FileType_RECOVERY_TAR: return {"trc", "recovery.tar"};
         case FileType_UNKNOWN: return {};
         case FileType_COUNT: return {};
@@ -39,6 +44,8 @@ QString file_type_name(const FileType file_type) {
         case FileType_IMG: return QObject::tr("IMG");
         case FileType_IMG_GZ: return QObject::tr("GZIP IMG");
         case FileType_IMG_XZ: return QObject::tr("LZMA IMG");
+        case FileType_IMG_ZST: return QObject::tr("ZSTD IMG");
+        case FileType_IMG_BZ2: return QObject::tr("BZIP2 IMG");
         case FileType_RECOVERY_TAR: return QObject::tr("Recovery TAR Archive");
         case FileType_UNKNOWN: return QObject::tr("Unknown");
         case FileType_COUNT: return QString();
@@ -47,25 +54,90 @@ QString file_type_name(const FileType file_type) {
 }
 
 FileType file_type_from_filename(const QString &filename) {
-    FileType matching_type = FileType_UNKNOWN;
-    QString matching_string = QString();
+    // NOTE: strings are sorted from longest to shortest,
+    // so that the first match is the longest one, for
+    // cases like ".tar" and "recovery.tar"
+    static const QList<QPair<QString, FileType>> sorted_strings = []() {
+        QList<QPair<QString, FileType>> out;
+
+        for (const FileType &type : file_type_all) {
+            for (const QString &string : file_type_strings(type)) {
+                out.append({string, type});
+            }
+        }
 
-    for (const FileType &type : file_type_all) {
-        const QStringList strings = file_type_strings(type);
+        std::stable_sort(out.begin(), out.end(),
+            [](const QPair<QString, FileType> &a, const QPair<QString, FileType> &b) {
+                return a.first.length() > b.first.length();
+            });
 
-        for (const QString string : strings) {
-            // NOTE: need to select the longest string for cases like ".tar" and "recovery.tar"
-            const bool string_matches = filename.endsWith(string, Qt::CaseInsensitive);
-            const bool this_string_is_longer = (string.length() > matching_string.length());
+        return out;
+    }();
 
-            if (string_matches && this_string_is_longer) {
-                matching_type = type;
-                matching_string = string;
-            }
+    for (const QPair<QString, FileType> &pair : sorted_strings) {
+        if (filename.endsWith(pair.first, Qt::CaseInsensitive)) {
+            return pair.second;
+        }
+    }
+
+    return FileType_UNKNOWN;
+}
+
+FileType file_type_from_file(const QString &path) {
+    const FileType name_type = file_type_from_filename(path);
+    const ImageFormat format = image_format_from_file(path);
+
+    if (format == ImageFormat_UNKNOWN) {
+        return name_type;
+    }
+
+    // NOTE: archives and images can't be told apart by
+    // contents, so keep the type from the name if it has
+    // the same compression as the contents
+    const ImageFormat content_compression = [&]() {
+        if (image_format_is_compressed(format)) {
+            return format;
+        } else {
+            return ImageFormat_UNKNOWN;
         }
+    }();
+    if (name_type != FileType_UNKNOWN && file_type_compression(name_type) == content_compression) {
+        return name_type;
+    }
+
+    switch (format) {
+        case ImageFormat_XZ: return FileType_IMG_XZ;
+        case ImageFormat_GZIP: return FileType_IMG_GZ;
+        case ImageFormat_ZSTD: return FileType_IMG_ZST;
+        case ImageFormat_BZIP2: return FileType_IMG_BZ2;
+        case ImageFormat_ISO9660: return FileType_ISO;
+        case ImageFormat_GPT: return FileType_IMG;
+        case ImageFormat_MBR: return FileType_IMG;
+        case ImageFormat_UNKNOWN: return name_type;
     }
+    return name_type;
+}
 
-    return matching_type;
+ImageFormat file_type_compression(const FileType file_type) {
+    switch (file_type) {
+        case FileType_TAR_GZ: return ImageFormat_GZIP;
+        case FileType_TAR_XZ: return ImageFormat_XZ;
+        case FileType_IMG_GZ: return ImageFormat_GZIP;
+        case FileType_IMG_XZ: return ImageFormat_XZ;
+        case FileType_IMG_ZST: return ImageFormat_ZSTD;
+        case FileType_IMG_BZ2: return ImageFormat_BZIP2;
+        default: return ImageFormat_UNKNOWN;
+    }
+}
+
+bool file_type_is_archive(const FileType file_type) {
+    switch (file_type) {
+        case FileType_TAR: return true;
+        case FileType_TAR_GZ: return true;
+        case FileType_TAR_XZ: return true;
+        case FileType_RECOVERY_TAR: return true;
+        default: return false;
+    }
 }
 
 bool file_type_can_write(const FileType file_type) {
@@ -73,6 +145,16 @@ bool file_type_can_write(const FileType file_type) {
         FileType_ISO,
         FileType_IMG,
         FileType_IMG_XZ,
+#ifdef __linux__
+        // NOTE: only linux helper can decompress these
+        FileType_IMG_GZ,
+        FileType_IMG_ZST,
+        FileType_IMG_BZ2,
+        FileType_TAR,
+        FileType_TAR_GZ,
+        FileType_TAR_XZ,
+        FileType_RECOVERY_TAR,
+#endif // __linux__
     };
 
     return supported_file_types.contains(file_type);
@@ -26,6 +26,8 @@
 #include <QList>
 #include <QString>
 
+#include "imageformat/imageformat.h"
+
 enum FileType {
     FileType_ISO,
     FileType_TAR,
@@ -34,6 +36,8 @@ enum FileType {
     FileType_IMG,
     FileType_IMG_GZ,
     FileType_IMG_XZ,
+    FileType_IMG_ZST,
+    FileType_IMG_BZ2,
     FileType_RECOVERY_TAR,
     FileType_UNKNOWN,
     FileType_COUNT,
@@ -44,6 +48,13 @@ extern const QList<FileType> file_type_all;
 QStringList file_type_strings(const FileType file_type);
 QString file_type_name(const FileType file_type);
 FileType file_type_from_filename(const QString &filename);
+// Detects type from file contents, falls back to name
+FileType file_type_from_file(const QString &path);
+// Returns compression of the type, unknown if none
+ImageFormat file_type_compression(const FileType file_type);
+// Archives are extracted onto a new filesystem instead of
+// being written as is
+bool file_type_is_archive(const FileType file_type);
 bool file_type_can_write(const FileType file_type);
 
 #endif // FILE_TYPE_H
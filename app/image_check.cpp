@@ -0,0 +1,109 @@
+/*
+ * ALT Media Writer
+ * Copyright (C) 2016-2019 Martin Bříza <mbriza@redhat.com>
+ * Copyright (C) 2020-2022 Dmitry Degtyarev <kevl@basealt.ru>
+ *
+ * ALT Media Writer is a fork of Fedora Media Writer
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "image_check.h"
+
+#include <QDebug>
+#include <QFile>
+#include <QTimer>
+
+ImageCheck::ImageCheck(const QString &filePath_arg, const QString &md5sum_arg)
+: QObject()
+, hash(QCryptographicHash::Md5) {
+    md5sum = md5sum_arg;
+    wasCancelled = false;
+    m_passed = false;
+
+    qDebug() << this->metaObject()->className() << "created for" << filePath_arg;
+
+    file = new QFile(filePath_arg, this);
+
+    QTimer::singleShot(0, this,
+        [this]() {
+            const bool open_success = file->open(QIODevice::ReadOnly);
+            if (open_success) {
+                emit progressMaxChanged(file->size());
+
+                computeMd5();
+            } else {
+                qDebug() << this->metaObject()->className() << "Failed to open file for md5 check";
+
+                finish(false);
+            }
+        });
+}
+
+bool ImageCheck::passed() const {
+    return m_passed;
+}
+
+void ImageCheck::cancel() {
+    if (wasCancelled) {
+        return;
+    }
+
+    qDebug() << this->metaObject()->className() << "Cancelling check";
+
+    wasCancelled = true;
+    deleteLater();
+}
+
+void ImageCheck::computeMd5() {
+    if (wasCancelled) {
+        return;
+    }
+
+    const QByteArray bytes = file->read(1024L * 1024L);
+    const bool read_success = (bytes.size() > 0);
+
+    if (read_success) {
+        hash.addData(bytes);
+        emit progress(file->pos());
+
+        if (file->atEnd()) {
+            const QString computedMd5 = QString(hash.result().toHex());
+            const bool checkPassed = (computedMd5 == md5sum);
+
+            if (!checkPassed) {
+                qDebug() << "MD5 mismatch for" << file->fileName();
+                qDebug() << "sum should be =" << md5sum;
+                qDebug() << "computed sum  =" << computedMd5;
+            }
+
+            finish(checkPassed);
+        } else {
+            QTimer::singleShot(0, this, &ImageCheck::computeMd5);
+        }
+    } else {
+        finish(false);
+    }
+}
+
+void ImageCheck::finish(const bool passed_arg) {
+    m_passed = passed_arg;
+
+    file->close();
+
+    emit finished();
+
+    deleteLater();
+}
@@ -0,0 +1,72 @@
+/*
+ * ALT Media Writer
+ * Copyright (C) 2016-2019 Martin Bříza <mbriza@redhat.com>
+ * Copyright (C) 2020-2022 Dmitry Degtyarev <kevl@basealt.ru>
+ *
+ * ALT Media Writer is a fork of Fedora Media Writer
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef IMAGE_CHECK_H
+#define IMAGE_CHECK_H
+
+#include <QCryptographicHash>
+#include <QObject>
+
+/**
+ * @brief The ImageCheck class
+ *
+ * Computes the md5 sum of an image that is already on disk
+ * and compares it to the expected sum. Hashing is done in
+ * chunks on the event loop so that the UI stays
+ * responsive. Deletes itself when finished.
+ */
+
+class QFile;
+
+class ImageCheck final : public QObject {
+    Q_OBJECT
+
+public:
+    ImageCheck(const QString &filePath_arg, const QString &md5sum_arg);
+
+    bool passed() const;
+
+signals:
+    void progress(const qint64 value);
+    void progressMaxChanged(const qint64 value);
+
+    // Emitted when check is finished. Not emitted if
+    // check was cancelled.
+    void finished();
+
+public slots:
+    void cancel();
+
+private slots:
+    void computeMd5();
+
+private:
+    QString md5sum;
+    QFile *file;
+    bool wasCancelled;
+    bool m_passed;
+    QCryptographicHash hash;
+
+    void finish(const bool passed_arg);
+};
+
+#endif // IMAGE_CHECK_H
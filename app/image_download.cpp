@@ -30,15 +30,30 @@
 #include <QStorageInfo>
 #include <QTimer>
 
+const int ZSYNC_FILTER_SIZE = 1 << 20;
+// NOTE: seed is scanned on the GUI thread, so chunks are
+// kept small
+const qint64 ZSYNC_SCAN_CHUNK = 1L * 1024L * 1024L;
+// Missing ranges that are closer than this are downloaded
+// together, re-downloading known blocks in between is
+// cheaper than another round trip
+const qint64 ZSYNC_RANGE_GAP = 256L * 1024L;
+const int ZSYNC_PARALLEL_RANGES = 4;
+
 ImageDownload::ImageDownload(const QUrl &url_arg, const QString &filePath_arg, const QString &md5sum_arg)
 : QObject()
-, hash(QCryptographicHash::Md5) {
+, hash(QCryptographicHash::Md5)
+, sha1Hash(QCryptographicHash::Sha1) {
     url = url_arg;
     filePath = filePath_arg;
     md5sum = md5sum_arg;
     file = nullptr;
     startingImageDownload = false;
     wasCancelled = false;
+    deltaMode = false;
+    seedFile = nullptr;
+    seedOffset = 0;
+    knownBytes = 0;
 
     qDebug() << this->metaObject()->className() << "created for" << url;
 
@@ -48,7 +63,14 @@ ImageDownload::ImageDownload(const QUrl &url_arg, const QString &filePath_arg, c
     file = new QFile(tempFilePath, this);
     file->open(QIODevice::WriteOnly | QIODevice::Append);
 
-    startImageDownload();
+    // NOTE: delta download is only attempted for fresh
+    // downloads, partial downloads are resumed normally
+    seedPath = zsync_find_seed(filePath);
+    if (file->size() == 0 && !seedPath.isEmpty()) {
+        startDeltaDownload();
+    } else {
+        startImageDownload();
+    }
 }
 
 ImageDownload::Result ImageDownload::result() const {
@@ -131,16 +153,7 @@ void ImageDownload::onImageDownloadFinished() {
 
             rename_to_final_name();
         } else {
-            file->close();
-            const bool open_success = file->open(QIODevice::ReadOnly);
-            if (open_success) {
-                emit startedMd5Check();
-                QTimer::singleShot(0, this, &ImageDownload::computeMd5);
-            } else {
-                qDebug() << this->metaObject()->className() << "Failed to open file for md5 check";
-
-                finish(ImageDownload::Md5CheckFail);
-            }
+            startMd5Check();
         }
     } else {
         qDebug() << "Download was interrupted by an error:" << reply->errorString();
@@ -160,29 +173,38 @@ void ImageDownload::computeMd5() {
         return;
     }
 
+    const bool use_sha1 = md5sum.isEmpty();
+    QCryptographicHash &check_hash = (use_sha1 ? sha1Hash : hash);
+    const QString expected_sum = (use_sha1 ? QString(zsync.sha1) : md5sum);
+    const QString hash_name = (use_sha1 ? "SHA-1" : "MD5");
+
     const QByteArray bytes = file->read(64L * 1024L);
     const bool read_success = (bytes.size() > 0);
 
     if (read_success) {
-        hash.addData(bytes);
+        check_hash.addData(bytes);
         emit progress(file->pos());
 
         if (file->atEnd()) {
-            const QByteArray sum_bytes = hash.result().toHex();
-            const QString computedMd5 = QString(sum_bytes);
+            const QByteArray sum_bytes = check_hash.result().toHex();
+            const QString computed_sum = QString(sum_bytes);
 
-            const bool checkPassed = (computedMd5 == md5sum);
+            const bool checkPassed = (computed_sum == expected_sum);
 
             if (checkPassed) {
-                qDebug() << "MD5 check passed";
+                qDebug() << hash_name << "check passed";
 
                 rename_to_final_name();
             } else {
-                qDebug() << "MD5 mismatch";
-                qDebug() << "sum should be =" << md5sum;
-                qDebug() << "computed sum  =" << computedMd5;
+                qDebug() << hash_name << "mismatch";
+                qDebug() << "sum should be =" << expected_sum;
+                qDebug() << "computed sum  =" << computed_sum;
 
-                finish(ImageDownload::Md5CheckFail);
+                if (deltaMode) {
+                    fallbackToFullDownload();
+                } else {
+                    finish(ImageDownload::Md5CheckFail);
+                }
             }
         } else {
             QTimer::singleShot(0, this, &ImageDownload::computeMd5);
@@ -217,6 +239,376 @@ void ImageDownload::startImageDownload() {
         reply, &QNetworkReply::abort);
 }
 
+void ImageDownload::startMd5Check() {
+    file->close();
+    const bool open_success = file->open(QIODevice::ReadOnly);
+    if (open_success) {
+        emit startedMd5Check();
+        QTimer::singleShot(0, this, &ImageDownload::computeMd5);
+    } else {
+        qDebug() << this->metaObject()->className() << "Failed to open file for md5 check";
+
+        finish(ImageDownload::Md5CheckFail);
+    }
+}
+
+void ImageDownload::startDeltaDownload() {
+    const QString zsyncUrl = url.toString() + ".zsync";
+
+    qDebug() << this->metaObject()->className() << "Attempting delta download using" << zsyncUrl << "and seed" << seedPath;
+
+    startingImageDownload = true;
+
+    QNetworkReply *reply = makeNetworkRequest(zsyncUrl, 30000);
+
+    connect(
+        reply, &QNetworkReply::finished,
+        this, &ImageDownload::onZsyncDownloaded);
+    connect(
+        this, &ImageDownload::cancelled,
+        reply, &QNetworkReply::abort);
+}
+
+void ImageDownload::onZsyncDownloaded() {
+    QNetworkReply *reply = qobject_cast<QNetworkReply *>(sender());
+    reply->deleteLater();
+
+    if (wasCancelled) {
+        return;
+    }
+
+    const bool parse_success = [&]() {
+        if (reply->error() != QNetworkReply::NoError) {
+            qDebug() << this->metaObject()->className() << "No zsync file:" << reply->errorString();
+            return false;
+        }
+
+        return zsync_parse(reply->readAll(), &zsync);
+    }();
+
+    if (!parse_success) {
+        startImageDownload();
+        return;
+    }
+
+    // NOTE: blocks from the seed are only matched by their
+    // checksums, a false match would silently corrupt the
+    // image, so assembled image has to be checked against
+    // a whole file hash
+    if (md5sum.isEmpty() && zsync.sha1.isEmpty()) {
+        qDebug() << this->metaObject()->className() << "No md5sum or SHA-1 to check the assembled image, downloading whole image";
+        startImageDownload();
+        return;
+    }
+
+    seedFile = new QFile(seedPath, this);
+    const bool seed_open_success = seedFile->open(QIODevice::ReadOnly);
+
+    // NOTE: reopen without append because blocks are
+    // written out of order
+    file->close();
+    const bool file_open_success = file->open(QIODevice::ReadWrite) && file->resize(zsync.length);
+
+    if (!seed_open_success || !file_open_success) {
+        qDebug() << this->metaObject()->className() << "Failed to prepare files for delta download";
+        fallbackToFullDownload();
+        return;
+    }
+
+    deltaMode = true;
+
+    // NOTE: with sequential matches, the last block has
+    // no next block to check, so it's always downloaded
+    const quint32 mask = zsync_rsum_mask(zsync);
+    const int block_count = zsync.rsums.size();
+    const int lookup_count = block_count - (zsync.seqMatches - 1);
+    zsyncLookup.clear();
+    zsyncFilter = QBitArray(ZSYNC_FILTER_SIZE);
+    for (int i = 0; i < lookup_count; i++) {
+        const quint32 next_rsum = (zsync.seqMatches > 1) ? zsync.rsums[i + 1] : 0;
+        const quint64 key = zsyncKey(zsync.rsums[i] & mask, next_rsum & mask);
+
+        zsyncLookup[key].append(i);
+        zsyncFilter.setBit(key % ZSYNC_FILTER_SIZE);
+    }
+    blockIsKnown = QVector<bool>(zsync.rsums.size(), false);
+    knownBytes = 0;
+    seedOffset = 0;
+
+    startingImageDownload = false;
+    emit progressMaxChanged(zsync.length);
+    emit started();
+
+    QTimer::singleShot(0, this, &ImageDownload::scanSeed);
+}
+
+quint64 ImageDownload::zsyncKey(const quint32 rsum, const quint32 next_rsum) const {
+    return ((quint64) rsum << 32) | next_rsum;
+}
+
+// Look for blocks of the new image in the seed. Seed is
+// scanned in chunks so that UI stays responsive. If the
+// zsync file requires sequential matches, rsum of the
+// following block has to match too, which rules out most
+// false candidates before the strong checksum.
+void ImageDownload::scanSeed() {
+    if (wasCancelled) {
+        return;
+    }
+
+    const int block_size = zsync.blockSize;
+    const int window = block_size * zsync.seqMatches;
+    const quint32 mask = zsync_rsum_mask(zsync);
+
+    seedFile->seek(seedOffset);
+    const QByteArray chunk = seedFile->read(ZSYNC_SCAN_CHUNK + window);
+    const uchar *data = (const uchar *) chunk.constData();
+
+    qint64 pos = 0;
+    bool rsum_is_valid = false;
+    quint32 rsum = 0;
+    quint32 next_rsum = 0;
+
+    while (pos < ZSYNC_SCAN_CHUNK && pos + window <= chunk.size()) {
+        if (rsum_is_valid) {
+            rsum = zsync_rsum_roll(rsum, data[pos - 1], data[pos + block_size - 1], zsync.blockShift);
+            if (zsync.seqMatches > 1) {
+                next_rsum = zsync_rsum_roll(next_rsum, data[pos + block_size - 1], data[pos + 2 * block_size - 1], zsync.blockShift);
+            }
+        } else {
+            rsum = zsync_rsum(data + pos, block_size);
+            if (zsync.seqMatches > 1) {
+                next_rsum = zsync_rsum(data + pos + block_size, block_size);
+            }
+            rsum_is_valid = true;
+        }
+
+        const quint64 key = zsyncKey(rsum & mask, next_rsum & mask);
+
+        const int matching_block = [&]() {
+            if (!zsyncFilter.testBit(key % ZSYNC_FILTER_SIZE) || !zsyncLookup.contains(key)) {
+                return -1;
+            }
+
+            const QByteArray checksum = zsync_checksum(zsync, data + pos, block_size);
+
+            for (const int block : zsyncLookup[key]) {
+                if (!blockIsKnown[block] && zsync.checksums[block] == checksum) {
+                    return block;
+                }
+            }
+
+            return -1;
+        }();
+
+        if (matching_block != -1) {
+            // Copy all blocks with same contents, there
+            // can be many of them, for example zero blocks
+            const QByteArray checksum = zsync.checksums[matching_block];
+            for (const int block : zsyncLookup[key]) {
+                if (blockIsKnown[block] || zsync.checksums[block] != checksum) {
+                    continue;
+                }
+
+                const qint64 offset = (qint64) block * block_size;
+                const qint64 len = qMin((qint64) block_size, zsync.length - offset);
+
+                file->seek(offset);
+                const qint64 write_result = file->write((const char *) data + pos, len);
+                if (write_result != len) {
+                    qDebug() << this->metaObject()->className() << "Failed to write seed block";
+                    fallbackToFullDownload();
+                    return;
+                }
+
+                blockIsKnown[block] = true;
+                knownBytes += len;
+            }
+
+            pos += block_size;
+            rsum_is_valid = false;
+        } else {
+            pos++;
+        }
+    }
+
+    seedOffset += pos;
+    emit progress(knownBytes);
+
+    const bool scan_finished = (chunk.size() < ZSYNC_SCAN_CHUNK + window || knownBytes == zsync.length);
+
+    if (!scan_finished) {
+        QTimer::singleShot(0, this, &ImageDownload::scanSeed);
+        return;
+    }
+
+    seedFile->close();
+
+    // Merge missing blocks into ranges
+    missingRanges.clear();
+    for (int block = 0; block < blockIsKnown.size(); block++) {
+        if (blockIsKnown[block]) {
+            continue;
+        }
+
+        const qint64 start = (qint64) block * block_size;
+        const qint64 end = qMin(start + block_size, zsync.length);
+
+        if (!missingRanges.isEmpty() && start - missingRanges.last().second <= ZSYNC_RANGE_GAP) {
+            missingRanges.last().second = end;
+        } else {
+            missingRanges.append(qMakePair(start, end));
+        }
+    }
+
+    // NOTE: merged ranges can include known blocks, they
+    // are downloaded again and counted in progress as such
+    const qint64 reused_bytes = knownBytes;
+    qint64 range_bytes = 0;
+    for (const QPair<qint64, qint64> &range : missingRanges) {
+        range_bytes += (range.second - range.first);
+    }
+    knownBytes = zsync.length - range_bytes;
+    emit progress(knownBytes);
+
+    qDebug() << this->metaObject()->className() << "Reused" << reused_bytes << "bytes from seed, downloading" << (zsync.length - knownBytes) << "bytes in" << missingRanges.size() << "ranges";
+
+    downloadNextRange();
+}
+
+// Keeps up to ZSYNC_PARALLEL_RANGES range requests in
+// flight, so that many small ranges don't cost a round
+// trip each
+void ImageDownload::downloadNextRange() {
+    if (missingRanges.isEmpty() && activeRanges.isEmpty()) {
+        // NOTE: checked using sha1 from zsync file if
+        // md5sum is missing
+        startMd5Check();
+
+        return;
+    }
+
+    while (activeRanges.size() < ZSYNC_PARALLEL_RANGES && !missingRanges.isEmpty()) {
+        const QPair<qint64, qint64> range = missingRanges.takeFirst();
+
+        QNetworkRequest request;
+        request.setAttribute(QNetworkRequest::FollowRedirectsAttribute, true);
+        request.setUrl(url);
+        // NOTE: end of http range is inclusive
+        request.setRawHeader("Range", QString("bytes=%1-%2").arg(range.first).arg(range.second - 1).toLocal8Bit());
+
+        QNetworkReply *reply = network_access_manager->get(request);
+        reply->setReadBufferSize(64L * 1024L * 1024L);
+        activeRanges[reply] = range;
+
+        connect(
+            reply, &QNetworkReply::readyRead,
+            this, &ImageDownload::onRangeReadyRead);
+        connect(
+            reply, &QNetworkReply::finished,
+            this, &ImageDownload::onRangeFinished);
+        connect(
+            this, &ImageDownload::cancelled,
+            reply, &QNetworkReply::abort);
+    }
+}
+
+void ImageDownload::abortRanges() {
+    for (QNetworkReply *reply : activeRanges.keys()) {
+        disconnect(reply, nullptr, this, nullptr);
+        reply->abort();
+        reply->deleteLater();
+    }
+
+    activeRanges.clear();
+    missingRanges.clear();
+}
+
+void ImageDownload::onRangeReadyRead() {
+    QNetworkReply *reply = qobject_cast<QNetworkReply *>(sender());
+    if (!activeRanges.contains(reply)) {
+        return;
+    }
+
+    // Server has to support range requests, otherwise
+    // it would send the whole image
+    const int status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+    if (status != 206) {
+        qDebug() << this->metaObject()->className() << "Server doesn't support range requests, status" << status;
+
+        abortRanges();
+        fallbackToFullDownload();
+        return;
+    }
+
+    const QByteArray data = reply->readAll();
+    if (reply->error() != QNetworkReply::NoError || data.isEmpty()) {
+        return;
+    }
+
+    QPair<qint64, qint64> &range = activeRanges[reply];
+    const qint64 len = qMin((qint64) data.size(), range.second - range.first);
+
+    file->seek(range.first);
+    const qint64 write_result = file->write(data.constData(), len);
+    if (write_result != len) {
+        abortRanges();
+
+        finish(ImageDownload::DiskError, tr("The downloaded file is not writable."));
+        return;
+    }
+
+    range.first += len;
+    knownBytes += len;
+    emit progress(knownBytes);
+}
+
+void ImageDownload::onRangeFinished() {
+    QNetworkReply *reply = qobject_cast<QNetworkReply *>(sender());
+    reply->deleteLater();
+
+    if (wasCancelled || !activeRanges.contains(reply)) {
+        return;
+    }
+
+    const QPair<qint64, qint64> range = activeRanges.take(reply);
+    const bool range_complete = (range.first >= range.second);
+
+    if (reply->error() == QNetworkReply::NoError && range_complete) {
+        downloadNextRange();
+    } else {
+        qDebug() << "Range download was interrupted by an error:" << reply->errorString();
+        qDebug() << "Attempting to resume";
+
+        emit interrupted();
+
+        // NOTE: range start was advanced by received data,
+        // so only the rest of the range is requested
+        missingRanges.prepend(range);
+        QTimer::singleShot(1000, this,
+            [this]() {
+                if (!missingRanges.isEmpty()) {
+                    downloadNextRange();
+                }
+            });
+    }
+}
+
+void ImageDownload::fallbackToFullDownload() {
+    qDebug() << this->metaObject()->className() << "Delta download failed, downloading whole image";
+
+    deltaMode = false;
+    hash.reset();
+    sha1Hash.reset();
+
+    file->close();
+    file->open(QIODevice::WriteOnly | QIODevice::Truncate);
+    file->close();
+    file->open(QIODevice::WriteOnly | QIODevice::Append);
+
+    startImageDownload();
+}
+
 void ImageDownload::rename_to_final_name() {
     qDebug() << this->metaObject()->className() << "Renaming to final filename";
 
@@ -238,7 +630,11 @@ void ImageDownload::finish(const Result result_arg, const QString &errorString_a
         qDebug() << "Error string:" << m_errorString;
     }
 
-    if (m_result == ImageDownload::Success || m_result == ImageDownload::Cancelled) {
+    // NOTE: partial delta downloads can't be resumed
+    // because blocks are written out of order
+    const bool keep_file = (m_result == ImageDownload::Success || (m_result == ImageDownload::Cancelled && !deltaMode));
+
+    if (keep_file) {
         file->close();
     } else {
         file->remove();
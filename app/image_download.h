@@ -20,9 +20,15 @@
 #ifndef IMAGE_DOWNLOAD_H
 #define IMAGE_DOWNLOAD_H
 
+#include "zsync.h"
+
+#include <QBitArray>
 #include <QCryptographicHash>
+#include <QHash>
 #include <QObject>
+#include <QPair>
 #include <QUrl>
+#include <QVector>
 
 /**
  * Downloads an image using QNetwork and writes downloaded
@@ -39,9 +45,19 @@
  * finishes unsuccessfully, partially downloaded image is
  * deleted. Image download schedules itself for deletion
  * when it finishes.
+ *
+ * If an older image of the same kind is present in the
+ * download directory and a zsync control file is published
+ * next to the image (as "<image>.zsync"), only the blocks
+ * that are missing from the older image are downloaded.
+ * The assembled image is checked using md5sum or, if it's
+ * missing, the SHA-1 from the zsync file. If neither is
+ * available or anything fails, the whole image is
+ * downloaded instead.
  */
 
 class QFile;
+class QNetworkReply;
 
 class ImageDownload final : public QObject {
     Q_OBJECT
@@ -87,6 +103,10 @@ private slots:
     void onImageDownloadReadyRead();
     void onImageDownloadFinished();
     void computeMd5();
+    void onZsyncDownloaded();
+    void scanSeed();
+    void onRangeReadyRead();
+    void onRangeFinished();
 
 private:
     Result m_result;
@@ -99,9 +119,41 @@ private:
     bool startingImageDownload;
     bool wasCancelled;
     QCryptographicHash hash;
+    // NOTE: images without md5sum that were assembled from
+    // seed blocks are checked using sha1 from zsync file
+    QCryptographicHash sha1Hash;
+
+    // Delta download state. Blocks that exist in the
+    // seed (a local older image) are copied from it, the
+    // rest are downloaded using range requests.
+    bool deltaMode;
+    QString seedPath;
+    QFile *seedFile;
+    qint64 seedOffset;
+    ZsyncManifest zsync;
+    // Key is masked rsum of the block, followed by masked
+    // rsum of the next block if sequential matches are
+    // required
+    QHash<quint64, QList<int>> zsyncLookup;
+    // NOTE: hash lookup for every byte of the seed is slow,
+    // so it is prefiltered using this bit array
+    QBitArray zsyncFilter;
+    QVector<bool> blockIsKnown;
+    qint64 knownBytes;
+    // Ranges that weren't requested yet and ranges that
+    // are being downloaded, start of a range is advanced
+    // as data is received
+    QList<QPair<qint64, qint64>> missingRanges;
+    QHash<QNetworkReply *, QPair<qint64, qint64>> activeRanges;
 
     QString getFilePath() const;
     void startImageDownload();
+    void startDeltaDownload();
+    quint64 zsyncKey(const quint32 rsum, const quint32 next_rsum) const;
+    void downloadNextRange();
+    void abortRanges();
+    void fallbackToFullDownload();
+    void startMd5Check();
     void rename_to_final_name();
     void finish(const Result result_arg, const QString &errorString_arg = QString());
 };
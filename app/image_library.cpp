@@ -0,0 +1,376 @@
+/*
+ * ALT Media Writer
+ * Copyright (C) 2016-2019 Martin Bříza <mbriza@redhat.com>
+ * Copyright (C) 2020-2022 Dmitry Degtyarev <kevl@basealt.ru>
+ *
+ * ALT Media Writer is a fork of Fedora Media Writer
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "image_library.h"
+#include "image_check.h"
+#include "verification_record.h"
+
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSettings>
+#include <QStandardPaths>
+#include <QTimer>
+
+#include <algorithm>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+#endif // __linux__
+
+#ifdef _WIN32
+#include <windows.h>
+#endif // _WIN32
+
+ImageLibrary *ImageLibrary::_self = nullptr;
+
+ImageLibrary::ImageLibrary(QObject *parent)
+: QObject(parent) {
+    const QString dataDir = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation);
+    QDir().mkpath(dataDir);
+    manifestPath = QDir(dataDir).filePath("image_library.json");
+
+    load();
+
+    const bool background_rehash = QSettings().value("ImageLibrary/backgroundRehash", false).toBool();
+    if (background_rehash) {
+        startBackgroundRehash();
+    }
+}
+
+ImageLibrary *ImageLibrary::instance() {
+    if (!_self) {
+        _self = new ImageLibrary();
+    }
+    return _self;
+}
+
+bool ImageLibrary::provide(const QString &md5sum, const QString &path) {
+    if (md5sum.isEmpty() || !images.contains(md5sum)) {
+        return false;
+    }
+
+    Image &image = images[md5sum];
+
+    // Forget copies that were deleted or modified
+    const int old_count = image.files.size();
+    image.files.erase(std::remove_if(image.files.begin(), image.files.end(),
+                          [md5sum](const QString &file) {
+                              return !verification_record_is_valid(file, md5sum);
+                          }),
+        image.files.end());
+    if (image.files.isEmpty()) {
+        images.remove(md5sum);
+        save();
+
+        return false;
+    } else if (image.files.size() != old_count) {
+        save();
+    }
+
+    if (image.files.contains(path)) {
+        image.lastUsed = QDateTime::currentDateTime();
+        save();
+
+        return true;
+    }
+
+    // NOTE: never overwrite files that are not tracked,
+    // caller should verify them instead
+    if (QFile::exists(path)) {
+        return false;
+    }
+
+    for (const QString &file : image.files) {
+        const bool link_success = image_library_link(file, path);
+
+        if (link_success) {
+            qDebug() << this->metaObject()->className() << "Reusing" << file << "for" << path;
+
+            // NOTE: linked file has the same contents, so
+            // it doesn't need to be verified
+            verification_record_save(path, md5sum);
+
+            image.files.append(path);
+            image.lastUsed = QDateTime::currentDateTime();
+            save();
+
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool ImageLibrary::isTrusted(const QString &md5sum, const QString &path) const {
+    if (!images.contains(md5sum)) {
+        return false;
+    }
+
+    const Image &image = images[md5sum];
+
+    return (image.files.contains(path) && verification_record_is_valid(path, md5sum));
+}
+
+void ImageLibrary::add(const QString &md5sum, const QString &path) {
+    if (md5sum.isEmpty()) {
+        return;
+    }
+
+    const QFileInfo info(path);
+    if (!info.exists()) {
+        return;
+    }
+
+    // A path can only hold one image. Sidecar files are
+    // kept, block map is downloaded for the new image
+    // before it's added.
+    forget(path);
+
+    const bool record_success = verification_record_save(path, md5sum);
+    if (!record_success) {
+        qDebug() << this->metaObject()->className() << "Failed to save verification record for" << path;
+        return;
+    }
+
+    Image &image = images[md5sum];
+    image.size = info.size();
+    image.lastUsed = QDateTime::currentDateTime();
+    image.files.append(path);
+
+    evict(md5sum);
+    save();
+}
+
+void ImageLibrary::remove(const QString &path) {
+    forget(path);
+
+    QFile::remove(path + ".journal");
+    QFile::remove(path + ".bmap");
+
+    save();
+}
+
+void ImageLibrary::forget(const QString &path) {
+    for (auto it = images.begin(); it != images.end();) {
+        QStringList &files = it.value().files;
+
+        files.removeAll(path);
+
+        if (files.isEmpty()) {
+            it = images.erase(it);
+        } else {
+            it++;
+        }
+    }
+
+    verification_record_remove(path);
+}
+
+void ImageLibrary::load() {
+    QFile file(manifestPath);
+    const bool open_success = file.open(QIODevice::ReadOnly);
+    if (!open_success) {
+        return;
+    }
+
+    const QJsonObject manifest = QJsonDocument::fromJson(file.readAll()).object();
+
+    for (const QString &md5sum : manifest.keys()) {
+        const QJsonObject image_json = manifest[md5sum].toObject();
+
+        Image image;
+        image.size = (qint64) image_json["size"].toDouble();
+        image.lastUsed = QDateTime::fromMSecsSinceEpoch((qint64) image_json["last_used"].toDouble());
+
+        for (const QJsonValue &file_value : image_json["files"].toArray()) {
+            image.files.append(file_value.toString());
+        }
+
+        if (!image.files.isEmpty()) {
+            images[md5sum] = image;
+        }
+    }
+
+    qDebug() << this->metaObject()->className() << "Loaded" << images.size() << "images from" << manifestPath;
+}
+
+void ImageLibrary::save() const {
+    QJsonObject manifest;
+
+    for (const QString &md5sum : images.keys()) {
+        const Image &image = images[md5sum];
+
+        QJsonObject image_json;
+        image_json["size"] = (double) image.size;
+        image_json["last_used"] = (double) image.lastUsed.toMSecsSinceEpoch();
+        image_json["files"] = QJsonArray::fromStringList(image.files);
+
+        manifest[md5sum] = image_json;
+    }
+
+    QFile file(manifestPath);
+    const bool open_success = file.open(QIODevice::WriteOnly | QIODevice::Truncate);
+    if (!open_success) {
+        qDebug() << this->metaObject()->className() << "Failed to save manifest to" << manifestPath;
+        return;
+    }
+
+    file.write(QJsonDocument(manifest).toJson());
+}
+
+// Delete least recently used images until total size is
+// under quota. Hardlinked copies share storage so image
+// size is counted once.
+void ImageLibrary::evict(const QString &keep_md5sum) {
+    const qint64 quota = QSettings().value("ImageLibrary/quota", 0).toLongLong();
+    if (quota <= 0) {
+        return;
+    }
+
+    qint64 total = 0;
+    for (const Image &image : images) {
+        total += image.size;
+    }
+
+    while (total > quota) {
+        QString oldest;
+        for (const QString &md5sum : images.keys()) {
+            if (md5sum == keep_md5sum) {
+                continue;
+            }
+
+            if (oldest.isEmpty() || images[md5sum].lastUsed < images[oldest].lastUsed) {
+                oldest = md5sum;
+            }
+        }
+
+        if (oldest.isEmpty()) {
+            break;
+        }
+
+        const Image image = images.take(oldest);
+        for (const QString &file : image.files) {
+            qDebug() << this->metaObject()->className() << "Evicting" << file;
+
+            QFile::remove(file);
+            verification_record_remove(file);
+            QFile::remove(file + ".journal");
+            QFile::remove(file + ".bmap");
+        }
+
+        total -= image.size;
+    }
+}
+
+void ImageLibrary::startBackgroundRehash() {
+    for (const QString &md5sum : images.keys()) {
+        for (const QString &file : images[md5sum].files) {
+            rehashQueue.append(qMakePair(md5sum, file));
+        }
+    }
+
+    qDebug() << this->metaObject()->className() << "Rehashing" << rehashQueue.size() << "images in the background";
+
+    QTimer::singleShot(0, this, &ImageLibrary::rehashNext);
+}
+
+// Images are rehashed one at a time so that background
+// rehash doesn't compete with itself for disk bandwidth
+void ImageLibrary::rehashNext() {
+    if (rehashQueue.isEmpty()) {
+        return;
+    }
+
+    const QPair<QString, QString> next = rehashQueue.takeFirst();
+    const QString md5sum = next.first;
+    const QString path = next.second;
+
+    // Skip files that were removed or modified in the
+    // meantime, they will be verified before use anyway
+    if (!isTrusted(md5sum, path)) {
+        QTimer::singleShot(0, this, &ImageLibrary::rehashNext);
+        return;
+    }
+
+    auto check = new ImageCheck(path, md5sum);
+
+    connect(
+        check, &ImageCheck::finished,
+        [this, check, md5sum, path]() {
+            if (!check->passed()) {
+                qDebug() << this->metaObject()->className() << "Background rehash failed for" << path;
+                remove(path);
+            }
+
+            rehashNext();
+        });
+}
+
+// Create "to" so that it has the same contents as "from"
+// without copying data, if possible. Tries a hardlink
+// first, then a reflink.
+bool image_library_link(const QString &from, const QString &to) {
+#ifdef __linux__
+    const QByteArray from_bytes = QFile::encodeName(from);
+    const QByteArray to_bytes = QFile::encodeName(to);
+
+    if (link(from_bytes.constData(), to_bytes.constData()) == 0) {
+        return true;
+    }
+
+    // NOTE: hardlinks don't work across filesystems, but
+    // reflinks might work if filesystem supports them
+    const int from_fd = open(from_bytes.constData(), O_RDONLY | O_CLOEXEC);
+    if (from_fd < 0) {
+        return false;
+    }
+
+    const int to_fd = open(to_bytes.constData(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+    if (to_fd < 0) {
+        close(from_fd);
+        return false;
+    }
+
+    const bool clone_success = (ioctl(to_fd, FICLONE, from_fd) == 0);
+
+    close(from_fd);
+    close(to_fd);
+
+    if (!clone_success) {
+        QFile::remove(to);
+    }
+
+    return clone_success;
+#endif // __linux__
+
+#ifdef _WIN32
+    return CreateHardLinkW((LPCWSTR) QDir::toNativeSeparators(to).utf16(), (LPCWSTR) QDir::toNativeSeparators(from).utf16(), NULL);
+#endif // _WIN32
+}
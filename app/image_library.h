@@ -0,0 +1,107 @@
+/*
+ * ALT Media Writer
+ * Copyright (C) 2016-2019 Martin Bříza <mbriza@redhat.com>
+ * Copyright (C) 2020-2022 Dmitry Degtyarev <kevl@basealt.ru>
+ *
+ * ALT Media Writer is a fork of Fedora Media Writer
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef IMAGE_LIBRARY_H
+#define IMAGE_LIBRARY_H
+
+/**
+ * @brief The ImageLibrary class
+ *
+ * Keeps track of downloaded images by their md5 sum. The
+ * manifest is stored in app data and records every file
+ * that contains a verified copy of an image. Each file also
+ * has a verification record (see verification_record.h),
+ * a file that changed since verification is no longer
+ * trusted.
+ *
+ * If an image is requested under a different file name,
+ * an existing copy is hardlinked (or reflinked) instead of
+ * being downloaded again.
+ *
+ * If a quota is set in settings under "ImageLibrary/quota"
+ * (in bytes), least recently used images are deleted to
+ * stay under it.
+ *
+ * If "ImageLibrary/backgroundRehash" is enabled in
+ * settings, all images are verified again in the
+ * background on startup, which catches corruption that
+ * doesn't change file's size or modification time.
+ */
+
+#include <QDateTime>
+#include <QHash>
+#include <QList>
+#include <QObject>
+#include <QStringList>
+
+class ImageLibrary final : public QObject {
+    Q_OBJECT
+
+public:
+    static ImageLibrary *instance();
+
+    // Returns true if path contains a trusted copy of
+    // image with this md5 sum. If path doesn't exist,
+    // attempts to create it from another copy of the
+    // image.
+    bool provide(const QString &md5sum, const QString &path);
+
+    // Returns true if path contains a trusted copy of
+    // image with this md5 sum
+    bool isTrusted(const QString &md5sum, const QString &path) const;
+
+    // Record a file that was verified to have this md5 sum
+    void add(const QString &md5sum, const QString &path);
+
+    // Forget the file and delete its sidecar files
+    void remove(const QString &path);
+
+private slots:
+    void rehashNext();
+
+private:
+    struct Image {
+        qint64 size;
+        QDateTime lastUsed;
+        QStringList files;
+    };
+
+    explicit ImageLibrary(QObject *parent = nullptr);
+
+    static ImageLibrary *_self;
+    QString manifestPath;
+    QHash<QString, Image> images;
+    // (md5sum, path) pairs that are waiting for rehash
+    QList<QPair<QString, QString>> rehashQueue;
+
+    // Drop path from the manifest and its verification
+    // record
+    void forget(const QString &path);
+    void load();
+    void save() const;
+    void evict(const QString &keep_md5sum);
+    void startBackgroundRehash();
+};
+
+bool image_library_link(const QString &from, const QString &to);
+
+#endif // IMAGE_LIBRARY_H
@@ -25,6 +25,7 @@
 #include "variant.h"
 
 #include <QDBusArgument>
+#include <QSettings>
 #include <QtDBus/QtDBus>
 
 #include "notifications.h"
@@ -51,7 +52,7 @@ void LinuxDriveProvider::delayedConstruct() {
 
     connect(w, &QDBusPendingCallWatcher::finished, this, &LinuxDriveProvider::init);
 
-    QDBusConnection::systemBus().connect("org.freedesktop.UDisks2", 0, "org.freedesktop.DBus.Properties", "PropertiesChanged", this, SLOT(onPropertiesChanged(QString, QVariantMap, QStringList)));
+    QDBusConnection::systemBus().connect("org.freedesktop.UDisks2", 0, "org.freedesktop.DBus.Properties", "PropertiesChanged", this, SLOT(onPropertiesChanged(QString, QVariantMap, QStringList, QDBusMessage)));
     QDBusConnection::systemBus().connect("org.freedesktop.UDisks2", "/org/freedesktop/UDisks2", "org.freedesktop.DBus.ObjectManager", "InterfacesAdded", this, SLOT(onInterfacesAdded(QDBusObjectPath, InterfacesAndProperties)));
     QDBusConnection::systemBus().connect("org.freedesktop.UDisks2", "/org/freedesktop/UDisks2", "org.freedesktop.DBus.ObjectManager", "InterfacesRemoved", this, SLOT(onInterfacesRemoved(QDBusObjectPath, QStringList)));
 }
@@ -61,23 +62,32 @@ QDBusObjectPath LinuxDriveProvider::handleObject(const QDBusObjectPath &object_p
     QRegExp mmcRE("[0-9]p[0-9]$");
     QDBusObjectPath driveId = qvariant_cast<QDBusObjectPath>(interfaces_and_properties["org.freedesktop.UDisks2.Block"]["Drive"]);
 
-    QDBusInterface driveInterface("org.freedesktop.UDisks2", driveId.path(), "org.freedesktop.UDisks2.Drive", QDBusConnection::systemBus());
-
     if ((numberRE.indexIn(object_path.path()) >= 0 && !object_path.path().startsWith("/org/freedesktop/UDisks2/block_devices/mmcblk")) ||
         mmcRE.indexIn(object_path.path()) >= 0) {
         return QDBusObjectPath();
     }
 
     if (!driveId.path().isEmpty() && driveId.path() != "/") {
-        bool portable = driveInterface.property("Removable").toBool();
-        bool optical = driveInterface.property("Optical").toBool();
-        bool containsMedia = driveInterface.property("MediaAvailable").toBool();
-        QString connectionBus = driveInterface.property("ConnectionBus").toString().toLower();
+        // NOTE: drive properties usually come together
+        // with the block device, if they didn't, request
+        // them and come back to this block device later
+        const bool drive_is_cached = m_objects.contains(driveId) && m_objects[driveId].contains("org.freedesktop.UDisks2.Drive");
+        if (!drive_is_cached) {
+            fetchDrive(driveId);
+
+            return QDBusObjectPath();
+        }
+
+        const QVariantMap driveProperties = m_objects[driveId]["org.freedesktop.UDisks2.Drive"];
+        bool portable = driveProperties["Removable"].toBool();
+        bool optical = driveProperties["Optical"].toBool();
+        bool containsMedia = driveProperties["MediaAvailable"].toBool();
+        QString connectionBus = driveProperties["ConnectionBus"].toString().toLower();
         bool isValid = containsMedia && !optical && (portable || connectionBus == "usb");
 
-        QString vendor = driveInterface.property("Vendor").toString();
-        QString model = driveInterface.property("Model").toString();
-        uint64_t size = driveInterface.property("Size").toULongLong();
+        QString vendor = driveProperties["Vendor"].toString();
+        QString model = driveProperties["Model"].toString();
+        uint64_t size = driveProperties["Size"].toULongLong();
         bool isoLayout = interfaces_and_properties["org.freedesktop.UDisks2.Block"]["IdType"].toString() == "iso9660";
 
         QString name;
@@ -115,8 +125,7 @@ void LinuxDriveProvider::init(QDBusPendingCallWatcher *watcher) {
     qDebug() << this->metaObject()->className() << "Got a reply to GetManagedObjects, parsing";
 
     QDBusPendingReply<DBusIntrospection> reply = *watcher;
-    QSet<QDBusObjectPath> oldPaths = m_drives.keys().toSet();
-    QSet<QDBusObjectPath> newPaths;
+    watcher->deleteLater();
 
     if (reply.isError()) {
         qDebug() << "Could not read drives from UDisks:" << reply.error().name() << reply.error().message();
@@ -124,22 +133,13 @@ void LinuxDriveProvider::init(QDBusPendingCallWatcher *watcher) {
         return;
     }
 
-    DBusIntrospection introspection = reply.argumentAt<0>();
-    for (const QDBusObjectPath &i : introspection.keys()) {
+    m_objects = reply.argumentAt<0>();
+    for (const QDBusObjectPath &i : m_objects.keys()) {
         if (!i.path().startsWith("/org/freedesktop/UDisks2/block_devices")) {
             continue;
         }
 
-        QDBusObjectPath path = handleObject(i, introspection[i]);
-        if (!path.path().isEmpty()) {
-            newPaths.insert(path);
-        }
-    }
-
-    for (const QDBusObjectPath &i : oldPaths - newPaths) {
-        emit driveRemoved(m_drives[i]);
-        m_drives[i]->deleteLater();
-        m_drives.remove(i);
+        updateBlock(i);
     }
 
     m_initialized = true;
@@ -147,44 +147,168 @@ void LinuxDriveProvider::init(QDBusPendingCallWatcher *watcher) {
 }
 
 void LinuxDriveProvider::onInterfacesAdded(const QDBusObjectPath &object_path, const InterfacesAndProperties &interfaces_and_properties) {
-    QRegExp numberRE("[0-9]$");
+    for (const QString &interface : interfaces_and_properties.keys()) {
+        m_objects[object_path][interface] = interfaces_and_properties[interface];
+    }
 
-    if (interfaces_and_properties.keys().contains("org.freedesktop.UDisks2.Block")) {
-        if (!m_drives.contains(object_path)) {
-            handleObject(object_path, interfaces_and_properties);
-        }
+    for (const QString &interface : interfaces_and_properties.keys()) {
+        updateObject(object_path, interface);
     }
 }
 
 void LinuxDriveProvider::onInterfacesRemoved(const QDBusObjectPath &object_path, const QStringList &interfaces) {
-    if (interfaces.contains("org.freedesktop.UDisks2.Block")) {
-        if (m_drives.contains(object_path)) {
-            qDebug() << this->metaObject()->className() << "Drive at" << object_path.path() << "removed";
-            emit driveRemoved(m_drives[object_path]);
-            m_drives[object_path]->deleteLater();
-            m_drives.remove(object_path);
+    if (m_objects.contains(object_path)) {
+        for (const QString &interface : interfaces) {
+            m_objects[object_path].remove(interface);
+        }
+
+        if (m_objects[object_path].isEmpty()) {
+            m_objects.remove(object_path);
         }
     }
+
+    for (const QString &interface : interfaces) {
+        updateObject(object_path, interface);
+    }
 }
 
-void LinuxDriveProvider::onPropertiesChanged(const QString &interface_name, const QVariantMap &changed_properties, const QStringList &invalidated_properties) {
-    Q_UNUSED(interface_name)
+void LinuxDriveProvider::onPropertiesChanged(const QString &interface_name, const QVariantMap &changed_properties, const QStringList &invalidated_properties, const QDBusMessage &message) {
+    const QDBusObjectPath object_path(message.path());
+
+    // NOTE: ignore objects that we haven't seen added
+    if (!m_objects.contains(object_path) || !m_objects[object_path].contains(interface_name)) {
+        return;
+    }
+
+    QVariantMap &properties = m_objects[object_path][interface_name];
+    for (const QString &property : changed_properties.keys()) {
+        properties[property] = changed_properties[property];
+    }
+
+    // NOTE: invalidated properties don't come with new
+    // values, so those have to be requested
+    if (!invalidated_properties.isEmpty()) {
+        refreshObject(object_path, interface_name);
+
+        return;
+    }
+
     const QSet<QString> watchedProperties = {"MediaAvailable", "Size"};
+    if (!changed_properties.keys().toSet().intersect(watchedProperties).isEmpty()) {
+        updateObject(object_path, interface_name);
+    }
+}
+
+// Adds, updates or removes the drive for this block
+// device based on the cached properties
+void LinuxDriveProvider::updateBlock(const QDBusObjectPath &path) {
+    const bool is_block = m_objects.contains(path) && m_objects[path].contains("org.freedesktop.UDisks2.Block");
+    if (!is_block) {
+        removeDrive(path);
 
-    // not ideal but it works alright without a huge lot of code
-    if (!changed_properties.keys().toSet().intersect(watchedProperties).isEmpty() ||
-        !invalidated_properties.toSet().intersect(watchedProperties).isEmpty()) {
-        QDBusPendingCall pcall = m_objManager->asyncCall("GetManagedObjects");
-        QDBusPendingCallWatcher *w = new QDBusPendingCallWatcher(pcall, this);
+        return;
+    }
 
-        connect(w, &QDBusPendingCallWatcher::finished, this, &LinuxDriveProvider::init);
+    const QDBusObjectPath handled_path = handleObject(path, m_objects[path]);
+    if (handled_path.path().isEmpty()) {
+        removeDrive(path);
     }
 }
 
-LinuxDrive::LinuxDrive(LinuxDriveProvider *parent, const QString &device, const QString &name, const uint64_t size, const bool isoLayout)
+// Updates drives affected by a change in this
+// interface of the object
+void LinuxDriveProvider::updateObject(const QDBusObjectPath &path, const QString &interface) {
+    if (interface == "org.freedesktop.UDisks2.Block") {
+        updateBlock(path);
+    } else if (interface == "org.freedesktop.UDisks2.Drive") {
+        for (const QDBusObjectPath &i : m_objects.keys()) {
+            const QDBusObjectPath drive_path = qvariant_cast<QDBusObjectPath>(m_objects[i].value("org.freedesktop.UDisks2.Block").value("Drive"));
+
+            if (drive_path == path) {
+                updateBlock(i);
+            }
+        }
+    }
+}
+
+// Reloads properties of one interface of the object
+void LinuxDriveProvider::refreshObject(const QDBusObjectPath &path, const QString &interface) {
+    QDBusMessage message = QDBusMessage::createMethodCall("org.freedesktop.UDisks2", path.path(), "org.freedesktop.DBus.Properties", "GetAll");
+    message << interface;
+
+    QDBusPendingCall pcall = QDBusConnection::systemBus().asyncCall(message);
+    QDBusPendingCallWatcher *w = new QDBusPendingCallWatcher(pcall, this);
+
+    connect(
+        w, &QDBusPendingCallWatcher::finished,
+        [this, path, interface](QDBusPendingCallWatcher *watcher) {
+            QDBusPendingReply<QVariantMap> reply = *watcher;
+            watcher->deleteLater();
+
+            if (reply.isError()) {
+                qDebug() << this->metaObject()->className() << "Failed to refresh" << path.path() << reply.error().message();
+
+                return;
+            }
+
+            // NOTE: object might've been removed while
+            // waiting for reply
+            if (!m_objects.contains(path) || !m_objects[path].contains(interface)) {
+                return;
+            }
+
+            m_objects[path][interface] = reply.value();
+            updateObject(path, interface);
+        });
+}
+
+// Loads properties of a drive that wasn't seen yet,
+// all properties are loaded in one call
+void LinuxDriveProvider::fetchDrive(const QDBusObjectPath &path) {
+    if (m_pendingDrives.contains(path)) {
+        return;
+    }
+    m_pendingDrives.insert(path);
+
+    QDBusMessage message = QDBusMessage::createMethodCall("org.freedesktop.UDisks2", path.path(), "org.freedesktop.DBus.Properties", "GetAll");
+    message << QString("org.freedesktop.UDisks2.Drive");
+
+    QDBusPendingCall pcall = QDBusConnection::systemBus().asyncCall(message);
+    QDBusPendingCallWatcher *w = new QDBusPendingCallWatcher(pcall, this);
+
+    connect(
+        w, &QDBusPendingCallWatcher::finished,
+        [this, path](QDBusPendingCallWatcher *watcher) {
+            QDBusPendingReply<QVariantMap> reply = *watcher;
+            watcher->deleteLater();
+            m_pendingDrives.remove(path);
+
+            if (reply.isError()) {
+                qDebug() << this->metaObject()->className() << "Failed to load drive" << path.path() << reply.error().message();
+
+                return;
+            }
+
+            m_objects[path]["org.freedesktop.UDisks2.Drive"] = reply.value();
+            updateObject(path, "org.freedesktop.UDisks2.Drive");
+        });
+}
+
+void LinuxDriveProvider::removeDrive(const QDBusObjectPath &path) {
+    if (m_drives.contains(path)) {
+        qDebug() << this->metaObject()->className() << "Drive at" << path.path() << "removed";
+        emit driveRemoved(m_drives[path]);
+        m_drives[path]->deleteLater();
+        m_drives.remove(path);
+    }
+}
+
+LinuxDrive::LinuxDrive(DriveProvider *parent, const QString &device, const QString &name, const uint64_t size, const bool isoLayout)
 : Drive(parent, name, size, isoLayout) {
     m_device = device;
     m_process = nullptr;
+    m_probeProcess = nullptr;
+    m_writeAfterProbe = false;
 }
 
 LinuxDrive::~LinuxDrive() {
@@ -201,6 +325,23 @@ bool LinuxDrive::write(Variant *variant) {
         return false;
     }
 
+    // NOTE: optionally check the drive before writing,
+    // writing continues once the probe finishes
+    const bool probe_before_write = QSettings().value("Writing/probe", false).toBool();
+    if (probe_before_write && m_fakeCapacity) {
+        m_variant->setErrorString(tr("The drive reports a larger capacity than it really has. Images written to it will be corrupted."));
+        m_variant = nullptr;
+        return false;
+    }
+    if (probe_before_write && m_probeStatus == NOT_PROBED) {
+        probe();
+
+        if (m_probeStatus == PROBING) {
+            m_writeAfterProbe = true;
+            return true;
+        }
+    }
+
     if (!m_process) {
         m_process = new QProcess(this);
     }
@@ -214,11 +355,55 @@ bool LinuxDrive::write(Variant *variant) {
         return false;
     }
 
-    QStringList args;
-    args << "write";
-    args << variant->filePath();
-    args << m_device;
-    args << variant->md5sum();
+    const QStringList args = [&]() {
+        QStringList out;
+
+        // NOTE: archives are unpacked onto a new
+        // filesystem instead of being written as is
+        if (file_type_is_archive(variant->fileType())) {
+            out << "extract";
+            out << variant->filePath();
+            out << m_device;
+
+            return out;
+        }
+
+        out << "write";
+        out << variant->filePath();
+        out << m_device;
+        out << variant->md5sum();
+
+        // NOTE: delta write is useful when rewriting drives
+        // that contain an older version of the image
+        const bool delta_write = QSettings().value("Writing/deltaWrite", false).toBool();
+        if (delta_write) {
+            out << "--delta";
+        }
+
+        // NOTE: sparse write skips free space of
+        // filesystems in partitioned images
+        const bool sparse_write = QSettings().value("Writing/sparseWrite", false).toBool();
+        if (sparse_write) {
+            out << "--sparse";
+        }
+
+        // NOTE: helper leaves a journal next to the image if
+        // writing was interrupted, in which case it can
+        // continue from where it stopped
+        const bool interrupted_write = QFile::exists(variant->filePath() + ".journal");
+        if (interrupted_write && !delta_write) {
+            out << "--resume";
+        }
+
+        // NOTE: how often written data is flushed to the
+        // drive, in bytes, 0 flushes after every write
+        const QVariant flush_interval = QSettings().value("Writing/flushInterval");
+        if (flush_interval.isValid()) {
+            out << QString("--flush-interval=%1").arg(flush_interval.toLongLong());
+        }
+
+        return out;
+    }();
 
     qDebug() << this->metaObject()->className() << "Helper command will be" << args;
     m_process->setArguments(args);
@@ -237,6 +422,16 @@ bool LinuxDrive::write(Variant *variant) {
 
 void LinuxDrive::cancel() {
     Drive::cancel();
+    if (m_probeProcess != nullptr) {
+        QProcess *probeProcess = m_probeProcess;
+        m_probeProcess = nullptr;
+        m_writeAfterProbe = false;
+        probeProcess->kill();
+        probeProcess->deleteLater();
+
+        m_probeStatus = NOT_PROBED;
+        emit probeChanged();
+    }
     static bool beingCancelled = false;
     if (m_process != nullptr && !beingCancelled) {
         beingCancelled = true;
@@ -278,6 +473,123 @@ void LinuxDrive::restore() {
     m_process->start(QIODevice::ReadOnly);
 }
 
+void LinuxDrive::probe() {
+    if (m_probeProcess != nullptr) {
+        return;
+    }
+
+    qDebug() << this->metaObject()->className() << "Will now probe" << this->m_device;
+
+    m_readSpeed = 0;
+    m_writeSpeed = 0;
+    m_randomReadSpeed = 0;
+    m_randomWriteSpeed = 0;
+    m_fakeCapacity = false;
+    m_ioErrors = false;
+
+    const QString helperPath = getHelperPath();
+    if (helperPath.isEmpty()) {
+        qDebug() << "Couldn't find the helper binary.";
+        m_probeStatus = PROBE_ERROR;
+        emit probeChanged();
+        return;
+    }
+
+    m_probeStatus = PROBING;
+    emit probeChanged();
+
+    m_probeProcess = new QProcess(this);
+    m_probeProcess->setProgram(helperPath);
+    m_probeProcess->setArguments({"probe", m_device});
+
+    connect(m_probeProcess, &QProcess::readyRead, this, &LinuxDrive::onProbeReadyRead);
+    connect(m_probeProcess, SIGNAL(finished(int, QProcess::ExitStatus)), this, SLOT(onProbeFinished(int, QProcess::ExitStatus)));
+
+    m_probeProcess->start(QIODevice::ReadOnly);
+}
+
+void LinuxDrive::onProbeReadyRead() {
+    if (!m_probeProcess) {
+        return;
+    }
+
+    while (m_probeProcess->canReadLine()) {
+        const QString line = m_probeProcess->readLine().trimmed();
+        qDebug() << "helper:" << line;
+
+        const QStringList words = line.split(" ");
+        const QString key = words[0];
+        const qreal value = [&]() {
+            if (words.size() > 1) {
+                // NOTE: helper reports speed in bytes/s
+                return words[1].toLongLong() / 1000000.0;
+            } else {
+                return 0.0;
+            }
+        }();
+
+        if (key == "READSPEED") {
+            m_readSpeed = value;
+        } else if (key == "WRITESPEED") {
+            m_writeSpeed = value;
+        } else if (key == "RANDOMREADSPEED") {
+            m_randomReadSpeed = value;
+        } else if (key == "RANDOMWRITESPEED") {
+            m_randomWriteSpeed = value;
+        } else if (key == "FAKECAPACITY") {
+            m_fakeCapacity = true;
+        } else if (key == "IOERRORS") {
+            m_ioErrors = true;
+        }
+    }
+}
+
+void LinuxDrive::onProbeFinished(const int exitCode, const QProcess::ExitStatus status) {
+    qDebug() << this->metaObject()->className() << "Probe finished with status" << status;
+
+    if (!m_probeProcess) {
+        return;
+    }
+
+    onProbeReadyRead();
+
+    QString probe_error;
+    if (exitCode == 0 && status == QProcess::NormalExit) {
+        m_probeStatus = PROBED;
+    } else {
+        probe_error = m_probeProcess->readAllStandardError().trimmed();
+        qDebug() << "Probe failed:" << probe_error;
+        m_probeStatus = PROBE_ERROR;
+    }
+    m_probeProcess->deleteLater();
+    m_probeProcess = nullptr;
+    emit probeChanged();
+
+    if (m_writeAfterProbe && m_variant != nullptr) {
+        m_writeAfterProbe = false;
+
+        // NOTE: a drive that failed the check is not
+        // written to, the user has to start writing again
+        // to confirm. Drive is probed only once, so that
+        // write isn't stopped again.
+        if (m_fakeCapacity) {
+            m_variant->setErrorString(tr("The drive reports a larger capacity than it really has. Images written to it will be corrupted."));
+            m_variant->setStatus(Variant::WRITING_FAILED);
+            m_variant = nullptr;
+        } else if (m_ioErrors) {
+            m_variant->setErrorString(tr("Reading or writing failed while checking the drive, it may be damaged. Start writing again to write to it anyway."));
+            m_variant->setStatus(Variant::READY_FOR_WRITING);
+            m_variant = nullptr;
+        } else if (m_probeStatus == PROBE_ERROR) {
+            m_variant->setErrorString(tr("The drive could not be checked: %1. Start writing again to write to it anyway.").arg(probe_error));
+            m_variant->setStatus(Variant::READY_FOR_WRITING);
+            m_variant = nullptr;
+        } else {
+            write(m_variant);
+        }
+    }
+}
+
 void LinuxDrive::onReadyRead() {
     if (!m_process) {
         return;
@@ -298,8 +610,24 @@ void LinuxDrive::onReadyRead() {
             m_progress->setMax(file.size());
 
             m_progress->setCurrent(0);
+            m_progress->setFlushed(0);
 
             m_variant->setStatus(Variant::WRITING);
+        } else if (line.startsWith("FLUSHED ")) {
+            // NOTE: numeric lines report data submitted to
+            // the drive, this is how much of it the drive
+            // confirmed
+            m_progress->setFlushed(line.section(' ', 1).toLongLong());
+
+            // A successful flush means that retries, if
+            // there were any, helped
+            m_variant->setErrorString(QString());
+        } else if (line.startsWith("RETRY ")) {
+            m_variant->setErrorString(tr("Writing to the drive failed, retrying"));
+        } else if (line.startsWith("RESUME ")) {
+            const qint64 resume_offset = line.section(' ', 1).toLongLong();
+            m_progress->setFlushed(resume_offset);
+            m_variant->setErrorString(tr("Continuing an interrupted write"));
         } else if (line == "CHECK") {
             qDebug() << this->metaObject()->className() << "Helper finished writing, now it will check the written data";
             const QFile file(m_variant->filePath());
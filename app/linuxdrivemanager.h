@@ -27,9 +27,11 @@
 
 #include <QDBusArgument>
 #include <QDBusInterface>
+#include <QDBusMessage>
 #include <QDBusObjectPath>
 #include <QDBusPendingCall>
 #include <QProcess>
+#include <QSet>
 
 typedef QHash<QString, QVariantMap> InterfacesAndProperties;
 typedef QHash<QDBusObjectPath, InterfacesAndProperties> DBusIntrospection;
@@ -50,31 +52,45 @@ private slots:
     void init(QDBusPendingCallWatcher *watcher);
     void onInterfacesAdded(const QDBusObjectPath &object_path, const InterfacesAndProperties &interfaces_and_properties);
     void onInterfacesRemoved(const QDBusObjectPath &object_path, const QStringList &interfaces);
-    void onPropertiesChanged(const QString &interface_name, const QVariantMap &changed_properties, const QStringList &invalidated_properties);
+    void onPropertiesChanged(const QString &interface_name, const QVariantMap &changed_properties, const QStringList &invalidated_properties, const QDBusMessage &message);
 
 private:
     QDBusObjectPath handleObject(const QDBusObjectPath &path, const InterfacesAndProperties &interface);
+    void updateBlock(const QDBusObjectPath &path);
+    void updateObject(const QDBusObjectPath &path, const QString &interface);
+    void refreshObject(const QDBusObjectPath &path, const QString &interface);
+    void fetchDrive(const QDBusObjectPath &path);
+    void removeDrive(const QDBusObjectPath &path);
 
 private:
     QDBusInterface *m_objManager;
     QHash<QDBusObjectPath, LinuxDrive *> m_drives;
+
+    // NOTE: local copy of UDisks objects which is kept up
+    // to date using signals, so that changes to one
+    // object don't require reloading all of them
+    DBusIntrospection m_objects;
+    QSet<QDBusObjectPath> m_pendingDrives;
 };
 
 class LinuxDrive : public Drive {
     Q_OBJECT
     Q_PROPERTY(QString devicePath READ devicePath CONSTANT)
 public:
-    LinuxDrive(LinuxDriveProvider *parent, const QString &device, const QString &name, const uint64_t size, const bool isoLayout);
+    LinuxDrive(DriveProvider *parent, const QString &device, const QString &name, const uint64_t size, const bool isoLayout);
     ~LinuxDrive();
 
     Q_INVOKABLE virtual bool write(Variant *variant) override;
     Q_INVOKABLE virtual void cancel() override;
     Q_INVOKABLE virtual void restore() override;
+    Q_INVOKABLE virtual void probe() override;
 
     QString devicePath() const;
 
 private slots:
     void onReadyRead();
+    void onProbeReadyRead();
+    void onProbeFinished(const int exitCode, const QProcess::ExitStatus status);
     void onFinished(const int exitCode, const QProcess::ExitStatus status);
     void onRestoreFinished(const int exitCode, const QProcess::ExitStatus status);
     void onErrorOccurred(QProcess::ProcessError e);
@@ -83,6 +99,8 @@ private:
     QString m_device;
 
     QProcess *m_process;
+    QProcess *m_probeProcess;
+    bool m_writeAfterProbe;
 };
 
 #endif // LINUXDRIVEMANAGER_H
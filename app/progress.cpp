@@ -30,6 +30,10 @@ qreal Progress::leftSize() const {
     return (m_max - m_current);
 }
 
+qreal Progress::flushed() const {
+    return m_flushed;
+}
+
 void Progress::setCurrent(const qreal newCurrent) {
     if (m_current != newCurrent) {
         m_current = newCurrent;
@@ -47,3 +51,11 @@ void Progress::setMax(const qreal newMax) {
         emit leftSizeChanged();
     }
 }
+
+void Progress::setFlushed(const qreal newFlushed) {
+    if (m_flushed != newFlushed) {
+        m_flushed = newFlushed;
+
+        emit flushedChanged();
+    }
+}
@@ -32,28 +32,35 @@
  *
  * @property ratio in the range [0.0, 1.0]
  * @property leftSize how much size is left until completion 
+ * @property flushed how much data is confirmed to be on the
+ *     drive while writing, in bytes of uncompressed image
  */
 class Progress : public QObject {
     Q_OBJECT
     Q_PROPERTY(qreal ratio READ ratio NOTIFY ratioChanged)
     Q_PROPERTY(qreal leftSize READ leftSize NOTIFY leftSizeChanged)
+    Q_PROPERTY(qreal flushed READ flushed NOTIFY flushedChanged)
 
 public:
     using QObject::QObject;
 
     qreal ratio() const;
     qreal leftSize() const;
+    qreal flushed() const;
 
     void setCurrent(const qreal newCurrent);
     void setMax(const qreal newMax);
+    void setFlushed(const qreal newFlushed);
 
 signals:
     void ratioChanged();
     void leftSizeChanged();
+    void flushedChanged();
 
 private:
     qreal m_current;
     qreal m_max;
+    qreal m_flushed = 0;
 };
 
 #endif // PROGRESS_H
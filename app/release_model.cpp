@@ -56,6 +56,11 @@ ReleaseFilterModel::ReleaseFilterModel(ReleaseModel *model_arg, QObject *parent)
     filterArch = Architecture_ALL;
 
     setSourceModel(model_arg);
+
+    // NOTE: sorting is needed to rank search results,
+    // without a search the order of the source model is
+    // preserved
+    sort(0);
 }
 
 bool ReleaseFilterModel::filterAcceptsRow(int source_row, const QModelIndex &) const {
@@ -74,12 +79,12 @@ bool ReleaseFilterModel::filterAcceptsRow(int source_row, const QModelIndex &) c
         // Always show local release
         return true;
     } else {
-        const bool releaseMatchesName = release->displayName().contains(filterText, Qt::CaseInsensitive);
+        const bool releaseMatchesText = (searchScore(release) > 0);
 
-        // Exit early if don't match name to skip checking
+        // Exit early if don't match text to skip checking
         // for arch because that takes a long time
         // TODO: cache that somehow?
-        if (!releaseMatchesName) {
+        if (!releaseMatchesText) {
             return false;
         }
 
@@ -106,6 +111,37 @@ bool ReleaseFilterModel::filterAcceptsRow(int source_row, const QModelIndex &) c
     }
 }
 
+// Sort search results by score, releases that match
+// better are placed higher. Custom release always stays
+// first.
+bool ReleaseFilterModel::lessThan(const QModelIndex &source_left, const QModelIndex &source_right) const {
+    const int left_row = source_left.row();
+    const int right_row = source_right.row();
+
+    if (frontPage || filterText.isEmpty()) {
+        return (left_row < right_row);
+    }
+
+    const Release *left = model->get(left_row);
+    const Release *right = model->get(right_row);
+    if (left == nullptr || right == nullptr) {
+        return (left_row < right_row);
+    }
+
+    if (left->isCustom() != right->isCustom()) {
+        return left->isCustom();
+    }
+
+    const int left_score = searchScore(left);
+    const int right_score = searchScore(right);
+
+    if (left_score != right_score) {
+        return (left_score > right_score);
+    } else {
+        return (left_row < right_row);
+    }
+}
+
 bool ReleaseFilterModel::getFrontPage() const {
     return frontPage;
 }
@@ -121,7 +157,12 @@ void ReleaseFilterModel::leaveFrontPage() {
 void ReleaseFilterModel::setFilterText(const QString &text) {
     filterText = text;
 
-    invalidateFilter();
+    updateSearchScores();
+
+    // NOTE: invalidate() instead of invalidateFilter()
+    // because ranking of results changes together with
+    // the filter
+    invalidate();
 }
 
 void ReleaseFilterModel::setFilterArch(const int index) {
@@ -130,6 +171,42 @@ void ReleaseFilterModel::setFilterArch(const int index) {
 }
 
 void ReleaseFilterModel::invalidateCustom() {
+    // NOTE: index might've changed since last search
+    updateSearchScores();
+
     // NOTE: need this because public invalidate() doesn't work completely for some reason
     invalidateFilter();
 }
+
+void ReleaseFilterModel::addToSearchIndex(const Release *release) {
+    searchIndex.addRelease(release);
+}
+
+void ReleaseFilterModel::addToSearchIndex(const Release *release, const Variant *variant) {
+    searchIndex.addVariant(release, variant);
+}
+
+void ReleaseFilterModel::updateSearchScores() {
+    if (filterText.isEmpty()) {
+        searchScores.clear();
+    } else {
+        searchScores = searchIndex.search(filterText);
+    }
+}
+
+int ReleaseFilterModel::searchScore(const Release *release) const {
+    if (filterText.isEmpty()) {
+        return 1;
+    }
+
+    const int index_score = searchScores.value(release, 0);
+
+    // NOTE: also match substrings of display name, the
+    // index only matches word prefixes
+    const bool name_contains_text = release->displayName().contains(filterText, Qt::CaseInsensitive);
+    if (name_contains_text) {
+        return index_score + 1;
+    } else {
+        return index_score;
+    }
+}
@@ -33,11 +33,13 @@
  */
 
 #include "architecture.h"
+#include "search_index.h"
 
 #include <QSortFilterProxyModel>
 #include <QStandardItemModel>
 
 class Release;
+class Variant;
 
 class ReleaseModel final : public QStandardItemModel {
     Q_OBJECT
@@ -57,8 +59,12 @@ public:
     ReleaseFilterModel(ReleaseModel *model_arg, QObject *parent);
 
     bool filterAcceptsRow(int source_row, const QModelIndex &source_parent) const override;
+    bool lessThan(const QModelIndex &source_left, const QModelIndex &source_right) const override;
     void invalidateCustom();
 
+    void addToSearchIndex(const Release *release);
+    void addToSearchIndex(const Release *release, const Variant *variant);
+
     bool getFrontPage() const;
     Q_INVOKABLE void leaveFrontPage();
     Q_INVOKABLE void setFilterArch(const int index);
@@ -72,6 +78,11 @@ private:
     bool frontPage;
     QString filterText;
     Architecture filterArch;
+    SearchIndex searchIndex;
+    QHash<const Release *, int> searchScores;
+
+    void updateSearchScores();
+    int searchScore(const Release *release) const;
 };
 
 #endif // RELEASE_MODEL_H
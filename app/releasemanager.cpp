@@ -32,6 +32,7 @@
 
 #include <QAbstractEventDispatcher>
 #include <QApplication>
+#include <QSettings>
 #include <QtQml>
 
 const QString METADATA_URLS_HOST = "http://getalt.org";
@@ -40,6 +41,7 @@ const QString METADATA_URLS_BACKUP_HOST = "http://kvel2d.github.io/posts";
 QList<QString> load_list_from_file(const QString &filepath);
 QString yml_get(const YAML::Node &node, const QString &key);
 QList<QString> get_metadata_urls_list(const QString &host);
+QString get_metadata_urls_host();
 
 ReleaseManager::ReleaseManager(QObject *parent)
 : QObject(parent) {
@@ -67,7 +69,7 @@ void ReleaseManager::downloadMetadataUrls() {
 
     setDownloadingMetadata(true);
 
-    const QList<QString> url_list = get_metadata_urls_list(METADATA_URLS_HOST);
+    const QList<QString> url_list = get_metadata_urls_list(get_metadata_urls_host());
 
     metadata_urls_reply_group = new NetworkReplyGroup(url_list, this);
 
@@ -101,7 +103,18 @@ void ReleaseManager::onMetadataUrlsDownloaded() {
         // 
         // TODO: when usage of backup is removed, fail
         // and restart here
-        if (download_failed) {
+        //
+        // NOTE: backup only mirrors the default host, so
+        // a custom host is retried instead
+        if (download_failed && get_metadata_urls_host() != METADATA_URLS_HOST) {
+            qDebug() << "Failed to download metadata urls:" << reply->errorString() << reply->error() << "Retrying in 10 seconds.";
+            QTimer::singleShot(10000, this, &ReleaseManager::downloadMetadataUrls);
+
+            delete metadata_urls_reply_group;
+            metadata_urls_reply_group = nullptr;
+
+            return;
+        } else if (download_failed) {
             qDebug() << "Failed to download metadata urls:" << reply->errorString() << reply->error() << "Downloading from backup";
             QTimer::singleShot(100, this, &ReleaseManager::downloadMetadataUrlsBackup);
 
@@ -137,7 +150,7 @@ void ReleaseManager::onMetadataUrlsDownloaded() {
         }
     }
 
-    const QList<QString> url_list = get_metadata_urls_list(METADATA_URLS_HOST);
+    const QList<QString> url_list = get_metadata_urls_list(get_metadata_urls_host());
     const QString section_metadata_url = url_list[0];
     const QString image_metadata_url = url_list[1];
     
@@ -469,6 +482,8 @@ void ReleaseManager::onMD5SUMDownloaded() {
         loadVariants(imagesFile, md5sum_map);
     }
 
+    filterModel->invalidateCustom();
+
     delete md5sum_reply_group;
     md5sum_reply_group = nullptr;
 
@@ -589,9 +604,21 @@ void ReleaseManager::loadVariants(const QString &variantsFile, const QHash<QStri
             return nullptr;
         }();
 
+        // NOTE: optional block map, relative to the image
+        const QString bmap_url = [&]() {
+            const QString out = yml_get(variantData, "bmap");
+            if (!out.isEmpty()) {
+                return QUrl(url).resolved(QUrl(out)).toString();
+            } else {
+                return QString();
+            }
+        }();
+
         if (release != nullptr) {
             Variant *variant = new Variant(url, arch, fileType, board, live, md5sum, this);
+            variant->setBmapUrl(bmap_url);
             release->addVariant(variant);
+            filterModel->addToSearchIndex(release, variant);
         } else {
             qDebug() << "Failed to find a release for this variant!" << url;
         }
@@ -750,6 +777,8 @@ void ReleaseManager::addReleaseToModel(const int index, Release *release) {
     item->setData(variant);
 
     sourceModel->insertRow(index, item);
+
+    filterModel->addToSearchIndex(release);
 }
 
 QList<QString> load_list_from_file(const QString &filepath) {
@@ -797,3 +826,14 @@ QList<QString> get_metadata_urls_list(const QString &host) {
 
     return out;
 }
+
+// NOTE: host can be changed in settings to use a mirror,
+// for example a local one for testing
+QString get_metadata_urls_host() {
+    QString out = QSettings().value("Metadata/host", METADATA_URLS_HOST).toString();
+    while (out.endsWith("/")) {
+        out.chop(1);
+    }
+
+    return out;
+}
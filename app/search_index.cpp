@@ -0,0 +1,148 @@
+/*
+ * ALT Media Writer
+ * Copyright (C) 2016-2019 Martin Bříza <mbriza@redhat.com>
+ * Copyright (C) 2020-2022 Dmitry Degtyarev <kevl@basealt.ru>
+ *
+ * ALT Media Writer is a fork of Fedora Media Writer
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "search_index.h"
+#include "architecture.h"
+#include "file_type.h"
+#include "release.h"
+#include "variant.h"
+
+#include <QRegExp>
+
+// NOTE: weights define ranking of results, matches in
+// names are more relevant than matches in descriptions
+const int WEIGHT_DISPLAY_NAME = 16;
+const int WEIGHT_NAME = 8;
+const int WEIGHT_SUMMARY = 4;
+const int WEIGHT_VARIANT = 2;
+const int WEIGHT_DESCRIPTION = 1;
+
+void SearchIndex::addRelease(const Release *release) {
+    const QString description = [release]() {
+        // Descriptions contain html tags, don't index them
+        QString out = release->description();
+        out.remove(QRegExp("<[^>]*>"));
+
+        return out;
+    }();
+
+    addText(release, release->displayName(), WEIGHT_DISPLAY_NAME);
+    addText(release, release->name(), WEIGHT_NAME);
+    addText(release, release->summary(), WEIGHT_SUMMARY);
+    addText(release, description, WEIGHT_DESCRIPTION);
+
+    for (const Variant *variant : release->variantList()) {
+        addVariant(release, variant);
+    }
+}
+
+void SearchIndex::addVariant(const Release *release, const Variant *variant) {
+    addText(release, architecture_name(variant->arch()), WEIGHT_VARIANT);
+    addText(release, variant->board(), WEIGHT_VARIANT);
+    addText(release, variant->fileTypeName(), WEIGHT_VARIANT);
+    addText(release, file_type_strings(variant->fileType()).join(" "), WEIGHT_VARIANT);
+
+    if (variant->live()) {
+        addText(release, "live", WEIGHT_VARIANT);
+    }
+}
+
+QHash<const Release *, int> SearchIndex::search(const QString &text) const {
+    const QStringList query_words = search_index_tokenize(text);
+
+    QHash<const Release *, int> out;
+
+    for (int i = 0; i < query_words.size(); i++) {
+        const QString &query_word = query_words[i];
+
+        // Collect scores for this word. Indexed words are
+        // sorted, so all words with this prefix are
+        // located next to each other.
+        QHash<const Release *, int> word_scores;
+        for (auto it = m_index.lowerBound(query_word); it != m_index.end() && it.key().startsWith(query_word); it++) {
+            const QHash<const Release *, int> &postings = it.value();
+
+            // Exact word matches rank above prefix matches
+            const int multiplier = (it.key().size() == query_word.size()) ? 2 : 1;
+
+            for (auto posting = postings.begin(); posting != postings.end(); posting++) {
+                word_scores[posting.key()] += posting.value() * multiplier;
+            }
+        }
+
+        // Results have to match all of the words, so
+        // intersect with results for previous words
+        if (i == 0) {
+            out = word_scores;
+        } else {
+            for (auto it = out.begin(); it != out.end();) {
+                if (word_scores.contains(it.key())) {
+                    it.value() += word_scores[it.key()];
+                    it++;
+                } else {
+                    it = out.erase(it);
+                }
+            }
+        }
+
+        if (out.isEmpty()) {
+            break;
+        }
+    }
+
+    return out;
+}
+
+void SearchIndex::addText(const Release *release, const QString &text, const int weight) {
+    const QStringList words = search_index_tokenize(text);
+
+    for (const QString &word : words) {
+        QHash<const Release *, int> &postings = m_index[word];
+
+        // Only keep the most relevant occurence of a word
+        if (postings.value(release, 0) < weight) {
+            postings[release] = weight;
+        }
+    }
+}
+
+// Splits text into lowercase words. Anything that is not a
+// letter or a number separates words.
+QStringList search_index_tokenize(const QString &text) {
+    QStringList out;
+    QString current;
+
+    for (const QChar c : text) {
+        if (c.isLetterOrNumber()) {
+            current.append(c.toLower());
+        } else if (!current.isEmpty()) {
+            out.append(current);
+            current.clear();
+        }
+    }
+
+    if (!current.isEmpty()) {
+        out.append(current);
+    }
+
+    return out;
+}
@@ -0,0 +1,65 @@
+/*
+ * ALT Media Writer
+ * Copyright (C) 2016-2019 Martin Bříza <mbriza@redhat.com>
+ * Copyright (C) 2020-2022 Dmitry Degtyarev <kevl@basealt.ru>
+ *
+ * ALT Media Writer is a fork of Fedora Media Writer
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef SEARCH_INDEX_H
+#define SEARCH_INDEX_H
+
+/**
+ * @brief The SearchIndex class
+ *
+ * In-memory inverted index over release and variant
+ * metadata. Maps normalized words to the releases that
+ * contain them, along with a weight that depends on where
+ * the word was found (display name weighs more than full
+ * description). The index is filled incrementally as
+ * releases and variants are loaded, so searching never
+ * has to touch the metadata itself.
+ */
+
+#include <QHash>
+#include <QMap>
+#include <QString>
+#include <QStringList>
+
+class Release;
+class Variant;
+
+class SearchIndex final {
+public:
+    void addRelease(const Release *release);
+    void addVariant(const Release *release, const Variant *variant);
+
+    // Returns scores of releases which match all words of
+    // the search text. A word matches if it is a prefix of
+    // an indexed word. Higher score means better match.
+    QHash<const Release *, int> search(const QString &text) const;
+
+private:
+    // word => (release => weight)
+    QMap<QString, QHash<const Release *, int>> m_index;
+
+    void addText(const Release *release, const QString &text, const int weight);
+};
+
+QStringList search_index_tokenize(const QString &text);
+
+#endif // SEARCH_INDEX_H
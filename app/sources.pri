@@ -0,0 +1,76 @@
+# Sources of the app without main(), shared with the
+# benchmarks that measure app code
+
+QT += qml quick widgets network
+
+LIBS += -lisomd5 -limageformat
+linux {
+    LIBS += -lyaml-cpp
+}
+windows {
+    # NOTE: "-lyaml-cpp" ignores static linking option and links to dynamic "yaml.cpp.dll.a", so have to manually link to static file
+    LIBS += -l:libyaml-cpp.a
+}
+
+INCLUDEPATH += $$PWD
+
+HEADERS += \
+    $$PWD/drivemanager.h \
+    $$PWD/releasemanager.h \
+    $$PWD/network.h \
+    $$PWD/notifications.h \
+    $$PWD/image_check.h \
+    $$PWD/image_download.h \
+    $$PWD/image_library.h \
+    $$PWD/progress.h \
+    $$PWD/file_type.h \
+    $$PWD/architecture.h \
+    $$PWD/release.h \
+    $$PWD/release_model.h \
+    $$PWD/search_index.h \
+    $$PWD/units.h \
+    $$PWD/variant.h \
+    $$PWD/verification_record.h \
+    $$PWD/zsync.h
+
+SOURCES += \
+    $$PWD/drivemanager.cpp \
+    $$PWD/releasemanager.cpp \
+    $$PWD/network.cpp \
+    $$PWD/notifications.cpp \
+    $$PWD/image_check.cpp \
+    $$PWD/image_download.cpp \
+    $$PWD/image_library.cpp \
+    $$PWD/progress.cpp \
+    $$PWD/file_type.cpp \
+    $$PWD/architecture.cpp \
+    $$PWD/release.cpp \
+    $$PWD/release_model.cpp \
+    $$PWD/search_index.cpp \
+    $$PWD/units.cpp \
+    $$PWD/variant.cpp \
+    $$PWD/verification_record.cpp \
+    $$PWD/zsync.cpp
+
+linux {
+    QT += dbus x11extras
+
+    HEADERS += $$PWD/linuxdrivemanager.h
+    SOURCES += $$PWD/linuxdrivemanager.cpp
+
+    # NOTE: optional drive backend, build with "qmake CONFIG+=udev"
+    udev {
+        CONFIG += link_pkgconfig
+        PKGCONFIG += libudev
+        DEFINES += WITH_UDEV
+
+        HEADERS += $$PWD/udevdrivemanager.h
+        SOURCES += $$PWD/udevdrivemanager.cpp
+    }
+}
+win32 {
+    HEADERS += $$PWD/windrivemanager.h
+    SOURCES += $$PWD/windrivemanager.cpp
+
+    LIBS += -ldbghelp
+}
@@ -0,0 +1,214 @@
+/*
+ * ALT Media Writer
+ * Copyright (C) 2016-2019 Martin Bříza <mbriza@redhat.com>
+ * Copyright (C) 2020-2022 Dmitry Degtyarev <kevl@basealt.ru>
+ *
+ * ALT Media Writer is a fork of Fedora Media Writer
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "udevdrivemanager.h"
+#include "linuxdrivemanager.h"
+
+#include <QDebug>
+#include <QTimer>
+
+#include <libudev.h>
+
+QString udev_device_name(udev_device *device);
+QString udev_device_sysattr(udev_device *device, const char *name);
+QString udev_device_udisks_path(udev_device *device);
+
+UdevDriveProvider::UdevDriveProvider(DriveManager *parent)
+: DriveProvider(parent) {
+    m_udev = nullptr;
+    m_monitor = nullptr;
+    m_notifier = nullptr;
+
+    qDebug() << this->metaObject()->className() << "construction";
+
+    m_initialized = false;
+
+    QTimer::singleShot(0, this, SLOT(delayedConstruct()));
+}
+
+UdevDriveProvider::~UdevDriveProvider() {
+    if (m_monitor != nullptr) {
+        udev_monitor_unref(m_monitor);
+    }
+    if (m_udev != nullptr) {
+        udev_unref(m_udev);
+    }
+}
+
+void UdevDriveProvider::delayedConstruct() {
+    m_udev = udev_new();
+    if (m_udev == nullptr) {
+        qDebug() << this->metaObject()->className() << "Failed to create udev context";
+        emit backendBroken(tr("udev seems to be unavailable or unaccessible on your system."));
+        return;
+    }
+
+    // NOTE: start monitoring before enumerating so that
+    // drives plugged in during enumeration aren't missed
+    m_monitor = udev_monitor_new_from_netlink(m_udev, "udev");
+    if (m_monitor != nullptr) {
+        udev_monitor_filter_add_match_subsystem_devtype(m_monitor, "block", "disk");
+        udev_monitor_enable_receiving(m_monitor);
+
+        m_notifier = new QSocketNotifier(udev_monitor_get_fd(m_monitor), QSocketNotifier::Read, this);
+        connect(m_notifier, SIGNAL(activated(int)), this, SLOT(onMonitorActivated()));
+    } else {
+        qDebug() << this->metaObject()->className() << "Failed to create udev monitor, drives won't be updated";
+    }
+
+    udev_enumerate *enumerate = udev_enumerate_new(m_udev);
+    udev_enumerate_add_match_subsystem(enumerate, "block");
+    udev_enumerate_add_match_property(enumerate, "DEVTYPE", "disk");
+    udev_enumerate_scan_devices(enumerate);
+
+    udev_list_entry *entry;
+    udev_list_entry_foreach(entry, udev_enumerate_get_list_entry(enumerate)) {
+        const char *syspath = udev_list_entry_get_name(entry);
+        udev_device *device = udev_device_new_from_syspath(m_udev, syspath);
+
+        if (device != nullptr) {
+            handleDevice(device);
+            udev_device_unref(device);
+        }
+    }
+    udev_enumerate_unref(enumerate);
+
+    m_initialized = true;
+    emit initializedChanged();
+}
+
+void UdevDriveProvider::onMonitorActivated() {
+    udev_device *device = udev_monitor_receive_device(m_monitor);
+    if (device == nullptr) {
+        return;
+    }
+
+    const QString action = udev_device_get_action(device);
+    const QString sysname = udev_device_get_sysname(device);
+
+    if (action == "remove") {
+        removeDrive(sysname);
+    } else {
+        handleDevice(device);
+    }
+
+    udev_device_unref(device);
+}
+
+void UdevDriveProvider::handleDevice(udev_device *device) {
+    const QString sysname = udev_device_get_sysname(device);
+
+    // NOTE: same conditions as in LinuxDriveProvider,
+    // which come from UDisks properties of the drive
+    const bool portable = (udev_device_sysattr(device, "removable") == "1");
+    const bool optical = (udev_device_get_property_value(device, "ID_CDROM") != nullptr);
+    const QString connectionBus = QString(udev_device_get_property_value(device, "ID_BUS")).toLower();
+    const uint64_t size = udev_device_sysattr(device, "size").toULongLong() * 512;
+    const bool containsMedia = (size > 0);
+    const bool isValid = containsMedia && !optical && (portable || connectionBus == "usb");
+
+    if (!isValid) {
+        removeDrive(sysname);
+
+        return;
+    }
+
+    const bool isoLayout = (QString(udev_device_get_property_value(device, "ID_FS_TYPE")) == "iso9660");
+    const QString name = udev_device_name(device);
+
+    qDebug() << this->metaObject()->className() << "New drive" << sysname << "-" << name << "(" << size << "bytes;" << connectionBus << ")";
+
+    if (m_drives.contains(sysname)) {
+        m_drives[sysname]->updateDrive(name, size, isoLayout);
+    } else {
+        const QString udisksPath = udev_device_udisks_path(device);
+        LinuxDrive *drive = new LinuxDrive(this, udisksPath, name, size, isoLayout);
+        m_drives[sysname] = drive;
+        emit driveConnected(drive);
+    }
+}
+
+void UdevDriveProvider::removeDrive(const QString &sysname) {
+    if (m_drives.contains(sysname)) {
+        qDebug() << this->metaObject()->className() << "Drive" << sysname << "removed";
+        emit driveRemoved(m_drives[sysname]);
+        m_drives[sysname]->deleteLater();
+        m_drives.remove(sysname);
+    }
+}
+
+// Returns "vendor model" like UDisks does, falling back
+// to the device node
+QString udev_device_name(udev_device *device) {
+    // NOTE: USB sticks show up as SCSI disks, so vendor
+    // and model are read from the SCSI device
+    const QString vendor = udev_device_sysattr(device, "device/vendor");
+    const QString model = [&]() {
+        const QString scsi_model = udev_device_sysattr(device, "device/model");
+        if (!scsi_model.isEmpty()) {
+            return scsi_model;
+        } else {
+            // NOTE: mmc devices only have a name
+            return udev_device_sysattr(device, "device/name");
+        }
+    }();
+
+    if (vendor.isEmpty()) {
+        if (model.isEmpty()) {
+            return QString(udev_device_get_devnode(device));
+        } else {
+            return model;
+        }
+    } else {
+        if (model.isEmpty()) {
+            return vendor;
+        } else {
+            return QString("%1 %2").arg(vendor).arg(model);
+        }
+    }
+}
+
+QString udev_device_sysattr(udev_device *device, const char *name) {
+    const char *value = udev_device_get_sysattr_value(device, name);
+
+    return QString(value).trimmed();
+}
+
+// Returns the path of the UDisks object for this device,
+// which the helper uses to open it. UDisks escapes all
+// characters other than letters, digits and underscores.
+QString udev_device_udisks_path(udev_device *device) {
+    const QByteArray sysname = udev_device_get_sysname(device);
+
+    QString out = "/org/freedesktop/UDisks2/block_devices/";
+    for (const char c : sysname) {
+        const bool safe = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+
+        if (safe) {
+            out += c;
+        } else {
+            out += QString("_%1").arg((uchar) c, 2, 16, QChar('0'));
+        }
+    }
+
+    return out;
+}
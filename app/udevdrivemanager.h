@@ -0,0 +1,66 @@
+/*
+ * ALT Media Writer
+ * Copyright (C) 2016-2019 Martin Bříza <mbriza@redhat.com>
+ * Copyright (C) 2020-2022 Dmitry Degtyarev <kevl@basealt.ru>
+ *
+ * ALT Media Writer is a fork of Fedora Media Writer
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef UDEVDRIVEMANAGER_H
+#define UDEVDRIVEMANAGER_H
+
+#include "drivemanager.h"
+
+#include <QHash>
+#include <QSocketNotifier>
+
+struct udev;
+struct udev_device;
+struct udev_monitor;
+
+class LinuxDrive;
+
+/**
+ * @brief The UdevDriveProvider class
+ *
+ * Finds drives using udev events and sysfs attributes
+ * instead of UDisks. Drives are still opened for writing
+ * by the helper through UDisks. Enabled by building with
+ * "CONFIG+=udev" and setting "Drives/backend" to "udev".
+ */
+class UdevDriveProvider : public DriveProvider {
+    Q_OBJECT
+public:
+    UdevDriveProvider(DriveManager *parent);
+    ~UdevDriveProvider();
+
+private slots:
+    void delayedConstruct();
+    void onMonitorActivated();
+
+private:
+    void handleDevice(udev_device *device);
+    void removeDrive(const QString &sysname);
+
+private:
+    udev *m_udev;
+    udev_monitor *m_monitor;
+    QSocketNotifier *m_notifier;
+    QHash<QString, LinuxDrive *> m_drives;
+};
+
+#endif // UDEVDRIVEMANAGER_H
@@ -23,7 +23,9 @@
 #include "variant.h"
 #include "architecture.h"
 #include "drivemanager.h"
+#include "image_check.h"
 #include "image_download.h"
+#include "image_library.h"
 #include "network.h"
 #include "progress.h"
 #include "release.h"
@@ -31,6 +33,7 @@
 
 #include <QDir>
 #include <QFileInfo>
+#include <QNetworkReply>
 #include <QStandardPaths>
 
 Variant::Variant(const QString &url, const Architecture arch, const FileType fileType, const QString &board, const bool live, const QString &md5sum, QObject *parent)
@@ -56,7 +59,7 @@ Variant::Variant(const QString &path, QObject *parent)
     m_live = false;
     m_md5sum = QString();
     m_arch = Architecture_UNKNOWN;
-    m_fileType = file_type_from_filename(path);
+    m_fileType = file_type_from_file(path);
     m_status = Variant::READY_FOR_WRITING;
     m_progress = new Progress(this);
 }
@@ -73,10 +76,30 @@ QString Variant::fileTypeName() const {
     return file_type_name(m_fileType);
 }
 
+FileType Variant::fileType() const {
+    return m_fileType;
+}
+
+QString Variant::board() const {
+    return m_board;
+}
+
+bool Variant::live() const {
+    return m_live;
+}
+
 QString Variant::md5sum() const {
     return m_md5sum;
 }
 
+QString Variant::bmapUrl() const {
+    return m_bmapUrl;
+}
+
+void Variant::setBmapUrl(const QString &url) {
+    m_bmapUrl = url;
+}
+
 QString Variant::name() const {
     QString out = architecture_name(m_arch) + " | " + m_board;
 
@@ -104,7 +127,7 @@ bool Variant::noMd5sum() const {
 }
 
 bool Variant::isCompressed() const {
-    return (m_fileType == FileType_TAR_XZ || m_fileType == FileType_IMG_XZ);
+    return (file_type_compression(m_fileType) != ImageFormat_UNKNOWN);
 }
 
 Progress *Variant::progress() {
@@ -146,6 +169,7 @@ void Variant::onImageDownloadFinished() {
     switch (result) {
         case ImageDownload::Success: {
             qDebug() << this->metaObject()->className() << "Image is ready";
+            ImageLibrary::instance()->add(md5sum(), filePath());
             setStatus(READY_FOR_WRITING);
 
             break;
@@ -169,65 +193,192 @@ void Variant::onImageDownloadFinished() {
     }
 }
 
+void Variant::onImageCheckFinished() {
+    ImageCheck *check = qobject_cast<ImageCheck *>(sender());
+
+    if (check->passed()) {
+        qDebug() << this->metaObject()->className() << fileName() << "passed the check";
+        ImageLibrary::instance()->add(md5sum(), filePath());
+        setStatus(READY_FOR_WRITING);
+    } else {
+        // NOTE: file has to be removed, otherwise
+        // downloaded image can't be renamed to it. This
+        // also removes block map, so it's downloaded again.
+        qDebug() << this->metaObject()->className() << fileName() << "failed the check, downloading it again";
+        ImageLibrary::instance()->remove(filePath());
+        QFile::remove(filePath());
+        downloadBmap();
+    }
+}
+
 void Variant::download() {
     delayedWrite = false;
 
     resetStatus();
 
-    const bool already_downloaded = QFile::exists(filePath());
+    // NOTE: image that is already downloaded isn't ready
+    // for writing until its block map is in place
+    if (!m_bmapUrl.isEmpty()) {
+        setStatus(PREPARING);
+    }
+
+    downloadBmap();
+}
+
+void Variant::findImage() {
+    const bool already_downloaded = [this]() {
+        // NOTE: images without md5sum can't be
+        // identified, so trust any file with the same
+        // name
+        if (md5sum().isEmpty()) {
+            return QFile::exists(filePath());
+        } else {
+            return ImageLibrary::instance()->provide(md5sum(), filePath());
+        }
+    }();
 
     if (already_downloaded) {
         // Already downloaded so skip download step
         qDebug() << this->metaObject()->className() << fileName() << "is already downloaded";
         setStatus(READY_FOR_WRITING);
+    } else if (QFile::exists(filePath())) {
+        // File with the same name exists but it was never
+        // verified or it changed after verification
+        checkImage();
     } else {
-        // Download image
-        auto download = new ImageDownload(QUrl(url()), filePath(), md5sum());
-
-        connect(
-            download, &ImageDownload::started,
-            [this]() {
-                setErrorString(QString());
-                setStatus(DOWNLOADING);
-            });
-        connect(
-            download, &ImageDownload::interrupted,
-            [this]() {
-                setErrorString(tr("Connection was interrupted, attempting to resume"));
-                setStatus(DOWNLOAD_RESUMING);
-            });
-        connect(
-            download, &ImageDownload::startedMd5Check,
-            [this]() {
-                setErrorString(QString());
-                setStatus(DOWNLOAD_VERIFYING);
-            });
-        connect(
-            download, &ImageDownload::finished,
-            this, &Variant::onImageDownloadFinished);
-        connect(
-            download, &ImageDownload::progress,
-            [this](const qint64 value) {
-                m_progress->setCurrent(value);
-            });
-        connect(
-            download, &ImageDownload::progressMaxChanged,
-            [this](const qint64 value) {
-                m_progress->setMax(value);
-            });
-
-        connect(
-            this, &Variant::cancelledDownload,
-            download, &ImageDownload::cancel);
+        downloadImage();
     }
 }
 
+void Variant::checkImage() {
+    qDebug() << this->metaObject()->className() << fileName() << "exists but is not verified, checking it";
+
+    auto check = new ImageCheck(filePath(), md5sum());
+
+    setErrorString(QString());
+    setStatus(DOWNLOAD_VERIFYING);
+
+    connect(
+        check, &ImageCheck::finished,
+        this, &Variant::onImageCheckFinished);
+    connect(
+        check, &ImageCheck::progress,
+        [this](const qint64 value) {
+            m_progress->setCurrent(value);
+        });
+    connect(
+        check, &ImageCheck::progressMaxChanged,
+        [this](const qint64 value) {
+            m_progress->setMax(value);
+        });
+
+    connect(
+        this, &Variant::cancelledDownload,
+        check, &ImageCheck::cancel);
+}
+
+void Variant::downloadImage() {
+    auto download = new ImageDownload(QUrl(url()), filePath(), md5sum());
+
+    connect(
+        download, &ImageDownload::started,
+        [this]() {
+            setErrorString(QString());
+            setStatus(DOWNLOADING);
+        });
+    connect(
+        download, &ImageDownload::interrupted,
+        [this]() {
+            setErrorString(tr("Connection was interrupted, attempting to resume"));
+            setStatus(DOWNLOAD_RESUMING);
+        });
+    connect(
+        download, &ImageDownload::startedMd5Check,
+        [this]() {
+            setErrorString(QString());
+            setStatus(DOWNLOAD_VERIFYING);
+        });
+    connect(
+        download, &ImageDownload::finished,
+        this, &Variant::onImageDownloadFinished);
+    connect(
+        download, &ImageDownload::progress,
+        [this](const qint64 value) {
+            m_progress->setCurrent(value);
+        });
+    connect(
+        download, &ImageDownload::progressMaxChanged,
+        [this](const qint64 value) {
+            m_progress->setMax(value);
+        });
+
+    connect(
+        this, &Variant::cancelledDownload,
+        download, &ImageDownload::cancel);
+}
+
+// NOTE: block map is small, so it's downloaded every time
+// to match the current image. Writing works without it,
+// so failures are only logged. Image is looked up only
+// after block map is in place, so that it can't become
+// ready for writing while block map is missing or half
+// written.
+void Variant::downloadBmap() {
+    if (m_bmapUrl.isEmpty()) {
+        findImage();
+
+        return;
+    }
+
+    const QString bmap_path = filePath() + ".bmap";
+    QFile::remove(bmap_path);
+
+    QNetworkReply *reply = makeNetworkRequest(m_bmapUrl, 30000);
+
+    connect(
+        reply, &QNetworkReply::finished,
+        this, [this, reply, bmap_path]() {
+            reply->deleteLater();
+
+            if (reply->error() != QNetworkReply::NoError) {
+                qDebug() << this->metaObject()->className() << "Failed to download bmap:" << reply->errorString();
+                findImage();
+
+                return;
+            }
+
+            // NOTE: block map is written to a temporary
+            // file first, so that helper never reads half
+            // of it
+            const QString temp_path = bmap_path + ".tmp";
+            QFile file(temp_path);
+            const bool open_success = file.open(QIODevice::WriteOnly | QIODevice::Truncate);
+            const bool write_success = open_success && (file.write(reply->readAll()) != -1);
+            file.close();
+
+            const bool rename_success = write_success && QFile::rename(temp_path, bmap_path);
+            if (!rename_success) {
+                qDebug() << this->metaObject()->className() << "Failed to save bmap to" << bmap_path;
+                QFile::remove(temp_path);
+            }
+
+            findImage();
+        });
+    connect(
+        this, &Variant::cancelledDownload,
+        reply, [this, reply]() {
+            disconnect(reply, nullptr, this, nullptr);
+            reply->abort();
+            reply->deleteLater();
+        });
+}
+
 void Variant::cancelDownload() {
     emit cancelledDownload();
 }
 
 void Variant::resetStatus() {
-    if (QFile::exists(filePath())) {
+    if (imageIsReady()) {
         setStatus(READY_FOR_WRITING);
     } else {
         setStatus(PREPARING);
@@ -239,6 +390,8 @@ void Variant::resetStatus() {
 }
 
 bool Variant::erase() {
+    ImageLibrary::instance()->remove(filePath());
+
     if (QFile(filePath()).remove()) {
         qDebug() << this->metaObject()->className() << "Deleted" << filePath();
         return true;
@@ -248,6 +401,14 @@ bool Variant::erase() {
     }
 }
 
+bool Variant::imageIsReady() const {
+    if (md5sum().isEmpty()) {
+        return QFile::exists(filePath());
+    } else {
+        return ImageLibrary::instance()->isTrusted(md5sum(), filePath());
+    }
+}
+
 void Variant::setStatus(const Status status) {
     if (m_status != status) {
         m_status = status;
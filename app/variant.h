@@ -29,6 +29,8 @@
  * @property name the name of the variant which is generated from
  *     variant's architecture, board and live
  * @property filePath path to the image's file (after it is downloaded)
+ * @property bmapUrl url of the optional block map of the image, it is
+ *     downloaded next to the image
  * @property fileName the name of the image's file
  * @property fileTypeName display filetype name of the image's file
  * @property canWrite whether this image can be written, some file
@@ -112,7 +114,12 @@ public:
     QString filePath() const;
     QString fileName() const;
     QString fileTypeName() const;
+    FileType fileType() const;
+    QString board() const;
+    bool live() const;
     QString md5sum() const;
+    QString bmapUrl() const;
+    void setBmapUrl(const QString &url);
     bool canWrite() const;
     bool noMd5sum() const;
     bool isCompressed() const;
@@ -137,6 +144,7 @@ public slots:
     void cancelDownload();
     void resetStatus();
     void onImageDownloadFinished();
+    void onImageCheckFinished();
 
 private:
     QString m_url;
@@ -145,6 +153,7 @@ private:
     QString m_board;
     bool m_live;
     QString m_md5sum;
+    QString m_bmapUrl;
     Architecture m_arch;
     FileType m_fileType;
     Status m_status;
@@ -152,6 +161,12 @@ private:
     bool delayedWrite;
 
     Progress *m_progress;
+
+    bool imageIsReady() const;
+    void findImage();
+    void checkImage();
+    void downloadImage();
+    void downloadBmap();
 };
 
 #endif // VARIANT_H
@@ -0,0 +1,132 @@
+/*
+ * ALT Media Writer
+ * Copyright (C) 2016-2019 Martin Bříza <mbriza@redhat.com>
+ * Copyright (C) 2020-2022 Dmitry Degtyarev <kevl@basealt.ru>
+ *
+ * ALT Media Writer is a fork of Fedora Media Writer
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "verification_record.h"
+
+#include <QDateTime>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonDocument>
+#include <QJsonObject>
+
+#ifdef __linux__
+#include <sys/stat.h>
+#endif // __linux__
+
+QString verification_record_path(const QString &image_path) {
+    return image_path + ".verified";
+}
+
+VerificationRecord verification_record_from_file(const QString &image_path, bool *ok) {
+    VerificationRecord out;
+    out.size = 0;
+    out.modified = 0;
+    out.inode = 0;
+
+#ifdef __linux__
+    struct stat info;
+    const int stat_result = stat(QFile::encodeName(image_path).constData(), &info);
+    *ok = (stat_result == 0);
+    if (*ok) {
+        out.size = info.st_size;
+        out.modified = (qint64) info.st_mtim.tv_sec * 1000000000LL + info.st_mtim.tv_nsec;
+        out.inode = info.st_ino;
+    }
+#else
+    // NOTE: inode is not available, size and
+    // modification time have to be enough
+    const QFileInfo info(image_path);
+    *ok = info.exists();
+    if (*ok) {
+        out.size = info.size();
+        out.modified = info.lastModified().toMSecsSinceEpoch();
+    }
+#endif
+
+    return out;
+}
+
+bool verification_record_load(const QString &image_path, VerificationRecord *record) {
+    QFile file(verification_record_path(image_path));
+    const bool open_success = file.open(QIODevice::ReadOnly);
+    if (!open_success) {
+        return false;
+    }
+
+    const QJsonObject json = QJsonDocument::fromJson(file.readAll()).object();
+    if (!json.contains("md5sum")) {
+        return false;
+    }
+
+    // NOTE: 64bit values are stored as strings because
+    // json numbers are doubles
+    record->size = json["size"].toString().toLongLong();
+    record->modified = json["modified"].toString().toLongLong();
+    record->inode = json["inode"].toString().toULongLong();
+    record->md5sum = json["md5sum"].toString();
+
+    return true;
+}
+
+bool verification_record_save(const QString &image_path, const QString &md5sum) {
+    bool stat_success;
+    const VerificationRecord record = verification_record_from_file(image_path, &stat_success);
+    if (!stat_success) {
+        return false;
+    }
+
+    QJsonObject json;
+    json["size"] = QString::number(record.size);
+    json["modified"] = QString::number(record.modified);
+    json["inode"] = QString::number(record.inode);
+    json["md5sum"] = md5sum;
+
+    QFile file(verification_record_path(image_path));
+    const bool open_success = file.open(QIODevice::WriteOnly | QIODevice::Truncate);
+    if (!open_success) {
+        return false;
+    }
+
+    const qint64 write_result = file.write(QJsonDocument(json).toJson());
+
+    return (write_result != -1);
+}
+
+void verification_record_remove(const QString &image_path) {
+    QFile::remove(verification_record_path(image_path));
+}
+
+bool verification_record_is_valid(const QString &image_path, const QString &md5sum) {
+    VerificationRecord saved;
+    const bool load_success = verification_record_load(image_path, &saved);
+    if (!load_success) {
+        return false;
+    }
+
+    bool stat_success;
+    const VerificationRecord current = verification_record_from_file(image_path, &stat_success);
+    if (!stat_success) {
+        return false;
+    }
+
+    return (saved.md5sum == md5sum && saved.size == current.size && saved.modified == current.modified && saved.inode == current.inode);
+}
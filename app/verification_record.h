@@ -0,0 +1,59 @@
+/*
+ * ALT Media Writer
+ * Copyright (C) 2016-2019 Martin Bříza <mbriza@redhat.com>
+ * Copyright (C) 2020-2022 Dmitry Degtyarev <kevl@basealt.ru>
+ *
+ * ALT Media Writer is a fork of Fedora Media Writer
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef VERIFICATION_RECORD_H
+#define VERIFICATION_RECORD_H
+
+/**
+ * Verification records are small sidecar files stored
+ * next to downloaded images (as "<image>.verified"). A
+ * record contains the md5 sum that the image was verified
+ * to have, together with file's size, modification time
+ * and inode at the time of verification. If any of those
+ * change, the image has to be verified again, otherwise
+ * the expensive md5 computation can be skipped.
+ */
+
+#include <QString>
+
+struct VerificationRecord {
+    qint64 size;
+    qint64 modified;
+    quint64 inode;
+    QString md5sum;
+};
+
+QString verification_record_path(const QString &image_path);
+
+// Record for current state of the file, md5 sum is left
+// empty
+VerificationRecord verification_record_from_file(const QString &image_path, bool *ok);
+
+bool verification_record_load(const QString &image_path, VerificationRecord *record);
+bool verification_record_save(const QString &image_path, const QString &md5sum);
+void verification_record_remove(const QString &image_path);
+
+// Returns true if image was verified to have this md5 sum
+// and didn't change since then
+bool verification_record_is_valid(const QString &image_path, const QString &md5sum);
+
+#endif // VERIFICATION_RECORD_H
@@ -0,0 +1,223 @@
+/*
+ * ALT Media Writer
+ * Copyright (C) 2016-2019 Martin Bříza <mbriza@redhat.com>
+ * Copyright (C) 2020-2022 Dmitry Degtyarev <kevl@basealt.ru>
+ *
+ * ALT Media Writer is a fork of Fedora Media Writer
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "zsync.h"
+#include "file_type.h"
+
+#include <QCryptographicHash>
+#include <QDebug>
+#include <QDir>
+#include <QFileInfo>
+
+bool zsync_parse(const QByteArray &data, ZsyncManifest *manifest) {
+    const int header_end = data.indexOf("\n\n");
+    if (header_end == -1) {
+        qDebug() << "zsync: no header";
+        return false;
+    }
+
+    manifest->length = -1;
+    manifest->sha1.clear();
+    manifest->blockSize = 0;
+    manifest->seqMatches = 1;
+    manifest->rsumBytes = 0;
+    manifest->checksumBytes = 0;
+    manifest->rsums.clear();
+    manifest->checksums.clear();
+
+    // Header is a list of "Key: value" lines
+    const QList<QByteArray> header_lines = data.left(header_end).split('\n');
+    for (const QByteArray &line : header_lines) {
+        const int separator = line.indexOf(':');
+        if (separator == -1) {
+            continue;
+        }
+
+        const QByteArray key = line.left(separator).trimmed();
+        const QByteArray value = line.mid(separator + 1).trimmed();
+
+        if (key == "Length") {
+            manifest->length = value.toLongLong();
+        } else if (key == "SHA-1") {
+            manifest->sha1 = value.toLower();
+        } else if (key == "Blocksize") {
+            manifest->blockSize = value.toInt();
+        } else if (key == "Hash-Lengths") {
+            const QList<QByteArray> lengths = value.split(',');
+            if (lengths.size() == 3) {
+                manifest->seqMatches = lengths[0].toInt();
+                manifest->rsumBytes = lengths[1].toInt();
+                manifest->checksumBytes = lengths[2].toInt();
+            }
+        } else if (key == "Z-Map2") {
+            qDebug() << "zsync: compressed zsync files are not supported";
+            return false;
+        }
+    }
+
+    const bool block_size_is_valid = (manifest->blockSize > 0 && (manifest->blockSize & (manifest->blockSize - 1)) == 0);
+    const bool hash_lengths_are_valid = (manifest->seqMatches >= 1 && manifest->seqMatches <= 2 && manifest->rsumBytes >= 1 && manifest->rsumBytes <= 4 && manifest->checksumBytes >= 3 && manifest->checksumBytes <= 16);
+    if (manifest->length < 0 || !block_size_is_valid || !hash_lengths_are_valid) {
+        qDebug() << "zsync: invalid header";
+        return false;
+    }
+
+    manifest->blockShift = 0;
+    while ((1 << manifest->blockShift) < manifest->blockSize) {
+        manifest->blockShift++;
+    }
+
+    const qint64 block_count = (manifest->length + manifest->blockSize - 1) / manifest->blockSize;
+    const int entry_size = manifest->rsumBytes + manifest->checksumBytes;
+    const int body_start = header_end + 2;
+
+    if (data.size() - body_start < block_count * entry_size) {
+        qDebug() << "zsync: block checksums are truncated";
+        return false;
+    }
+
+    const uchar *body = (const uchar *) data.constData() + body_start;
+    for (qint64 i = 0; i < block_count; i++) {
+        const uchar *entry = body + i * entry_size;
+
+        // NOTE: rsum is stored as big endian "a" and "b"
+        // 16bit values, only last rsumBytes bytes of them
+        // are stored
+        quint32 rsum = 0;
+        for (int j = 0; j < manifest->rsumBytes; j++) {
+            rsum = (rsum << 8) | entry[j];
+        }
+
+        manifest->rsums.append(rsum);
+        manifest->checksums.append(QByteArray((const char *) entry + manifest->rsumBytes, manifest->checksumBytes));
+    }
+
+    return true;
+}
+
+quint32 zsync_rsum(const uchar *data, const int len) {
+    quint16 a = 0;
+    quint16 b = 0;
+
+    for (int i = 0; i < len; i++) {
+        a += data[i];
+        b += (len - i) * data[i];
+    }
+
+    return ((quint32) a << 16) | b;
+}
+
+quint32 zsync_rsum_roll(const quint32 rsum, const uchar old_c, const uchar new_c, const int block_shift) {
+    quint16 a = rsum >> 16;
+    quint16 b = rsum & 0xffff;
+
+    a += new_c - old_c;
+    b += a - (old_c << block_shift);
+
+    return ((quint32) a << 16) | b;
+}
+
+quint32 zsync_rsum_mask(const ZsyncManifest &manifest) {
+    if (manifest.rsumBytes >= 4) {
+        return 0xffffffff;
+    } else {
+        return (1U << (8 * manifest.rsumBytes)) - 1;
+    }
+}
+
+// NOTE: called for every candidate match while scanning
+// the seed, so the block is hashed in place
+QByteArray zsync_checksum(const ZsyncManifest &manifest, const uchar *data, const int len) {
+    QCryptographicHash md4(QCryptographicHash::Md4);
+    md4.addData((const char *) data, len);
+    if (len < manifest.blockSize) {
+        md4.addData(QByteArray(manifest.blockSize - len, '\0'));
+    }
+
+    return md4.result().left(manifest.checksumBytes);
+}
+
+// Name with every run of digits replaced by "#", images
+// with the same skeleton are builds of the same image
+QString zsync_name_skeleton(const QString &name) {
+    QString out;
+    for (int i = 0; i < name.size(); i++) {
+        if (name[i].isDigit()) {
+            if (out.isEmpty() || out[out.size() - 1] != '#') {
+                out += '#';
+            }
+        } else {
+            out += name[i];
+        }
+    }
+
+    return out;
+}
+
+QString zsync_find_seed(const QString &file_path) {
+    const QFileInfo target(file_path);
+    const FileType target_type = file_type_from_filename(target.fileName());
+    if (target_type == FileType_UNKNOWN) {
+        return QString();
+    }
+
+    const QString target_skeleton = zsync_name_skeleton(target.fileName());
+
+    const QDir dir = target.dir();
+    const QFileInfoList candidates = dir.entryInfoList(QDir::Files);
+
+    // Pick image of same type whose name has the longest
+    // common prefix with target name, this is usually a
+    // previous build of the same image
+    QString out;
+    int best_prefix = 0;
+    qint64 best_size = 0;
+
+    for (const QFileInfo &candidate : candidates) {
+        const QString name = candidate.fileName();
+
+        if (name == target.fileName() || file_type_from_filename(name) != target_type) {
+            continue;
+        }
+
+        int prefix = 0;
+        while (prefix < name.size() && prefix < target.fileName().size() && name[prefix] == target.fileName()[prefix]) {
+            prefix++;
+        }
+
+        // NOTE: unrelated images are not worth scanning,
+        // a short common prefix like "alt-" isn't enough,
+        // names have to differ only in version or date
+        if (zsync_name_skeleton(name) != target_skeleton) {
+            continue;
+        }
+
+        const bool is_better = (prefix > best_prefix || (prefix == best_prefix && candidate.size() > best_size));
+        if (is_better) {
+            out = candidate.filePath();
+            best_prefix = prefix;
+            best_size = candidate.size();
+        }
+    }
+
+    return out;
+}
@@ -0,0 +1,74 @@
+/*
+ * ALT Media Writer
+ * Copyright (C) 2016-2019 Martin Bříza <mbriza@redhat.com>
+ * Copyright (C) 2020-2022 Dmitry Degtyarev <kevl@basealt.ru>
+ *
+ * ALT Media Writer is a fork of Fedora Media Writer
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef ZSYNC_H
+#define ZSYNC_H
+
+/**
+ * Support for zsync control files (".zsync"), which are
+ * published next to images. A control file contains a
+ * rolling checksum and a strong checksum (truncated md4)
+ * for every block of the image. Blocks that are found in
+ * an older local image using the rolling checksum don't
+ * have to be downloaded.
+ *
+ * Only uncompressed zsync files are supported.
+ */
+
+#include <QByteArray>
+#include <QList>
+#include <QString>
+
+struct ZsyncManifest {
+    qint64 length;
+    // Hex sha1 of the whole image, empty if missing
+    QByteArray sha1;
+    int blockSize;
+    int blockShift;
+    // Number of consecutive blocks that have to match
+    // before a block is trusted, rsums are shortened by
+    // zsyncmake with that in mind
+    int seqMatches;
+    int rsumBytes;
+    int checksumBytes;
+    QList<quint32> rsums;
+    QList<QByteArray> checksums;
+};
+
+bool zsync_parse(const QByteArray &data, ZsyncManifest *manifest);
+
+// Rolling checksum is stored as "(a << 16) | b"
+quint32 zsync_rsum(const uchar *data, const int len);
+quint32 zsync_rsum_roll(const quint32 rsum, const uchar old_c, const uchar new_c, const int block_shift);
+quint32 zsync_rsum_mask(const ZsyncManifest &manifest);
+
+// Strong checksum of a block, data shorter than block
+// size is padded with zeroes
+QByteArray zsync_checksum(const ZsyncManifest &manifest, const uchar *data, const int len);
+
+// Find a local image that is most likely to share blocks
+// with the image that will be downloaded to file_path.
+// Only images whose names differ from it in numbers
+// (version, date) are considered.
+QString zsync_find_seed(const QString &file_path);
+
+#endif // ZSYNC_H
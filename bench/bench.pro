@@ -0,0 +1,7 @@
+TEMPLATE = subdirs
+
+# NOTE: benchmarks measure resource usage with Linux
+# interfaces and use the Linux helper's sources
+linux {
+    SUBDIRS = writebench hashbench mirror downloadbench
+}
@@ -0,0 +1,76 @@
+/*
+ * ALT Media Writer
+ * Copyright (C) 2016-2019 Martin Bříza <mbriza@redhat.com>
+ * Copyright (C) 2020-2022 Dmitry Degtyarev <kevl@basealt.ru>
+ *
+ * ALT Media Writer is a fork of Fedora Media Writer
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "benchutils.h"
+
+#include <QFile>
+#include <QHash>
+#include <QJsonDocument>
+#include <QSysInfo>
+#include <QTextStream>
+
+qint64 bench_parse_size(const QString &string) {
+    const QString upper = string.trimmed().toUpper();
+    if (upper.isEmpty()) {
+        return -1;
+    }
+
+    const QHash<QChar, qint64> multipliers = {
+        {'K', 1024LL},
+        {'M', 1024LL * 1024},
+        {'G', 1024LL * 1024 * 1024},
+    };
+
+    const QChar suffix = upper.at(upper.size() - 1);
+    const qint64 multiplier = multipliers.value(suffix, 1);
+    const QString number = multipliers.contains(suffix) ? upper.left(upper.size() - 1) : upper;
+
+    bool ok;
+    const qint64 value = number.toLongLong(&ok);
+    if (!ok || value < 0) {
+        return -1;
+    }
+
+    return value * multiplier;
+}
+
+bool bench_write_report(QJsonObject report, const QString &output_path) {
+    report["version"] = MEDIAWRITER_VERSION;
+    report["kernel"] = QSysInfo::kernelVersion();
+
+    const QByteArray json = QJsonDocument(report).toJson();
+
+    if (output_path.isEmpty()) {
+        QTextStream out(stdout);
+        out << json;
+
+        return true;
+    }
+
+    QFile file(output_path);
+    const bool open_success = file.open(QIODevice::WriteOnly | QIODevice::Truncate);
+    if (!open_success) {
+        return false;
+    }
+
+    return (file.write(json) == json.size());
+}
@@ -0,0 +1,39 @@
+/*
+ * ALT Media Writer
+ * Copyright (C) 2016-2019 Martin Bříza <mbriza@redhat.com>
+ * Copyright (C) 2020-2022 Dmitry Degtyarev <kevl@basealt.ru>
+ *
+ * ALT Media Writer is a fork of Fedora Media Writer
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef BENCHUTILS_H
+#define BENCHUTILS_H
+
+#include <QJsonObject>
+#include <QString>
+#include <QtGlobal>
+
+// Parses sizes like "4M", suffixes are powers of 1024.
+// Returns -1 if string is not a size.
+qint64 bench_parse_size(const QString &string);
+
+// Adds version of the program and of the kernel to the
+// report, then writes it to the file or to stdout if path
+// is empty
+bool bench_write_report(QJsonObject report, const QString &output_path);
+
+#endif // BENCHUTILS_H
@@ -0,0 +1,100 @@
+/*
+ * ALT Media Writer
+ * Copyright (C) 2016-2019 Martin Bříza <mbriza@redhat.com>
+ * Copyright (C) 2020-2022 Dmitry Degtyarev <kevl@basealt.ru>
+ *
+ * ALT Media Writer is a fork of Fedora Media Writer
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "resourceusage.h"
+
+#include <QFile>
+
+#include <sys/resource.h>
+#include <time.h>
+
+ResourceUsage resource_usage_now() {
+    ResourceUsage out;
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    out.wallNsecs = (qint64) now.tv_sec * 1000000000LL + now.tv_nsec;
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    out.userUsecs = (qint64) usage.ru_utime.tv_sec * 1000000LL + usage.ru_utime.tv_usec;
+    out.systemUsecs = (qint64) usage.ru_stime.tv_sec * 1000000LL + usage.ru_stime.tv_usec;
+    out.minorFaults = usage.ru_minflt;
+    out.majorFaults = usage.ru_majflt;
+
+    // NOTE: /proc/self/io may be missing if the kernel
+    // doesn't do task accounting
+    out.readSyscalls = 0;
+    out.writeSyscalls = 0;
+    QFile io("/proc/self/io");
+    if (io.open(QIODevice::ReadOnly)) {
+        for (const QByteArray &line : io.readAll().split('\n')) {
+            if (line.startsWith("syscr:")) {
+                out.readSyscalls = line.mid(6).trimmed().toLongLong();
+            } else if (line.startsWith("syscw:")) {
+                out.writeSyscalls = line.mid(6).trimmed().toLongLong();
+            }
+        }
+    }
+
+    return out;
+}
+
+ResourceUsage resource_usage_since(const ResourceUsage &start) {
+    const ResourceUsage now = resource_usage_now();
+
+    ResourceUsage out;
+    out.wallNsecs = now.wallNsecs - start.wallNsecs;
+    out.userUsecs = now.userUsecs - start.userUsecs;
+    out.systemUsecs = now.systemUsecs - start.systemUsecs;
+    out.readSyscalls = now.readSyscalls - start.readSyscalls;
+    out.writeSyscalls = now.writeSyscalls - start.writeSyscalls;
+    out.minorFaults = now.minorFaults - start.minorFaults;
+    out.majorFaults = now.majorFaults - start.majorFaults;
+
+    return out;
+}
+
+QJsonObject resource_usage_json(const ResourceUsage &usage, const qint64 bytes) {
+    const double seconds = (double) usage.wallNsecs / 1e9;
+
+    const double mb_per_s = [&]() {
+        if (seconds > 0) {
+            return (double) bytes / 1e6 / seconds;
+        } else {
+            return 0.0;
+        }
+    }();
+
+    QJsonObject out;
+    out["bytes"] = (double) bytes;
+    out["seconds"] = seconds;
+    out["mb_per_s"] = mb_per_s;
+    out["cpu_user_seconds"] = (double) usage.userUsecs / 1e6;
+    out["cpu_system_seconds"] = (double) usage.systemUsecs / 1e6;
+    out["read_syscalls"] = (double) usage.readSyscalls;
+    out["write_syscalls"] = (double) usage.writeSyscalls;
+    out["minor_faults"] = (double) usage.minorFaults;
+    out["major_faults"] = (double) usage.majorFaults;
+
+    return out;
+}
@@ -0,0 +1,49 @@
+/*
+ * ALT Media Writer
+ * Copyright (C) 2016-2019 Martin Bříza <mbriza@redhat.com>
+ * Copyright (C) 2020-2022 Dmitry Degtyarev <kevl@basealt.ru>
+ *
+ * ALT Media Writer is a fork of Fedora Media Writer
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef RESOURCEUSAGE_H
+#define RESOURCEUSAGE_H
+
+#include <QJsonObject>
+#include <QtGlobal>
+
+// Resources used by the whole process, including all of
+// its threads. Syscalls are only the ones that read or
+// write data, as counted by /proc/self/io.
+struct ResourceUsage {
+    qint64 wallNsecs;
+    qint64 userUsecs;
+    qint64 systemUsecs;
+    qint64 readSyscalls;
+    qint64 writeSyscalls;
+    qint64 minorFaults;
+    qint64 majorFaults;
+};
+
+ResourceUsage resource_usage_now();
+ResourceUsage resource_usage_since(const ResourceUsage &start);
+
+// Throughput is reported in MB/s for the given amount of
+// processed bytes
+QJsonObject resource_usage_json(const ResourceUsage &usage, const qint64 bytes);
+
+#endif // RESOURCEUSAGE_H
@@ -0,0 +1,121 @@
+/*
+ * ALT Media Writer
+ * Copyright (C) 2016-2019 Martin Bříza <mbriza@redhat.com>
+ * Copyright (C) 2020-2022 Dmitry Degtyarev <kevl@basealt.ru>
+ *
+ * ALT Media Writer is a fork of Fedora Media Writer
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "syntheticimage.h"
+
+#include <QByteArray>
+#include <QFile>
+
+#include <string.h>
+
+const qint64 SYNTHETIC_IMAGE_SECTOR = 2048;
+const qint64 SYNTHETIC_IMAGE_CHUNK = 1024 * 1024;
+
+// NOTE: xorshift is enough here, data only has to be
+// incompressible and repeatable
+static quint64 synthetic_image_random(quint64 *state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+
+    return *state;
+}
+
+static void synthetic_image_fill(char *data, const qint64 index, quint64 *state) {
+    switch (index % 4) {
+        case 0:
+        case 1: {
+            for (qint64 i = 0; i < SYNTHETIC_IMAGE_CHUNK; i += 8) {
+                const quint64 value = synthetic_image_random(state);
+                memcpy(data + i, &value, 8);
+            }
+            break;
+        }
+        case 2: {
+            const QByteArray line = QString("%1 synthetic image line\n").arg(index, 8, 10, QChar('0')).toLatin1();
+            for (qint64 i = 0; i < SYNTHETIC_IMAGE_CHUNK; i++) {
+                data[i] = line[(int) (i % line.size())];
+            }
+            break;
+        }
+        default: {
+            memset(data, 0, SYNTHETIC_IMAGE_CHUNK);
+            break;
+        }
+    }
+}
+
+// Writes the descriptors that the helper and
+// libcheckisomd5 look for
+static void synthetic_image_header(char *data, const qint64 sectors) {
+    memset(data, 0, 18 * SYNTHETIC_IMAGE_SECTOR);
+
+    char *primary = data + 16 * SYNTHETIC_IMAGE_SECTOR;
+    primary[0] = 1;
+    memcpy(primary + 1, "CD001", 5);
+    primary[6] = 1;
+
+    // NOTE: volume size is stored both little-endian
+    // and big-endian
+    for (int i = 0; i < 4; i++) {
+        primary[80 + i] = (char) ((sectors >> (8 * i)) & 0xff);
+        primary[87 - i] = (char) ((sectors >> (8 * i)) & 0xff);
+    }
+
+    char *terminator = data + 17 * SYNTHETIC_IMAGE_SECTOR;
+    terminator[0] = (char) 255;
+    memcpy(terminator + 1, "CD001", 5);
+    terminator[6] = 1;
+}
+
+bool synthetic_image_create(const QString &path, const qint64 size, const quint64 seed) {
+    const qint64 sectors = size / SYNTHETIC_IMAGE_SECTOR;
+    const qint64 total = sectors * SYNTHETIC_IMAGE_SECTOR;
+    if (total < 18 * SYNTHETIC_IMAGE_SECTOR) {
+        return false;
+    }
+
+    QFile file(path);
+    const bool open_success = file.open(QIODevice::WriteOnly | QIODevice::Truncate);
+    if (!open_success) {
+        return false;
+    }
+
+    QByteArray chunk(SYNTHETIC_IMAGE_CHUNK, 0);
+    quint64 state = (seed != 0) ? seed : 1;
+
+    for (qint64 offset = 0; offset < total; offset += SYNTHETIC_IMAGE_CHUNK) {
+        const qint64 index = offset / SYNTHETIC_IMAGE_CHUNK;
+        synthetic_image_fill(chunk.data(), index, &state);
+
+        if (index == 0) {
+            synthetic_image_header(chunk.data(), sectors);
+        }
+
+        const qint64 len = qMin(SYNTHETIC_IMAGE_CHUNK, total - offset);
+        if (file.write(chunk.constData(), len) != len) {
+            return false;
+        }
+    }
+
+    return true;
+}
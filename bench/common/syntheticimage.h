@@ -0,0 +1,37 @@
+/*
+ * ALT Media Writer
+ * Copyright (C) 2016-2019 Martin Bříza <mbriza@redhat.com>
+ * Copyright (C) 2020-2022 Dmitry Degtyarev <kevl@basealt.ru>
+ *
+ * ALT Media Writer is a fork of Fedora Media Writer
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef SYNTHETICIMAGE_H
+#define SYNTHETICIMAGE_H
+
+#include <QString>
+#include <QtGlobal>
+
+// Creates an image that is detected as ISO9660, so that
+// its checksum can be checked like on a real image. Size
+// is rounded down to whole sectors. Contents are a mix of
+// zeroes, text and random data, so that compressors work
+// about as well as on real images. Same seed gives the
+// same contents.
+bool synthetic_image_create(const QString &path, const qint64 size, const quint64 seed = 1);
+
+#endif // SYNTHETICIMAGE_H
@@ -0,0 +1,262 @@
+/*
+ * ALT Media Writer
+ * Copyright (C) 2016-2019 Martin Bříza <mbriza@redhat.com>
+ * Copyright (C) 2020-2022 Dmitry Degtyarev <kevl@basealt.ru>
+ *
+ * ALT Media Writer is a fork of Fedora Media Writer
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "downloadbench.h"
+#include "image_download.h"
+#include "release_model.h"
+#include "releasemanager.h"
+#include "resourceusage.h"
+
+#include <QDir>
+#include <QEventLoop>
+#include <QFile>
+#include <QFileInfo>
+#include <QSettings>
+#include <QTextStream>
+#include <QTimer>
+#include <QUrl>
+
+DownloadBench::DownloadBench(const DownloadBenchOptions &options_arg)
+: options(options_arg) {
+}
+
+DownloadBench::~DownloadBench() {
+    if (mirror.state() != QProcess::NotRunning) {
+        mirror.terminate();
+        mirror.waitForFinished();
+        QFile::remove(QDir(options.dir).filePath("mirror.iso"));
+    }
+
+    QFile::remove(downloadPath());
+    QFile::remove(downloadPath() + ".part");
+}
+
+bool DownloadBench::prepare() {
+    QTextStream err(stderr);
+
+    host = options.host;
+    imageUrl = options.imageUrl;
+    imageMd5 = options.imageMd5;
+
+    if (host.isEmpty()) {
+        err << "Starting " << options.mirrorPath << "\n";
+        err.flush();
+
+        mirror.setProcessChannelMode(QProcess::ForwardedErrorChannel);
+        mirror.start(options.mirrorPath, QStringList({"--dir=" + options.dir}) + options.mirrorArgs);
+
+        // NOTE: mirror reports its address once its
+        // image is ready
+        while (host.isEmpty() || imageUrl.isEmpty()) {
+            if (!mirror.canReadLine() && !mirror.waitForReadyRead(-1)) {
+                err << "Failed to start the mirror\n";
+                return false;
+            }
+
+            while (mirror.canReadLine()) {
+                const QList<QByteArray> words = mirror.readLine().trimmed().split(' ');
+
+                if (words.value(0) == "LISTENING") {
+                    host = QString::fromUtf8(words.value(1));
+                } else if (words.value(0) == "IMAGE") {
+                    imageUrl = QString::fromUtf8(words.value(1));
+                    imageMd5 = QString::fromUtf8(words.value(2));
+                }
+            }
+        }
+    }
+
+    // NOTE: release manager reads the host from settings
+    QSettings().setValue("Metadata/host", host);
+
+    return true;
+}
+
+QJsonArray DownloadBench::run() {
+    QTextStream err(stderr);
+
+    QJsonArray out;
+
+    for (const QString &name : options.cases) {
+        const bool needs_image = (name == "download" || name == "resume");
+        if (needs_image && imageUrl.isEmpty()) {
+            err << "No image to download, skipping " << name << "\n";
+            err.flush();
+            continue;
+        }
+
+        for (int run = 1; run <= options.repeat; run++) {
+            QJsonObject result = [&]() {
+                if (name == "catalogue") {
+                    return runCatalogue();
+                } else if (name == "download") {
+                    return runDownload();
+                } else {
+                    return runResume();
+                }
+            }();
+            result["case"] = name;
+            result["run"] = run;
+            out.append(result);
+
+            err << name << " #" << run << ": ";
+            if (!result["success"].toBool()) {
+                err << "failed\n";
+            } else if (name == "catalogue") {
+                err << QString::number(result["seconds"].toDouble(), 'f', 3) << " s\n";
+            } else {
+                err << QString::number(result["transfer_mb_per_s"].toDouble(), 'f', 1) << " MB/s\n";
+            }
+            err.flush();
+        }
+    }
+
+    return out;
+}
+
+// Time from construction of release manager until all
+// releases and variants are loaded
+QJsonObject DownloadBench::runCatalogue() {
+    const ResourceUsage start = resource_usage_now();
+
+    ReleaseManager *manager = new ReleaseManager();
+
+    QEventLoop loop;
+    QObject::connect(
+        manager, &ReleaseManager::downloadingMetadataChanged,
+        [&]() {
+            if (!manager->downloadingMetadata()) {
+                loop.quit();
+            }
+        });
+    QTimer::singleShot(options.timeoutSecs * 1000, &loop, &QEventLoop::quit);
+    loop.exec();
+
+    const ResourceUsage usage = resource_usage_since(start);
+
+    QJsonObject out = resource_usage_json(usage, 0);
+    out["success"] = !manager->downloadingMetadata();
+    out["releases"] = manager->getFilterModel()->rowCount();
+
+    delete manager;
+
+    return out;
+}
+
+QString DownloadBench::downloadPath() const {
+    return QDir(options.dir).filePath(QUrl(imageUrl).fileName());
+}
+
+QJsonObject DownloadBench::runDownload() {
+    QFile::remove(downloadPath());
+    QFile::remove(downloadPath() + ".part");
+
+    return measureDownload(0);
+}
+
+// Downloads half of the image and cancels, then measures
+// how a new download continues from there
+QJsonObject DownloadBench::runResume() {
+    QFile::remove(downloadPath());
+    QFile::remove(downloadPath() + ".part");
+
+    auto download = new ImageDownload(QUrl(imageUrl), downloadPath(), imageMd5);
+
+    QEventLoop loop;
+    QObject::connect(
+        download, &ImageDownload::progressMaxChanged,
+        [download](const qint64 max) {
+            QObject::connect(
+                download, &ImageDownload::progress,
+                [download, max](const qint64 value) {
+                    if (value >= max / 2) {
+                        download->cancel();
+                    }
+                });
+        });
+    QObject::connect(
+        download, &ImageDownload::finished,
+        &loop, &QEventLoop::quit);
+    QTimer::singleShot(options.timeoutSecs * 1000, download, &ImageDownload::cancel);
+    loop.exec();
+
+    const qint64 resumed_from = QFileInfo(downloadPath() + ".part").size();
+
+    QJsonObject out = measureDownload(resumed_from);
+    out["resumed_from"] = (double) resumed_from;
+
+    return out;
+}
+
+// Downloads the image, continuing from a partial download
+// if there is one. Whole download includes the md5 check,
+// transfer is also measured on its own.
+QJsonObject DownloadBench::measureDownload(const qint64 resumed_from) {
+    const ResourceUsage start = resource_usage_now();
+
+    auto download = new ImageDownload(QUrl(imageUrl), downloadPath(), imageMd5);
+
+    int interruptions = 0;
+    ImageDownload::Result result = ImageDownload::Cancelled;
+    ResourceUsage transfer = start;
+    bool transfer_finished = false;
+
+    QEventLoop loop;
+    QObject::connect(
+        download, &ImageDownload::interrupted,
+        [&]() {
+            interruptions++;
+        });
+    QObject::connect(
+        download, &ImageDownload::startedMd5Check,
+        [&]() {
+            transfer = resource_usage_since(start);
+            transfer_finished = true;
+        });
+    QObject::connect(
+        download, &ImageDownload::finished,
+        [&]() {
+            result = download->result();
+            loop.quit();
+        });
+    QTimer::singleShot(options.timeoutSecs * 1000, download, &ImageDownload::cancel);
+    loop.exec();
+
+    const ResourceUsage usage = resource_usage_since(start);
+    if (!transfer_finished) {
+        transfer = usage;
+    }
+
+    const qint64 downloaded = qMax((qint64) 0, QFileInfo(downloadPath()).size() - resumed_from);
+
+    QJsonObject out = resource_usage_json(usage, downloaded);
+    out["success"] = (result == ImageDownload::Success);
+    out["interruptions"] = interruptions;
+
+    const QJsonObject transfer_json = resource_usage_json(transfer, downloaded);
+    out["transfer_seconds"] = transfer_json["seconds"];
+    out["transfer_mb_per_s"] = transfer_json["mb_per_s"];
+
+    QFile::remove(downloadPath());
+
+    return out;
+}
@@ -0,0 +1,75 @@
+/*
+ * ALT Media Writer
+ * Copyright (C) 2016-2019 Martin Bříza <mbriza@redhat.com>
+ * Copyright (C) 2020-2022 Dmitry Degtyarev <kevl@basealt.ru>
+ *
+ * ALT Media Writer is a fork of Fedora Media Writer
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef DOWNLOADBENCH_H
+#define DOWNLOADBENCH_H
+
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QProcess>
+#include <QString>
+#include <QStringList>
+
+struct DownloadBenchOptions {
+    // Directory for downloads and the mirror's image
+    QString dir;
+    // Metadata host to use instead of starting the mirror
+    QString host;
+    // Image to download from the host, md5 is optional
+    QString imageUrl;
+    QString imageMd5;
+    QString mirrorPath;
+    // Passed to the mirror as is
+    QStringList mirrorArgs;
+    // "catalogue", "download" or "resume"
+    QStringList cases;
+    int repeat;
+    int timeoutSecs;
+};
+
+// Measures how long ReleaseManager takes to load the
+// catalogue and how fast ImageDownload downloads and
+// resumes images. By default, a local mirror is started
+// to serve them.
+class DownloadBench {
+public:
+    explicit DownloadBench(const DownloadBenchOptions &options_arg);
+    ~DownloadBench();
+
+    bool prepare();
+    QJsonArray run();
+
+private:
+    DownloadBenchOptions options;
+    QProcess mirror;
+    QString host;
+    QString imageUrl;
+    QString imageMd5;
+
+    QJsonObject runCatalogue();
+    QJsonObject runDownload();
+    QJsonObject runResume();
+    QJsonObject measureDownload(const qint64 resumed_from);
+    QString downloadPath() const;
+};
+
+#endif // DOWNLOADBENCH_H
@@ -0,0 +1,27 @@
+TEMPLATE = app
+
+CONFIG += c++11
+CONFIG += console
+
+TARGET = downloadbench
+
+include($$top_srcdir/deployment.pri)
+
+# NOTE: release manager and image download are compiled
+# from the app's sources, so that exactly they are measured
+include($$top_srcdir/app/sources.pri)
+
+INCLUDEPATH += ../common
+
+SOURCES += main.cpp \
+    downloadbench.cpp \
+    ../common/benchutils.cpp \
+    ../common/resourceusage.cpp
+
+HEADERS += \
+    downloadbench.h \
+    ../common/benchutils.h \
+    ../common/resourceusage.h
+
+# NOTE: releases without an icon are skipped
+RESOURCES += $$top_srcdir/app/assets.qrc
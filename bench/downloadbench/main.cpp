@@ -0,0 +1,139 @@
+/*
+ * ALT Media Writer
+ * Copyright (C) 2016-2019 Martin Bříza <mbriza@redhat.com>
+ * Copyright (C) 2020-2022 Dmitry Degtyarev <kevl@basealt.ru>
+ *
+ * ALT Media Writer is a fork of Fedora Media Writer
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include <QApplication>
+#include <QDir>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QLoggingCategory>
+#include <QSettings>
+#include <QTextStream>
+
+#include "benchutils.h"
+#include "downloadbench.h"
+
+int main(int argc, char *argv[]) {
+    // NOTE: release manager needs a gui application, but
+    // nothing is shown
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM")) {
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
+
+    QApplication app(argc, argv);
+
+    // NOTE: app code logs every step, which would get
+    // mixed with progress
+    QLoggingCategory::setFilterRules("*.debug=false");
+
+    QTextStream err(stderr);
+
+    DownloadBenchOptions options;
+    options.dir = QDir::tempPath();
+    options.mirrorPath = QDir(app.applicationDirPath()).filePath("../mirror/mirror");
+    options.cases = QStringList({"catalogue", "download", "resume"});
+    options.repeat = 3;
+    options.timeoutSecs = 600;
+    QString output_path;
+
+    // NOTE: these are passed to the mirror
+    const QStringList mirror_options = {"--size", "--releases", "--latency", "--bandwidth", "--drop-after", "--error-rate", "--seed"};
+
+    for (const QString &arg : app.arguments().mid(1)) {
+        const QString name = arg.section("=", 0, 0);
+        const QString value = arg.section("=", 1);
+
+        bool valid = !value.isEmpty();
+
+        if (mirror_options.contains(name)) {
+            options.mirrorArgs.append(arg);
+        } else if (name == "--dir") {
+            options.dir = value;
+        } else if (name == "--host") {
+            options.host = value;
+        } else if (name == "--image") {
+            options.imageUrl = value;
+        } else if (name == "--md5") {
+            options.imageMd5 = value;
+        } else if (name == "--mirror") {
+            options.mirrorPath = value;
+        } else if (name == "--cases") {
+            options.cases = value.split(",");
+            for (const QString &case_name : options.cases) {
+                valid = valid && (case_name == "catalogue" || case_name == "download" || case_name == "resume");
+            }
+        } else if (name == "--repeat") {
+            options.repeat = value.toInt();
+            valid = (options.repeat > 0);
+        } else if (name == "--timeout") {
+            options.timeoutSecs = value.toInt();
+            valid = (options.timeoutSecs > 0);
+        } else if (name == "--output") {
+            output_path = value;
+        } else {
+            valid = false;
+        }
+
+        if (!valid) {
+            err << "Usage: downloadbench [--dir=/tmp] [--cases=catalogue,download,resume] [--repeat=3] [--timeout=600] [--output=FILE]\n"
+                << "                     [--host=URL [--image=URL] [--md5=SUM]] [--mirror=PATH]\n"
+                << "                     [--size=256M] [--releases=10] [--latency=MILLIS] [--bandwidth=BYTES] [--drop-after=BYTES] [--error-rate=0.1] [--seed=1]\n";
+            return 1;
+        }
+    }
+
+    // NOTE: settings of the benchmark are kept in its
+    // directory, so that they don't mix with the app's
+    QSettings::setPath(QSettings::NativeFormat, QSettings::UserScope, options.dir);
+    QApplication::setOrganizationName("downloadbench");
+    QApplication::setApplicationName("downloadbench");
+
+    QJsonArray results;
+    {
+        DownloadBench bench(options);
+
+        const bool prepare_success = bench.prepare();
+        if (!prepare_success) {
+            return 1;
+        }
+
+        results = bench.run();
+    }
+
+    QFile::remove(QSettings().fileName());
+    QDir(options.dir).rmdir("downloadbench");
+
+    QJsonObject report;
+    report["benchmark"] = "download";
+    report["host"] = options.host.isEmpty() ? "mirror" : options.host;
+    report["mirror_options"] = QJsonArray::fromStringList(options.mirrorArgs);
+    report["repeat"] = options.repeat;
+    report["results"] = results;
+
+    const bool report_success = bench_write_report(report, output_path);
+    if (!report_success) {
+        err << "Failed to write " << output_path << "\n";
+        return 1;
+    }
+
+    return 0;
+}
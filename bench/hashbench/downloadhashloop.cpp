@@ -0,0 +1,75 @@
+/*
+ * ALT Media Writer
+ * Copyright (C) 2016-2019 Martin Bříza <mbriza@redhat.com>
+ * Copyright (C) 2020-2022 Dmitry Degtyarev <kevl@basealt.ru>
+ *
+ * ALT Media Writer is a fork of Fedora Media Writer
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "downloadhashloop.h"
+
+#include <QTimer>
+
+DownloadHashLoop::DownloadHashLoop(const QString &path, const qint64 chunk_size_arg)
+: QObject()
+, file(path)
+, chunkSize(chunk_size_arg)
+, hash(QCryptographicHash::Md5) {
+    m_failed = false;
+}
+
+bool DownloadHashLoop::failed() const {
+    return m_failed;
+}
+
+QByteArray DownloadHashLoop::result() const {
+    return m_result;
+}
+
+void DownloadHashLoop::start() {
+    const bool open_success = file.open(QIODevice::ReadOnly);
+    if (!open_success) {
+        m_failed = true;
+        emit finished();
+
+        return;
+    }
+
+    computeMd5();
+}
+
+void DownloadHashLoop::computeMd5() {
+    const QByteArray bytes = file.read(chunkSize);
+    const bool read_success = (bytes.size() > 0);
+
+    if (read_success) {
+        hash.addData(bytes);
+        emit progress(file.pos());
+
+        if (file.atEnd()) {
+            m_result = hash.result().toHex();
+            file.close();
+            emit finished();
+        } else {
+            QTimer::singleShot(0, this, &DownloadHashLoop::computeMd5);
+        }
+    } else {
+        m_failed = true;
+        file.close();
+        emit finished();
+    }
+}
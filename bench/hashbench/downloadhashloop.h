@@ -0,0 +1,62 @@
+/*
+ * ALT Media Writer
+ * Copyright (C) 2016-2019 Martin Bříza <mbriza@redhat.com>
+ * Copyright (C) 2020-2022 Dmitry Degtyarev <kevl@basealt.ru>
+ *
+ * ALT Media Writer is a fork of Fedora Media Writer
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef DOWNLOADHASHLOOP_H
+#define DOWNLOADHASHLOOP_H
+
+#include <QCryptographicHash>
+#include <QFile>
+#include <QObject>
+
+// Hashes a file the same way as ImageDownload::computeMd5()
+// does after a download, one chunk per event loop iteration
+// with progress reported after every chunk. ImageDownload
+// itself can't run without a server, so its loop is copied
+// here with chunk size made adjustable.
+class DownloadHashLoop final : public QObject {
+    Q_OBJECT
+
+public:
+    DownloadHashLoop(const QString &path, const qint64 chunk_size_arg);
+
+    bool failed() const;
+    QByteArray result() const;
+
+signals:
+    void progress(const qint64 value);
+    void finished();
+
+public slots:
+    void start();
+
+private slots:
+    void computeMd5();
+
+private:
+    QFile file;
+    qint64 chunkSize;
+    QCryptographicHash hash;
+    bool m_failed;
+    QByteArray m_result;
+};
+
+#endif // DOWNLOADHASHLOOP_H
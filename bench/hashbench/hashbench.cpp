@@ -0,0 +1,318 @@
+/*
+ * ALT Media Writer
+ * Copyright (C) 2016-2019 Martin Bříza <mbriza@redhat.com>
+ * Copyright (C) 2020-2022 Dmitry Degtyarev <kevl@basealt.ru>
+ *
+ * ALT Media Writer is a fork of Fedora Media Writer
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "hashbench.h"
+#include "downloadhashloop.h"
+#include "image_check.h"
+#include "resourceusage.h"
+#include "syntheticimage.h"
+
+#include "isomd5/libcheckisomd5.h"
+
+#include <QDir>
+#include <QEventLoop>
+#include <QFile>
+#include <QHash>
+#include <QTextStream>
+#include <QTimer>
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <vector>
+
+static const QHash<QString, QCryptographicHash::Algorithm> algorithms = {
+    {"md5", QCryptographicHash::Md5},
+    {"sha1", QCryptographicHash::Sha1},
+    {"sha256", QCryptographicHash::Sha256},
+    {"sha512", QCryptographicHash::Sha512},
+};
+
+// NOTE: the app reports progress of the check, so the
+// callback is called, but does nothing
+static int hash_bench_callback(void *data, long long offset, long long total) {
+    Q_UNUSED(data);
+    Q_UNUSED(offset);
+    Q_UNUSED(total);
+
+    return 0;
+}
+
+HashBench::HashBench(const HashBenchOptions &options_arg)
+: options(options_arg) {
+    imagePath = QDir(options.dir).filePath("hashbench.iso");
+}
+
+HashBench::~HashBench() {
+    QFile::remove(imagePath);
+}
+
+QStringList HashBench::algorithmNames() {
+    return {"md5", "sha1", "sha256", "sha512"};
+}
+
+bool HashBench::prepare() {
+    QTextStream err(stderr);
+
+    err << "Creating " << imagePath << "\n";
+    err.flush();
+
+    const bool create_success = synthetic_image_create(imagePath, options.imageSize);
+    if (!create_success) {
+        err << "Failed to create " << imagePath << "\n";
+        return false;
+    }
+
+    QFile file(imagePath);
+    file.open(QIODevice::ReadOnly);
+    QCryptographicHash hash(QCryptographicHash::Md5);
+    hash.addData(&file);
+    md5 = hash.result().toHex();
+
+    // NOTE: only clean pages can be dropped from the
+    // page cache
+    const int fd = open(QFile::encodeName(imagePath).constData(), O_RDONLY | O_CLOEXEC);
+    if (fd >= 0) {
+        fsync(fd);
+        close(fd);
+    }
+
+    for (const QString &algorithm : options.algorithms) {
+        if (!algorithms.contains(algorithm)) {
+            err << "Unknown hash algorithm " << algorithm << "\n";
+            return false;
+        }
+    }
+
+    return true;
+}
+
+QJsonArray HashBench::run() {
+    QTextStream err(stderr);
+
+    QJsonArray out;
+
+    const auto add_result = [&](QJsonObject result, const QString &name, const size_t buffer_size, const QString &algorithm, const int run) {
+        result["case"] = name;
+        result["buffer_size"] = (double) buffer_size;
+        result["algorithm"] = algorithm;
+        result["run"] = run;
+        out.append(result);
+
+        err << name << " " << algorithm << " " << buffer_size << " " << result["cache"].toString() << " #" << run << ": ";
+        if (result["success"].toBool()) {
+            err << QString::number(result["mb_per_s"].toDouble(), 'f', 1) << " MB/s\n";
+        } else {
+            err << "failed\n";
+        }
+        err.flush();
+    };
+
+    for (const QString &cache_state : options.cacheStates) {
+        for (int run = 1; run <= options.repeat; run++) {
+            // NOTE: libcheckisomd5 reads with a fixed
+            // buffer, which is what its results are for
+            const QJsonObject file_result = measure(cache_state, [&]() {
+                return (mediaCheckFile(QFile::encodeName(imagePath).constData(), md5.toLatin1().constData(), &hash_bench_callback, nullptr) == ISOMD5SUM_CHECK_PASSED);
+            });
+            add_result(file_result, "mediaCheckFile", 32768, "md5", run);
+
+            const QJsonObject fd_result = measure(cache_state, [&]() {
+                const int fd = open(QFile::encodeName(imagePath).constData(), O_RDONLY | O_CLOEXEC);
+                const int check_result = mediaCheckFD(fd, md5.toLatin1().constData(), &hash_bench_callback, nullptr);
+                if (fd >= 0) {
+                    close(fd);
+                }
+
+                return (check_result == ISOMD5SUM_CHECK_PASSED);
+            });
+            add_result(fd_result, "mediaCheckFD", 32768, "md5", run);
+
+            const QJsonObject check_result = measure(cache_state, [&]() {
+                return imageCheck();
+            });
+            add_result(check_result, "ImageCheck", 1024 * 1024, "md5", run);
+
+            for (const size_t buffer_size : options.bufferSizes) {
+                const QJsonObject download_result = measure(cache_state, [&]() {
+                    return downloadHashLoop(buffer_size);
+                });
+                add_result(download_result, "ImageDownload", buffer_size, "md5", run);
+            }
+
+            for (const QString &algorithm : options.algorithms) {
+                for (const size_t buffer_size : options.bufferSizes) {
+                    const QJsonObject loop_result = measure(cache_state, [&]() {
+                        return hashLoop(buffer_size, algorithms[algorithm]);
+                    });
+                    add_result(loop_result, "hash_loop", buffer_size, algorithm, run);
+                }
+            }
+        }
+    }
+
+    return out;
+}
+
+// Cold state drops the image from the page cache, warm
+// state reads all of it into the cache
+void HashBench::setCacheState(const QString &state) {
+    const int fd = open(QFile::encodeName(imagePath).constData(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return;
+    }
+
+    if (state == "cold") {
+        posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    } else {
+        std::vector<char> buffer(1024 * 1024);
+        while (read(fd, buffer.data(), buffer.size()) > 0) {
+        }
+    }
+
+    close(fd);
+}
+
+// Returns which part of the image is in the page cache,
+// so that cold results on tmpfs can be told apart
+double HashBench::cachedFraction() const {
+    const int fd = open(QFile::encodeName(imagePath).constData(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return 0;
+    }
+
+    const qint64 size = lseek(fd, 0, SEEK_END);
+    void *map = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return 0;
+    }
+
+    const qint64 page_size = getpagesize();
+    std::vector<unsigned char> pages((size + page_size - 1) / page_size);
+    const bool mincore_success = (mincore(map, size, pages.data()) == 0);
+    munmap(map, size);
+    if (!mincore_success || pages.empty()) {
+        return 0;
+    }
+
+    qint64 cached = 0;
+    for (const unsigned char page : pages) {
+        if (page & 1) {
+            cached++;
+        }
+    }
+
+    return (double) cached / pages.size();
+}
+
+QJsonObject HashBench::measure(const QString &cache_state, const std::function<bool()> &run_function) {
+    setCacheState(cache_state);
+    const double cached = cachedFraction();
+
+    const ResourceUsage start = resource_usage_now();
+    const bool success = run_function();
+    const ResourceUsage usage = resource_usage_since(start);
+
+    QJsonObject out = resource_usage_json(usage, QFile(imagePath).size());
+    out["success"] = success;
+    out["cache"] = cache_state;
+    out["cached_before"] = cached;
+
+    return out;
+}
+
+// Same as the hashing loop of libcheckisomd5, but with
+// any buffer size and hash algorithm
+bool HashBench::hashLoop(const size_t buffer_size, const QCryptographicHash::Algorithm algorithm) {
+    const int fd = open(QFile::encodeName(imagePath).constData(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+
+    void *buffer = nullptr;
+    if (posix_memalign(&buffer, getpagesize(), buffer_size) != 0) {
+        close(fd);
+        return false;
+    }
+
+    QCryptographicHash hash(algorithm);
+    ssize_t len;
+    while ((len = read(fd, buffer, buffer_size)) > 0) {
+        hash.addData((const char *) buffer, len);
+    }
+
+    free(buffer);
+    close(fd);
+
+    if (algorithm == QCryptographicHash::Md5) {
+        return (len == 0 && hash.result().toHex() == md5.toLatin1());
+    } else {
+        return (len == 0);
+    }
+}
+
+bool HashBench::downloadHashLoop(const size_t chunk_size) {
+    DownloadHashLoop hash_loop(imagePath, chunk_size);
+
+    qint64 progress = 0;
+    QObject::connect(
+        &hash_loop, &DownloadHashLoop::progress,
+        [&progress](const qint64 value) {
+            progress = value;
+        });
+
+    QEventLoop loop;
+    QObject::connect(
+        &hash_loop, &DownloadHashLoop::finished,
+        &loop, &QEventLoop::quit);
+    QTimer::singleShot(0, &hash_loop, &DownloadHashLoop::start);
+    loop.exec();
+
+    return (!hash_loop.failed() && hash_loop.result() == md5.toLatin1());
+}
+
+bool HashBench::imageCheck() {
+    // NOTE: check deletes itself when finished
+    auto check = new ImageCheck(imagePath, md5);
+
+    bool passed = false;
+    qint64 progress = 0;
+    QObject::connect(
+        check, &ImageCheck::progress,
+        [&progress](const qint64 value) {
+            progress = value;
+        });
+
+    QEventLoop loop;
+    QObject::connect(
+        check, &ImageCheck::finished,
+        [&]() {
+            passed = check->passed();
+            loop.quit();
+        });
+    loop.exec();
+
+    return passed;
+}
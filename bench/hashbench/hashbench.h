@@ -0,0 +1,77 @@
+/*
+ * ALT Media Writer
+ * Copyright (C) 2016-2019 Martin Bříza <mbriza@redhat.com>
+ * Copyright (C) 2020-2022 Dmitry Degtyarev <kevl@basealt.ru>
+ *
+ * ALT Media Writer is a fork of Fedora Media Writer
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef HASHBENCH_H
+#define HASHBENCH_H
+
+#include <QCryptographicHash>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QList>
+#include <QString>
+#include <QStringList>
+
+#include <cstddef>
+#include <functional>
+
+struct HashBenchOptions {
+    qint64 imageSize;
+    // Directory for the image. Cold cache can't be tested
+    // on tmpfs, because its pages can't be dropped.
+    QString dir;
+    QList<size_t> bufferSizes;
+    // "md5", "sha1", "sha256" or "sha512"
+    QStringList algorithms;
+    // "cold" or "warm"
+    QStringList cacheStates;
+    int repeat;
+};
+
+// Measures how fast images are checked: libcheckisomd5 as
+// the helper uses it, ImageCheck and the hashing loop of
+// ImageDownload as the app uses them, and a plain
+// read-and-hash loop with different buffer sizes and hash
+// algorithms to compare them against.
+class HashBench {
+public:
+    explicit HashBench(const HashBenchOptions &options);
+    ~HashBench();
+
+    bool prepare();
+    QJsonArray run();
+
+    static QStringList algorithmNames();
+
+private:
+    HashBenchOptions options;
+    QString imagePath;
+    QString md5;
+
+    void setCacheState(const QString &state);
+    double cachedFraction() const;
+    QJsonObject measure(const QString &cache_state, const std::function<bool()> &run_function);
+    bool hashLoop(const size_t buffer_size, const QCryptographicHash::Algorithm algorithm);
+    bool downloadHashLoop(const size_t chunk_size);
+    bool imageCheck();
+};
+
+#endif // HASHBENCH_H
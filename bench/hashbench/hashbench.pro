@@ -0,0 +1,34 @@
+TEMPLATE = app
+
+QT += core
+
+LIBS += -lisomd5
+
+CONFIG += c++11
+CONFIG += console
+
+TARGET = hashbench
+
+include($$top_srcdir/deployment.pri)
+
+# NOTE: ImageCheck is compiled from the app's sources, so
+# that exactly it is measured
+APP_DIR = $$top_srcdir/app
+
+INCLUDEPATH += $$APP_DIR ../common
+
+SOURCES = main.cpp \
+    hashbench.cpp \
+    downloadhashloop.cpp \
+    ../common/benchutils.cpp \
+    ../common/resourceusage.cpp \
+    ../common/syntheticimage.cpp \
+    $$APP_DIR/image_check.cpp
+
+HEADERS += \
+    hashbench.h \
+    downloadhashloop.h \
+    ../common/benchutils.h \
+    ../common/resourceusage.h \
+    ../common/syntheticimage.h \
+    $$APP_DIR/image_check.h
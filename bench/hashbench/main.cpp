@@ -0,0 +1,115 @@
+/*
+ * ALT Media Writer
+ * Copyright (C) 2016-2019 Martin Bříza <mbriza@redhat.com>
+ * Copyright (C) 2020-2022 Dmitry Degtyarev <kevl@basealt.ru>
+ *
+ * ALT Media Writer is a fork of Fedora Media Writer
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include <QCoreApplication>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QLoggingCategory>
+#include <QTextStream>
+
+#include "benchutils.h"
+#include "hashbench.h"
+
+int main(int argc, char *argv[]) {
+    QCoreApplication app(argc, argv);
+
+    // NOTE: ImageCheck logs every check, which would
+    // get mixed with progress
+    QLoggingCategory::setFilterRules("*.debug=false");
+
+    QTextStream err(stderr);
+
+    HashBenchOptions options;
+    options.imageSize = 1024LL * 1024 * 1024;
+    options.dir = ".";
+    options.bufferSizes = {4 * 1024, 32 * 1024, 64 * 1024, 1024 * 1024, 4 * 1024 * 1024};
+    options.algorithms = HashBench::algorithmNames();
+    options.cacheStates = QStringList({"cold", "warm"});
+    options.repeat = 3;
+    QString output_path;
+
+    for (const QString &arg : app.arguments().mid(1)) {
+        const QString name = arg.section("=", 0, 0);
+        const QString value = arg.section("=", 1);
+
+        bool valid = !value.isEmpty();
+
+        if (name == "--size") {
+            options.imageSize = bench_parse_size(value);
+            valid = (options.imageSize > 0);
+        } else if (name == "--dir") {
+            options.dir = value;
+        } else if (name == "--buffer-sizes") {
+            options.bufferSizes.clear();
+            for (const QString &size_string : value.split(",")) {
+                const qint64 size = bench_parse_size(size_string);
+                valid = valid && (size > 0);
+                options.bufferSizes.append((size_t) size);
+            }
+        } else if (name == "--algorithms") {
+            options.algorithms = value.split(",");
+        } else if (name == "--cache") {
+            options.cacheStates = value.split(",");
+            for (const QString &state : options.cacheStates) {
+                valid = valid && (state == "cold" || state == "warm");
+            }
+        } else if (name == "--repeat") {
+            options.repeat = value.toInt();
+            valid = (options.repeat > 0);
+        } else if (name == "--output") {
+            output_path = value;
+        } else {
+            valid = false;
+        }
+
+        if (!valid) {
+            err << "Usage: hashbench [--size=1G] [--dir=.] [--buffer-sizes=4K,32K,64K,1M,4M] [--algorithms=md5,sha1,sha256,sha512] [--cache=cold,warm] [--repeat=3] [--output=FILE]\n";
+            return 1;
+        }
+    }
+
+    QJsonArray results;
+    {
+        HashBench bench(options);
+
+        const bool prepare_success = bench.prepare();
+        if (!prepare_success) {
+            return 1;
+        }
+
+        results = bench.run();
+    }
+
+    QJsonObject report;
+    report["benchmark"] = "hash";
+    report["image_size"] = (double) options.imageSize;
+    report["repeat"] = options.repeat;
+    report["results"] = results;
+
+    const bool report_success = bench_write_report(report, output_path);
+    if (!report_success) {
+        err << "Failed to write " << output_path << "\n";
+        return 1;
+    }
+
+    return 0;
+}
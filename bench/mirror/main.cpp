@@ -0,0 +1,117 @@
+/*
+ * ALT Media Writer
+ * Copyright (C) 2016-2019 Martin Bříza <mbriza@redhat.com>
+ * Copyright (C) 2020-2022 Dmitry Degtyarev <kevl@basealt.ru>
+ *
+ * ALT Media Writer is a fork of Fedora Media Writer
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include <QCoreApplication>
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFile>
+#include <QTextStream>
+
+#include "benchutils.h"
+#include "mirrorserver.h"
+#include "syntheticimage.h"
+
+int main(int argc, char *argv[]) {
+    QCoreApplication app(argc, argv);
+
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+
+    MirrorOptions options;
+    options.port = 0;
+    options.releases = 10;
+    options.latencyMillis = 0;
+    options.bandwidth = 0;
+    options.dropAfter = 0;
+    options.errorRate = 0;
+    options.seed = 1;
+    qint64 image_size = 256LL * 1024 * 1024;
+    QString dir = QDir::tempPath();
+
+    for (const QString &arg : app.arguments().mid(1)) {
+        const QString name = arg.section("=", 0, 0);
+        const QString value = arg.section("=", 1);
+
+        bool valid = !value.isEmpty();
+
+        if (name == "--port") {
+            options.port = value.toUShort(&valid);
+        } else if (name == "--dir") {
+            dir = value;
+        } else if (name == "--size") {
+            image_size = bench_parse_size(value);
+            valid = (image_size > 0);
+        } else if (name == "--releases") {
+            options.releases = value.toInt();
+            valid = (options.releases > 0);
+        } else if (name == "--latency") {
+            options.latencyMillis = value.toInt();
+            valid = (options.latencyMillis >= 0);
+        } else if (name == "--bandwidth") {
+            options.bandwidth = bench_parse_size(value);
+            valid = (options.bandwidth >= 0);
+        } else if (name == "--drop-after") {
+            options.dropAfter = bench_parse_size(value);
+            valid = (options.dropAfter >= 0);
+        } else if (name == "--error-rate") {
+            options.errorRate = value.toDouble(&valid);
+            valid = valid && (options.errorRate >= 0 && options.errorRate < 1);
+        } else if (name == "--seed") {
+            options.seed = value.toUInt(&valid);
+        } else {
+            valid = false;
+        }
+
+        if (!valid) {
+            err << "Usage: mirror [--port=0] [--dir=/tmp] [--size=256M] [--releases=10] [--latency=MILLIS] [--bandwidth=BYTES] [--drop-after=BYTES] [--error-rate=0.1] [--seed=1]\n";
+            return 1;
+        }
+    }
+
+    // NOTE: image is kept after exit, so that it can be
+    // removed by whoever started the mirror
+    options.imagePath = QDir(dir).filePath("mirror.iso");
+    const bool create_success = synthetic_image_create(options.imagePath, image_size, options.seed);
+    if (!create_success) {
+        err << "Failed to create " << options.imagePath << "\n";
+        return 1;
+    }
+
+    QFile image(options.imagePath);
+    image.open(QIODevice::ReadOnly);
+    QCryptographicHash hash(QCryptographicHash::Md5);
+    hash.addData(&image);
+    options.imageMd5 = hash.result().toHex();
+
+    MirrorServer server(options);
+    const bool listen_success = server.listen();
+    if (!listen_success) {
+        err << "Failed to listen on port " << options.port << "\n";
+        return 1;
+    }
+
+    out << "LISTENING " << server.url() << "\n";
+    out << "IMAGE " << server.firstImageUrl() << " " << options.imageMd5 << "\n";
+    out.flush();
+
+    return app.exec();
+}
@@ -0,0 +1,22 @@
+TEMPLATE = app
+
+QT += core network
+
+CONFIG += c++11
+CONFIG += console
+
+TARGET = mirror
+
+include($$top_srcdir/deployment.pri)
+
+INCLUDEPATH += ../common
+
+SOURCES = main.cpp \
+    mirrorserver.cpp \
+    ../common/benchutils.cpp \
+    ../common/syntheticimage.cpp
+
+HEADERS += \
+    mirrorserver.h \
+    ../common/benchutils.h \
+    ../common/syntheticimage.h
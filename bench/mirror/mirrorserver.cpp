@@ -0,0 +1,327 @@
+/*
+ * ALT Media Writer
+ * Copyright (C) 2016-2019 Martin Bříza <mbriza@redhat.com>
+ * Copyright (C) 2020-2022 Dmitry Degtyarev <kevl@basealt.ru>
+ *
+ * ALT Media Writer is a fork of Fedora Media Writer
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "mirrorserver.h"
+
+#include <QFileInfo>
+#include <QRegularExpression>
+#include <QTcpSocket>
+#include <QUrl>
+
+// NOTE: images are read in small chunks so that
+// bandwidth limit is smooth
+const qint64 MIRROR_CHUNK_SIZE = 64 * 1024;
+const qint64 MIRROR_SOCKET_BUFFER = 1024 * 1024;
+const int MIRROR_PUMP_INTERVAL_MILLIS = 10;
+
+// NOTE: icons have to exist in the app's resources,
+// otherwise releases are skipped
+static const QStringList mirror_icons = {
+    "alt-workstation",
+    "alt-kworkstation",
+    "alt-server-v",
+    "arm",
+    "alt-edu",
+    "simply",
+    "starterkits",
+};
+
+static const QStringList mirror_arches = {
+    "x86_64",
+    "i586",
+    "aarch64",
+    "e2k",
+};
+
+MirrorServer::MirrorServer(const MirrorOptions &options_arg)
+: QObject()
+, options(options_arg)
+, random(options_arg.seed) {
+    connect(
+        &server, &QTcpServer::newConnection,
+        this, &MirrorServer::onNewConnection);
+}
+
+bool MirrorServer::listen() {
+    const bool listen_success = server.listen(QHostAddress::LocalHost, options.port);
+    if (!listen_success) {
+        return false;
+    }
+
+    createMetadata();
+
+    return true;
+}
+
+QString MirrorServer::url() const {
+    return QString("http://127.0.0.1:%1").arg(server.serverPort());
+}
+
+QString MirrorServer::firstImageUrl() const {
+    return m_firstImageUrl;
+}
+
+void MirrorServer::onNewConnection() {
+    while (server.hasPendingConnections()) {
+        new MirrorConnection(server.nextPendingConnection(), this);
+    }
+}
+
+// Lays out files like getalt.org does: every release has
+// its own images yml file and images folder with a MD5SUM
+void MirrorServer::createMetadata() {
+    QByteArray sections = "members:\n";
+    QByteArray image_list;
+
+    for (int i = 1; i <= options.releases; i++) {
+        const QString code = QString("bench-%1").arg(i);
+        const QString icon = mirror_icons[(i - 1) % mirror_icons.size()];
+
+        sections += QString(
+            "  - code: %1\n"
+            "    name_en: Benchmark %2\n"
+            "    name_ru: Benchmark %2\n"
+            "    descr_en: Synthetic release %2\n"
+            "    descr_ru: Synthetic release %2\n"
+            "    descr_full_en: Synthetic release %2 served by the mirror\n"
+            "    descr_full_ru: Synthetic release %2 served by the mirror\n"
+            "    img: %3\n").arg(code).arg(i).arg(icon).toUtf8();
+
+        const QString images_path = QString("/metadata/images-%1.yml").arg(i);
+        image_list += (url() + images_path + "\n").toUtf8();
+
+        QByteArray images_yml = "entries:\n";
+        QByteArray md5sum;
+
+        for (const QString &arch : mirror_arches) {
+            const QString name = QString("%1-%2.iso").arg(code, arch);
+            const QString path = QString("/images/%1/%2").arg(code, name);
+
+            images_yml += QString(
+                "  - link: %1\n"
+                "    solution: %2\n"
+                "    arch: %3\n"
+                "    live: %4\n").arg(url() + path, code, arch, (arch == "x86_64") ? "1" : "0").toUtf8();
+
+            md5sum += QString("%1  %2\n").arg(options.imageMd5, name).toUtf8();
+
+            images.insert(path);
+            if (m_firstImageUrl.isEmpty()) {
+                m_firstImageUrl = url() + path;
+            }
+        }
+
+        files[images_path] = images_yml;
+        files[QString("/images/%1/MD5SUM").arg(code)] = md5sum;
+    }
+
+    files["/metadata/sections.yml"] = sections;
+    files["/altmediawriter_section_url_list.txt"] = (url() + "/metadata/sections.yml\n").toUtf8();
+    files["/altmediawriter_image_url_list.txt"] = image_list;
+}
+
+bool MirrorServer::nextRequestFails() {
+    if (options.errorRate <= 0) {
+        return false;
+    }
+
+    std::uniform_real_distribution<double> distribution(0.0, 1.0);
+
+    return (distribution(random) < options.errorRate);
+}
+
+MirrorConnection::MirrorConnection(QTcpSocket *socket_arg, MirrorServer *server_arg)
+: QObject(server_arg)
+, socket(socket_arg)
+, server(server_arg) {
+    responding = false;
+    bodyOffset = 0;
+    bodyEnd = 0;
+    sent = 0;
+
+    socket->setParent(this);
+
+    connect(
+        socket, &QTcpSocket::readyRead,
+        this, &MirrorConnection::onReadyRead);
+    connect(
+        socket, &QTcpSocket::disconnected,
+        this, &QObject::deleteLater);
+    connect(
+        socket, &QTcpSocket::bytesWritten,
+        this, &MirrorConnection::sendImage);
+    connect(
+        &pump, &QTimer::timeout,
+        this, &MirrorConnection::sendImage);
+}
+
+void MirrorConnection::onReadyRead() {
+    request += socket->readAll();
+
+    if (responding || !request.contains("\r\n\r\n")) {
+        return;
+    }
+
+    responding = true;
+    QTimer::singleShot(server->options.latencyMillis, this, &MirrorConnection::respond);
+}
+
+void MirrorConnection::respond() {
+    const QList<QByteArray> lines = request.left(request.indexOf("\r\n\r\n")).split('\n');
+    const QList<QByteArray> request_line = lines.first().trimmed().split(' ');
+    const QString path = QUrl(QString::fromUtf8(request_line.value(1))).path();
+
+    if (request_line.value(0) != "GET") {
+        sendHeader("405 Method Not Allowed", 0);
+        socket->disconnectFromHost();
+        return;
+    }
+
+    if (server->nextRequestFails()) {
+        sendHeader("503 Service Unavailable", 0);
+        socket->disconnectFromHost();
+        return;
+    }
+
+    if (server->files.contains(path)) {
+        const QByteArray body = server->files[path];
+        sendHeader("200 OK", body.size());
+        socket->write(body);
+        socket->disconnectFromHost();
+        return;
+    }
+
+    if (!server->images.contains(path)) {
+        sendHeader("404 Not Found", 0);
+        socket->disconnectFromHost();
+        return;
+    }
+
+    image.setFileName(server->options.imagePath);
+    const bool open_success = image.open(QIODevice::ReadOnly);
+    if (!open_success) {
+        sendHeader("500 Internal Server Error", 0);
+        socket->disconnectFromHost();
+        return;
+    }
+
+    const qint64 size = image.size();
+    bodyOffset = 0;
+    bodyEnd = size;
+
+    // NOTE: only "bytes=start-" and "bytes=start-end"
+    // ranges are supported, which is what the app sends
+    static const QRegularExpression range_regex("^range:\\s*bytes=(\\d+)-(\\d*)", QRegularExpression::CaseInsensitiveOption);
+    bool is_range = false;
+    for (const QByteArray &line : lines) {
+        const QRegularExpressionMatch match = range_regex.match(QString::fromLatin1(line.trimmed()));
+        if (match.hasMatch()) {
+            is_range = true;
+            bodyOffset = match.captured(1).toLongLong();
+            if (!match.captured(2).isEmpty()) {
+                bodyEnd = qMin(size, match.captured(2).toLongLong() + 1);
+            }
+        }
+    }
+
+    if (bodyOffset >= bodyEnd && !(bodyOffset == 0 && size == 0)) {
+        sendHeader("416 Range Not Satisfiable", 0, QString("Content-Range: bytes */%1\r\n").arg(size).toLatin1());
+        socket->disconnectFromHost();
+        return;
+    }
+
+    if (is_range) {
+        sendHeader("206 Partial Content", bodyEnd - bodyOffset, QString("Content-Range: bytes %1-%2/%3\r\n").arg(bodyOffset).arg(bodyEnd - 1).arg(size).toLatin1());
+    } else {
+        sendHeader("200 OK", bodyEnd - bodyOffset);
+    }
+
+    image.seek(bodyOffset);
+    timer.start();
+
+    if (server->options.bandwidth > 0) {
+        pump.start(MIRROR_PUMP_INTERVAL_MILLIS);
+    }
+
+    sendImage();
+}
+
+void MirrorConnection::sendHeader(const QByteArray &status, const qint64 length, const QByteArray &extra) {
+    const QByteArray header = "HTTP/1.1 " + status + "\r\n"
+        + "Content-Length: " + QByteArray::number(length) + "\r\n"
+        + "Content-Type: application/octet-stream\r\n"
+        + "Accept-Ranges: bytes\r\n"
+        + extra
+        + "Connection: close\r\n"
+        + "\r\n";
+
+    socket->write(header);
+}
+
+// Sends as much of the image as socket buffer, bandwidth
+// limit and drop limit allow
+void MirrorConnection::sendImage() {
+    if (!image.isOpen()) {
+        return;
+    }
+
+    const MirrorOptions &options = server->options;
+
+    while (bodyOffset < bodyEnd && socket->bytesToWrite() < MIRROR_SOCKET_BUFFER) {
+        qint64 allowed = qMin(MIRROR_CHUNK_SIZE, bodyEnd - bodyOffset);
+
+        if (options.bandwidth > 0) {
+            const qint64 budget = (qint64) ((double) timer.nsecsElapsed() * options.bandwidth / 1e9) - sent;
+            allowed = qMin(allowed, budget);
+        }
+        if (options.dropAfter > 0) {
+            allowed = qMin(allowed, options.dropAfter - sent);
+        }
+        if (allowed <= 0) {
+            break;
+        }
+
+        const QByteArray data = image.read(allowed);
+        if (data.isEmpty()) {
+            socket->abort();
+            return;
+        }
+
+        socket->write(data);
+        bodyOffset += data.size();
+        sent += data.size();
+    }
+
+    // NOTE: drop happens once dropped data has actually
+    // been sent, so that client receives all of it
+    const bool drop = (options.dropAfter > 0 && sent >= options.dropAfter && bodyOffset < bodyEnd);
+    if (drop && socket->bytesToWrite() == 0) {
+        pump.stop();
+        image.close();
+        socket->abort();
+        deleteLater();
+    } else if (bodyOffset >= bodyEnd) {
+        pump.stop();
+        image.close();
+        socket->disconnectFromHost();
+    }
+}
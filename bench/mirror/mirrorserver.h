@@ -0,0 +1,113 @@
+/*
+ * ALT Media Writer
+ * Copyright (C) 2016-2019 Martin Bříza <mbriza@redhat.com>
+ * Copyright (C) 2020-2022 Dmitry Degtyarev <kevl@basealt.ru>
+ *
+ * ALT Media Writer is a fork of Fedora Media Writer
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef MIRRORSERVER_H
+#define MIRRORSERVER_H
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QHash>
+#include <QObject>
+#include <QSet>
+#include <QTcpServer>
+#include <QTimer>
+
+#include <random>
+
+class QTcpSocket;
+
+struct MirrorOptions {
+    quint16 port;
+    // Image that is served under the names of all variants
+    QString imagePath;
+    QString imageMd5;
+    int releases;
+    // Delay before every response
+    int latencyMillis;
+    // Bytes per second for every connection, 0 is unlimited
+    qint64 bandwidth;
+    // Connection is dropped after sending this many bytes
+    // of an image, 0 never drops
+    qint64 dropAfter;
+    // Part of requests that fail with 503
+    double errorRate;
+    quint32 seed;
+};
+
+// Serves a synthetic copy of the metadata that the app
+// downloads from getalt.org: url lists, sections and images
+// yml files and MD5SUM files, with images that support
+// range requests. Latency, bandwidth and failures can be
+// simulated.
+class MirrorServer final : public QObject {
+    Q_OBJECT
+
+public:
+    explicit MirrorServer(const MirrorOptions &options_arg);
+
+    bool listen();
+    QString url() const;
+    QString firstImageUrl() const;
+
+private:
+    friend class MirrorConnection;
+
+    MirrorOptions options;
+    QTcpServer server;
+    std::mt19937 random;
+    QHash<QString, QByteArray> files;
+    QSet<QString> images;
+    QString m_firstImageUrl;
+
+    void onNewConnection();
+    void createMetadata();
+    bool nextRequestFails();
+};
+
+// Answers one request and closes the connection
+class MirrorConnection final : public QObject {
+    Q_OBJECT
+
+public:
+    MirrorConnection(QTcpSocket *socket_arg, MirrorServer *server_arg);
+
+private:
+    QTcpSocket *socket;
+    MirrorServer *server;
+    QByteArray request;
+    bool responding;
+
+    QFile image;
+    qint64 bodyOffset;
+    qint64 bodyEnd;
+    qint64 sent;
+    QElapsedTimer timer;
+    QTimer pump;
+
+    void onReadyRead();
+    void respond();
+    void sendHeader(const QByteArray &status, const qint64 length, const QByteArray &extra = QByteArray());
+    void sendImage();
+};
+
+#endif // MIRRORSERVER_H
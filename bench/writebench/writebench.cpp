@@ -0,0 +1,423 @@
+/*
+ * ALT Media Writer
+ * Copyright (C) 2016-2019 Martin Bříza <mbriza@redhat.com>
+ * Copyright (C) 2020-2022 Dmitry Degtyarev <kevl@basealt.ru>
+ *
+ * ALT Media Writer is a fork of Fedora Media Writer
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "writebench.h"
+#include "resourceusage.h"
+#include "syntheticimage.h"
+#include "writejob.h"
+
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QProcess>
+#include <QRegularExpression>
+#include <QTextStream>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/loop.h>
+#include <stdio.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+#include <memory>
+
+struct Compressor {
+    QString program;
+    QStringList args;
+};
+
+// NOTE: multi-threaded xz splits the image into blocks,
+// like the xz images that are published
+static const QHash<QString, Compressor> compressors = {
+    {"xz", {"xz", {"-T0", "-c"}}},
+    {"gz", {"gzip", {"-c"}}},
+    {"zst", {"zstd", {"-q", "-c"}}},
+    {"bz2", {"bzip2", {"-c"}}},
+};
+
+WriteBench::WriteBench(const WriteBenchOptions &options_arg)
+: options(options_arg) {
+    plainImage = QDir(options.dir).filePath("writebench.iso");
+
+    target.fd = -1;
+    target.loopFd = -1;
+    target.direct = false;
+    target.keepsData = false;
+
+    captureFd = -1;
+    savedStdout = dup(STDOUT_FILENO);
+    savedStderr = dup(STDERR_FILENO);
+}
+
+WriteBench::~WriteBench() {
+    closeTarget();
+
+    QFile::remove(plainImage);
+    for (const QString &image : images) {
+        QFile::remove(image);
+    }
+
+    if (captureFd >= 0) {
+        close(captureFd);
+        QFile::remove(QDir(options.dir).filePath("writebench.log"));
+    }
+
+    close(savedStdout);
+    close(savedStderr);
+}
+
+QStringList WriteBench::compressedEngines() {
+    return {"xz", "gz", "zst", "bz2"};
+}
+
+bool WriteBench::prepare() {
+    QTextStream err(stderr);
+
+    const QString capture_path = QDir(options.dir).filePath("writebench.log");
+    captureFd = open(QFile::encodeName(capture_path).constData(), O_RDWR | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC, 0600);
+    if (captureFd < 0) {
+        err << "Failed to create " << capture_path << "\n";
+        return false;
+    }
+
+    err << "Creating " << plainImage << "\n";
+    err.flush();
+
+    const bool create_success = synthetic_image_create(plainImage, options.imageSize);
+    if (!create_success) {
+        err << "Failed to create " << plainImage << "\n";
+        return false;
+    }
+
+    QFile file(plainImage);
+    file.open(QIODevice::ReadOnly);
+    QCryptographicHash hash(QCryptographicHash::Md5);
+    hash.addData(&file);
+    md5 = hash.result().toHex();
+
+    // NOTE: missing compressors only skip their engines
+    for (const QString &engine : options.engines) {
+        if (!compressors.contains(engine)) {
+            continue;
+        }
+
+        const Compressor compressor = compressors[engine];
+        const QString path = plainImage + "." + engine;
+
+        err << "Creating " << path << "\n";
+        err.flush();
+
+        QProcess process;
+        process.setStandardOutputFile(path);
+        process.start(compressor.program, QStringList(compressor.args) << plainImage);
+        const bool compress_success = (process.waitForFinished(-1) && process.exitStatus() == QProcess::NormalExit && process.exitCode() == 0);
+
+        if (compress_success) {
+            images[engine] = path;
+        } else {
+            err << "Failed to run " << compressor.program << ", skipping " << engine << "\n";
+            QFile::remove(path);
+        }
+    }
+
+    err.flush();
+
+    return true;
+}
+
+QJsonArray WriteBench::run() {
+    QTextStream err(stderr);
+
+    QJsonArray out;
+
+    for (const QString &target_name : options.targets) {
+        const bool open_success = openTarget(target_name);
+        if (!open_success) {
+            err << "Failed to open " << target_name << " target, skipping it\n";
+            err.flush();
+            continue;
+        }
+
+        for (const QString &engine : options.engines) {
+            // NOTE: these engines read back what was written
+            const bool reads_target = (engine == "delta" || engine == "verify");
+            if (reads_target && !target.keepsData) {
+                continue;
+            }
+
+            const bool image_exists = (engine == "plain" || reads_target || images.contains(engine));
+            if (!image_exists) {
+                continue;
+            }
+
+            // NOTE: delta mode uses a fixed chunk size and
+            // verify doesn't write at all
+            const QList<size_t> chunk_sizes = [&]() -> QList<size_t> {
+                if (reads_target) {
+                    return {0};
+                } else {
+                    return options.chunkSizes;
+                }
+            }();
+
+            for (const size_t chunk_size : chunk_sizes) {
+                for (int run = 1; run <= options.repeat; run++) {
+                    QJsonObject result = runCase(engine, chunk_size);
+                    result["target"] = target.name;
+                    result["engine"] = engine;
+                    result["chunk_size"] = (double) chunk_size;
+                    result["direct"] = target.direct;
+                    result["run"] = run;
+                    out.append(result);
+
+                    err << target.name << " " << engine << " " << chunk_size << " #" << run << ": ";
+                    if (result["success"].toBool()) {
+                        err << QString::number(result["mb_per_s"].toDouble(), 'f', 1) << " MB/s\n";
+                    } else {
+                        err << "failed: " << result["error"].toString() << "\n";
+                    }
+                    err.flush();
+                }
+            }
+        }
+
+        closeTarget();
+    }
+
+    return out;
+}
+
+bool WriteBench::openTarget(const QString &name) {
+    target.name = name;
+    target.keepsData = (name != "null");
+
+    if (name == "file") {
+        target.path = QDir(options.dir).filePath("writebench.target");
+    } else if (name == "null") {
+        target.path = "/dev/null";
+    } else if (name == "loop") {
+        // NOTE: needs root, backing file is sparse so it
+        // only takes space once written
+        const QString backing_path = QDir(options.dir).filePath("writebench.loop");
+        const int backing_fd = open(QFile::encodeName(backing_path).constData(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+        if (backing_fd < 0) {
+            return false;
+        }
+        const bool truncate_success = (ftruncate(backing_fd, QFileInfo(plainImage).size()) == 0);
+
+        const int control_fd = open("/dev/loop-control", O_RDWR | O_CLOEXEC);
+        const int number = (control_fd >= 0) ? ioctl(control_fd, LOOP_CTL_GET_FREE) : -1;
+        if (control_fd >= 0) {
+            close(control_fd);
+        }
+
+        target.path = QString("/dev/loop%1").arg(number);
+        target.loopFd = (number >= 0) ? open(QFile::encodeName(target.path).constData(), O_RDWR | O_CLOEXEC) : -1;
+
+        const bool attach_success = (truncate_success && target.loopFd >= 0 && ioctl(target.loopFd, LOOP_SET_FD, backing_fd) == 0);
+
+        // NOTE: loop device keeps its own reference
+        close(backing_fd);
+        QFile::remove(backing_path);
+
+        if (!attach_success) {
+            if (target.loopFd >= 0) {
+                close(target.loopFd);
+                target.loopFd = -1;
+            }
+
+            return false;
+        }
+    } else {
+        return false;
+    }
+
+    // NOTE: same flags as the helper uses for drives.
+    // Some filesystems don't support direct I/O, then
+    // the page cache is measured too.
+    const int flags = [&]() {
+        const int create = (name == "file") ? O_CREAT : 0;
+
+        if (options.flushInterval == 0) {
+            return O_RDWR | O_SYNC | O_CLOEXEC | create;
+        } else {
+            return O_RDWR | O_CLOEXEC | create;
+        }
+    }();
+
+    target.fd = open(QFile::encodeName(target.path).constData(), flags | O_DIRECT, 0600);
+    target.direct = (target.fd >= 0);
+    if (target.fd < 0 && errno == EINVAL) {
+        target.fd = open(QFile::encodeName(target.path).constData(), flags, 0600);
+    }
+
+    if (target.fd < 0) {
+        closeTarget();
+
+        return false;
+    }
+
+    return true;
+}
+
+void WriteBench::closeTarget() {
+    if (target.fd >= 0) {
+        close(target.fd);
+        target.fd = -1;
+    }
+
+    if (target.loopFd >= 0) {
+        ioctl(target.loopFd, LOOP_CLR_FD, 0);
+        close(target.loopFd);
+        target.loopFd = -1;
+    }
+
+    if (target.name == "file") {
+        QFile::remove(target.path);
+    }
+}
+
+QStringList WriteBench::jobOptions(const QString &engine, const size_t chunk_size) const {
+    QStringList out;
+
+    if (engine == "delta") {
+        out << "--delta";
+    }
+    if (chunk_size > 0) {
+        out << QString("--chunk-size=%1").arg((qulonglong) chunk_size);
+    }
+    if (options.flushInterval >= 0) {
+        out << QString("--flush-interval=%1").arg(options.flushInterval);
+    }
+
+    return out;
+}
+
+// Measures one run of an engine. Delta and verify are
+// measured on a target that already has the image, which
+// is written before measuring.
+QJsonObject WriteBench::runCase(const QString &engine, const size_t chunk_size) {
+    const QString image = images.value(engine, plainImage);
+
+    // NOTE: every write starts on an empty file, so that
+    // runs don't depend on each other
+    if (target.name == "file") {
+        ftruncate(target.fd, 0);
+    }
+
+    // NOTE: jobs are never started by the event loop,
+    // their steps are called directly on the target
+    const std::unique_ptr<WriteJob> job(new WriteJob(image, target.path, md5, jobOptions(engine, chunk_size)));
+
+    captureStart();
+
+    const bool prepare_success = [&]() {
+        if (engine == "delta") {
+            const std::unique_ptr<WriteJob> plain_job(new WriteJob(plainImage, target.path, md5, jobOptions("plain", 0)));
+
+            return plain_job->write(target.fd);
+        } else if (engine == "verify") {
+            return job->write(target.fd);
+        } else {
+            return true;
+        }
+    }();
+
+    const ResourceUsage start = resource_usage_now();
+
+    const bool run_success = [&]() {
+        if (!prepare_success) {
+            return false;
+        } else if (engine == "verify") {
+            job->check(target.fd);
+
+            return true;
+        } else {
+            return job->write(target.fd);
+        }
+    }();
+
+    const ResourceUsage usage = resource_usage_since(start);
+
+    const QString output = captureStop();
+
+    // NOTE: check reports its result only through output
+    const bool success = [&]() {
+        if (engine == "verify") {
+            return run_success && output.split('\n').contains("DONE");
+        } else {
+            return run_success;
+        }
+    }();
+
+    QJsonObject out = resource_usage_json(usage, QFileInfo(plainImage).size());
+    out["success"] = success;
+
+    // NOTE: progress and status lines are dropped, the
+    // rest are error messages
+    if (!success) {
+        static const QRegularExpression status_line("^[A-Z ]*( -?\\d+)?$");
+
+        QStringList errors;
+        for (const QString &line : output.split('\n')) {
+            if (!status_line.match(line.trimmed()).hasMatch()) {
+                errors.append(line.trimmed());
+            }
+        }
+        out["error"] = errors.join(" ");
+    }
+
+    return out;
+}
+
+// Redirects output of the helper code to a file, so
+// that it doesn't mix with the report
+void WriteBench::captureStart() {
+    fflush(stdout);
+    fflush(stderr);
+    dup2(captureFd, STDOUT_FILENO);
+    dup2(captureFd, STDERR_FILENO);
+}
+
+QString WriteBench::captureStop() {
+    fflush(stdout);
+    fflush(stderr);
+    dup2(savedStdout, STDOUT_FILENO);
+    dup2(savedStderr, STDERR_FILENO);
+
+    QByteArray out;
+    char buffer[4096];
+    qint64 offset = 0;
+    while (true) {
+        const ssize_t len = pread(captureFd, buffer, sizeof(buffer), offset);
+        if (len <= 0) {
+            break;
+        }
+        out.append(buffer, len);
+        offset += len;
+    }
+    ftruncate(captureFd, 0);
+
+    return QString::fromLocal8Bit(out);
+}
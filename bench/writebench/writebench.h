@@ -0,0 +1,92 @@
+/*
+ * ALT Media Writer
+ * Copyright (C) 2016-2019 Martin Bříza <mbriza@redhat.com>
+ * Copyright (C) 2020-2022 Dmitry Degtyarev <kevl@basealt.ru>
+ *
+ * ALT Media Writer is a fork of Fedora Media Writer
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef WRITEBENCH_H
+#define WRITEBENCH_H
+
+#include <QHash>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QList>
+#include <QString>
+#include <QStringList>
+
+#include <cstddef>
+
+struct WriteBenchOptions {
+    qint64 imageSize;
+    // Directory for the image and file targets, should be
+    // on tmpfs so that the source isn't measured
+    QString dir;
+    // "file", "loop" or "null"
+    QStringList targets;
+    // "plain", "delta", "verify" or a compression
+    // extension like "xz"
+    QStringList engines;
+    // Chunk size of 0 lets the helper tune it
+    QList<size_t> chunkSizes;
+    int repeat;
+    // Negative means the helper's default
+    qint64 flushInterval;
+};
+
+// Runs the write and verify code of the helper on
+// synthetic images and measures every run. Writes go to
+// files, loop devices or /dev/null instead of real drives.
+class WriteBench {
+public:
+    explicit WriteBench(const WriteBenchOptions &options);
+    ~WriteBench();
+
+    bool prepare();
+    QJsonArray run();
+
+    static QStringList compressedEngines();
+
+private:
+    struct Target {
+        QString name;
+        QString path;
+        int fd;
+        int loopFd;
+        bool direct;
+        bool keepsData;
+    };
+
+    WriteBenchOptions options;
+    QString plainImage;
+    QString md5;
+    QHash<QString, QString> images;
+    Target target;
+    int captureFd;
+    int savedStdout;
+    int savedStderr;
+
+    bool openTarget(const QString &name);
+    void closeTarget();
+    QJsonObject runCase(const QString &engine, const size_t chunk_size);
+    QStringList jobOptions(const QString &engine, const size_t chunk_size) const;
+    void captureStart();
+    QString captureStop();
+};
+
+#endif // WRITEBENCH_H
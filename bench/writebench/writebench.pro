@@ -0,0 +1,51 @@
+TEMPLATE = app
+
+QT += core dbus
+
+CONFIG += link_pkgconfig
+PKGCONFIG += liblzma zlib libzstd
+
+LIBS += -lisomd5 -limageformat -lbz2
+
+CONFIG += c++11
+CONFIG += console
+
+TARGET = writebench
+
+include($$top_srcdir/deployment.pri)
+
+# NOTE: write and verify code is compiled from the
+# helper's sources, so that exactly it is measured
+HELPER_DIR = $$top_srcdir/helper/linux
+
+INCLUDEPATH += $$HELPER_DIR ../common
+
+SOURCES = main.cpp \
+    writebench.cpp \
+    ../common/benchutils.cpp \
+    ../common/resourceusage.cpp \
+    ../common/syntheticimage.cpp \
+    $$HELPER_DIR/writejob.cpp \
+    $$HELPER_DIR/pagealignedbuffer.cpp \
+    $$HELPER_DIR/udisksunmount.cpp \
+    $$HELPER_DIR/writetuner.cpp \
+    $$HELPER_DIR/streamdecoder.cpp \
+    $$HELPER_DIR/xzindex.cpp \
+    $$HELPER_DIR/writejournal.cpp \
+    $$HELPER_DIR/imagemap.cpp \
+    $$HELPER_DIR/bmap.cpp
+
+HEADERS += \
+    writebench.h \
+    ../common/benchutils.h \
+    ../common/resourceusage.h \
+    ../common/syntheticimage.h \
+    $$HELPER_DIR/writejob.h \
+    $$HELPER_DIR/pagealignedbuffer.h \
+    $$HELPER_DIR/udisksunmount.h \
+    $$HELPER_DIR/writetuner.h \
+    $$HELPER_DIR/streamdecoder.h \
+    $$HELPER_DIR/xzindex.h \
+    $$HELPER_DIR/writejournal.h \
+    $$HELPER_DIR/imagemap.h \
+    $$HELPER_DIR/bmap.h
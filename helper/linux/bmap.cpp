@@ -0,0 +1,164 @@
+/*
+ * ALT Media Writer
+ * Copyright (C) 2016-2019 Martin Bříza <mbriza@redhat.com>
+ * Copyright (C) 2020-2022 Dmitry Degtyarev <kevl@basealt.ru>
+ *
+ * ALT Media Writer is a fork of Fedora Media Writer
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "bmap.h"
+
+#include <QFile>
+#include <QFileInfo>
+#include <QPair>
+#include <QXmlStreamReader>
+
+QString bmap_find(const QString &image_path) {
+    QString base = image_path;
+
+    while (true) {
+        const QString bmap_path = base + ".bmap";
+        if (QFile::exists(bmap_path)) {
+            return bmap_path;
+        }
+
+        // NOTE: try without extensions one by one, so that
+        // "disk.img.xz" finds "disk.img.bmap" and
+        // "disk.bmap"
+        const QString file_name = QFileInfo(base).fileName();
+        const int dot = file_name.lastIndexOf('.');
+        if (dot <= 0) {
+            return QString();
+        }
+
+        base.chop(file_name.length() - dot);
+    }
+}
+
+bool bmap_load(const QString &path, Bmap *bmap) {
+    QFile file(path);
+    const bool open_success = file.open(QIODevice::ReadOnly);
+    if (!open_success) {
+        return false;
+    }
+    const QByteArray contents = file.readAll();
+
+    qint64 block_size = 0;
+    qint64 image_size = -1;
+    QByteArray file_checksum;
+    QList<QPair<qint64, qint64>> block_ranges;
+    QList<QByteArray> checksums;
+
+    // NOTE: version 1 only has sha1, in version 2 the
+    // checksum type is set explicitly
+    QByteArray checksum_type = "sha1";
+    QString checksum_attribute = "sha1";
+
+    QXmlStreamReader xml(contents);
+    while (!xml.atEnd()) {
+        xml.readNext();
+        if (!xml.isStartElement()) {
+            continue;
+        }
+
+        const QStringRef name = xml.name();
+
+        if (name == "bmap") {
+            const QString version = xml.attributes().value("version").toString();
+            if (!version.startsWith("1.") && !version.startsWith("2.")) {
+                return false;
+            }
+            if (version.startsWith("2.")) {
+                checksum_attribute = "chksum";
+            }
+        } else if (name == "ImageSize") {
+            image_size = xml.readElementText().trimmed().toLongLong();
+        } else if (name == "BlockSize") {
+            block_size = xml.readElementText().trimmed().toLongLong();
+        } else if (name == "ChecksumType") {
+            checksum_type = xml.readElementText().trimmed().toLatin1();
+        } else if (name == "BmapFileChecksum" || name == "BmapFileSHA1") {
+            file_checksum = xml.readElementText().trimmed().toLatin1();
+        } else if (name == "Range") {
+            const QByteArray checksum = xml.attributes().value(checksum_attribute).toLatin1().toLower();
+            const QString text = xml.readElementText().trimmed();
+
+            bool first_ok;
+            bool last_ok = true;
+            const qint64 first = text.section('-', 0, 0).trimmed().toLongLong(&first_ok);
+            const qint64 last = text.contains('-') ? text.section('-', 1, 1).trimmed().toLongLong(&last_ok) : first;
+            if (!first_ok || !last_ok || last < first) {
+                return false;
+            }
+
+            block_ranges.append({first, last});
+            checksums.append(checksum);
+        }
+    }
+
+    if (xml.hasError() || block_size <= 0 || image_size < 0) {
+        return false;
+    }
+
+    if (checksum_type == "sha1") {
+        bmap->algorithm = QCryptographicHash::Sha1;
+    } else if (checksum_type == "sha256") {
+        bmap->algorithm = QCryptographicHash::Sha256;
+    } else {
+        return false;
+    }
+
+    // NOTE: checksum of the bmap itself is computed with
+    // its own value replaced by zeros
+    if (!file_checksum.isEmpty()) {
+        QByteArray zeroed = contents;
+        const int checksum_pos = zeroed.indexOf(file_checksum);
+        if (checksum_pos < 0) {
+            return false;
+        }
+        zeroed.replace(checksum_pos, file_checksum.size(), QByteArray(file_checksum.size(), '0'));
+
+        const QByteArray actual = QCryptographicHash::hash(zeroed, bmap->algorithm).toHex();
+        if (actual != file_checksum.toLower()) {
+            return false;
+        }
+    }
+
+    bmap->imageSize = image_size;
+    bmap->ranges.clear();
+
+    for (int i = 0; i < block_ranges.size(); i++) {
+        BmapRange range;
+        range.start = block_ranges[i].first * block_size;
+        range.end = qMin((block_ranges[i].second + 1) * block_size, image_size);
+        range.checksum = checksums[i];
+
+        if (range.start >= range.end) {
+            return false;
+        }
+
+        // NOTE: ranges have to be in order, because they
+        // are matched against a stream
+        if (!bmap->ranges.isEmpty() && range.start < bmap->ranges.last().end) {
+            return false;
+        }
+
+        bmap->ranges.append(range);
+    }
+
+    return true;
+}
@@ -0,0 +1,62 @@
+/*
+ * ALT Media Writer
+ * Copyright (C) 2016-2019 Martin Bříza <mbriza@redhat.com>
+ * Copyright (C) 2020-2022 Dmitry Degtyarev <kevl@basealt.ru>
+ *
+ * ALT Media Writer is a fork of Fedora Media Writer
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef BMAP_H
+#define BMAP_H
+
+/**
+ * Block maps (bmap files, as made by bmaptool) list the
+ * ranges of an image that contain data, together with a
+ * checksum of each range. Everything else in the image
+ * doesn't need to be written. The bmap is stored next to
+ * the image, either as "<image>.bmap" or with the
+ * compression extension replaced, like "disk.bmap" for
+ * "disk.img.xz".
+ */
+
+#include <QByteArray>
+#include <QCryptographicHash>
+#include <QList>
+#include <QString>
+
+struct BmapRange {
+    // Bytes of the image as [start, end)
+    qint64 start;
+    qint64 end;
+
+    // Hex string, empty if the bmap has no checksums
+    QByteArray checksum;
+};
+
+struct Bmap {
+    qint64 imageSize;
+    QCryptographicHash::Algorithm algorithm;
+    QList<BmapRange> ranges;
+};
+
+// Returns path of the bmap for the image, empty string if
+// there is none
+QString bmap_find(const QString &image_path);
+
+bool bmap_load(const QString &path, Bmap *bmap);
+
+#endif // BMAP_H
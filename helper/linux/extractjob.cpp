@@ -0,0 +1,710 @@
+/*
+ * ALT Media Writer
+ * Copyright (C) 2016-2019 Martin Bříza <mbriza@redhat.com>
+ * Copyright (C) 2020-2022 Dmitry Degtyarev <kevl@basealt.ru>
+ *
+ * ALT Media Writer is a fork of Fedora Media Writer
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "extractjob.h"
+#include "fat32layout.h"
+#include "streamdecoder.h"
+#include "tarreader.h"
+#include "udisksunmount.h"
+
+#include <QCoreApplication>
+#include <QDBusInterface>
+#include <QDBusUnixFileDescriptor>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QRunnable>
+#include <QSemaphore>
+#include <QSet>
+#include <QTextStream>
+#include <QThread>
+#include <QThreadPool>
+#include <QTimer>
+#include <QtDBus>
+
+#include <fcntl.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+typedef QHash<QString, QVariant> Properties;
+Q_DECLARE_METATYPE(Properties)
+
+// NOTE: small files are written on a pool of threads,
+// because for them most of the time goes to filesystem
+// metadata rather than data
+const qint64 EXTRACT_SMALL_FILE_SIZE = 1024 * 1024;
+const int EXTRACT_WRITE_THREADS = 4;
+
+// Limit on data of small files that wait to be written,
+// in KiB
+const int EXTRACT_QUEUE_KIB = 64 * 1024;
+
+const qint64 EXTRACT_BUFFER_SIZE = 4 * 1024 * 1024;
+
+const int DECOMPRESS_CHUNK_SIZE = 1024 * 1024;
+const size_t DECOMPRESS_QUEUE_LENGTH = 16;
+
+// NOTE: partition appears in UDisks a moment after the
+// partition table is reread
+const int MOUNT_TIMEOUT_MILLIS = 10000;
+const int MOUNT_RETRY_MILLIS = 250;
+
+const int UNMOUNT_TIMEOUT_MILLIS = 60000;
+
+// Decompresses the archive on a separate thread, so that
+// decompression overlaps with writing files
+class DecompressPipe {
+public:
+    DecompressPipe(const QString &path, const ImageFormat format);
+    ~DecompressPipe();
+
+    // Returns number of bytes read, 0 at the end and -1
+    // on error
+    qint64 read(char *buffer, const qint64 size);
+    qint64 compressedRead() const;
+    QString errorString();
+
+private:
+    QFile file;
+    ImageFormat format;
+    std::thread thread;
+    std::mutex mutex;
+    std::condition_variable cond;
+    std::deque<QByteArray> chunks;
+    bool finished;
+    bool stopping;
+    QString error;
+    std::atomic<qint64> totalRead;
+
+    // Only used by the reading side
+    QByteArray current;
+    int currentPos;
+
+    void run();
+    bool push(const QByteArray &chunk);
+    void finish(const QString &error_arg);
+};
+
+// Writes one small file, run on the thread pool
+class SmallFileWrite : public QRunnable {
+public:
+    SmallFileWrite(const QString &path, const QByteArray &data, QSemaphore *queueSpace, const int queueUnits, std::atomic<bool> *failed);
+
+    void run() override;
+
+private:
+    QString path;
+    QByteArray data;
+    QSemaphore *queueSpace;
+    int queueUnits;
+    std::atomic<bool> *failed;
+};
+
+bool extract_clean_path(const QByteArray &raw_path, QString *out);
+QString decode_result_message(const DecodeResult result);
+
+ExtractJob::ExtractJob(const QString &what, const QString &where)
+: QObject(nullptr)
+, what(what)
+, where(where) {
+    qDBusRegisterMetaType<Properties>();
+
+    QTimer::singleShot(0, this, SLOT(work()));
+}
+
+void ExtractJob::work() {
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+
+    udisks_unmount_drive(where);
+
+    QString error;
+
+    const bool create_success = createFilesystem(&error);
+    if (!create_success) {
+        err << error << "\n";
+        err.flush();
+        qApp->exit(2);
+        return;
+    }
+
+    const QString mount_path = mountFilesystem(&error);
+    if (mount_path.isEmpty()) {
+        err << tr("Failed to mount the new filesystem.") << " " << error << "\n";
+        err.flush();
+        qApp->exit(2);
+        return;
+    }
+
+    // NOTE: let the app know that writing started
+    out << "WRITE\n";
+    out.flush();
+
+    const bool extract_success = extract(mount_path, &error);
+
+    unmountFilesystem(mount_path);
+
+    if (!extract_success) {
+        err << error << "\n";
+        err.flush();
+        qApp->exit(3);
+        return;
+    }
+
+    out << "DONE\n";
+    out.flush();
+    qApp->exit(0);
+}
+
+// Writes partition table with one empty FAT32 partition,
+// same as restoring the drive
+bool ExtractJob::createFilesystem(QString *error) {
+    QDBusInterface device("org.freedesktop.UDisks2", where, "org.freedesktop.UDisks2.Block", QDBusConnection::systemBus(), this);
+
+    const bool direct_success = [&]() {
+        QDBusReply<QDBusUnixFileDescriptor> reply = device.callWithArgumentList(QDBus::Block, "OpenDevice", {"rw", Properties{{"flags", O_CLOEXEC}, {"writable", true}}});
+        const QDBusUnixFileDescriptor fd = reply.value();
+        if (!fd.isValid()) {
+            *error = reply.error().message();
+            return false;
+        }
+
+        const bool layout_success = fat32_layout_write(fd.fileDescriptor(), error);
+        if (!layout_success) {
+            return false;
+        }
+
+        const bool rescan_success = (ioctl(fd.fileDescriptor(), BLKRRPART) == 0);
+        if (!rescan_success) {
+            device.call("Rescan", Properties());
+        }
+
+        return true;
+    }();
+
+    // NOTE: same as restoring, if the layout can't be
+    // written directly (unsupported sector size for
+    // example), let UDisks format the drive. Device is
+    // closed by now, so that UDisks can open it.
+    if (direct_success) {
+        return true;
+    } else {
+        return udisks_format_drive(where, error);
+    }
+}
+
+// Mounts the new partition through UDisks, returns mount
+// path or empty string on failure
+QString ExtractJob::mountFilesystem(QString *error) {
+    QElapsedTimer timer;
+    timer.start();
+
+    while (true) {
+        // NOTE: there is only one partition on the drive
+        const QString partition = [&]() {
+            QDBusMessage message = QDBusMessage::createMethodCall("org.freedesktop.UDisks2", where, "org.freedesktop.DBus.Properties", "Get");
+            message << "org.freedesktop.UDisks2.PartitionTable" << "Partitions";
+            const QDBusMessage reply = QDBusConnection::systemBus().call(message);
+            if (reply.type() != QDBusMessage::ReplyMessage || reply.arguments().isEmpty()) {
+                return QString();
+            }
+
+            const QVariant value = qvariant_cast<QDBusVariant>(reply.arguments().first()).variant();
+            QList<QDBusObjectPath> partitions;
+            if (value.canConvert<QDBusArgument>()) {
+                qvariant_cast<QDBusArgument>(value) >> partitions;
+            } else {
+                partitions = qvariant_cast<QList<QDBusObjectPath>>(value);
+            }
+
+            if (partitions.isEmpty()) {
+                return QString();
+            } else {
+                return partitions.first().path();
+            }
+        }();
+
+        if (!partition.isEmpty()) {
+            QDBusMessage message = QDBusMessage::createMethodCall("org.freedesktop.UDisks2", partition, "org.freedesktop.UDisks2.Filesystem", "Mount");
+            message << QVariantMap();
+            const QDBusMessage reply = QDBusConnection::systemBus().call(message);
+
+            if (reply.type() == QDBusMessage::ReplyMessage && !reply.arguments().isEmpty()) {
+                partitionPath = partition;
+
+                return reply.arguments().first().toString();
+            }
+
+            *error = reply.errorMessage();
+        }
+
+        if (timer.elapsed() > MOUNT_TIMEOUT_MILLIS) {
+            return QString();
+        }
+
+        QThread::msleep(MOUNT_RETRY_MILLIS);
+    }
+}
+
+void ExtractJob::unmountFilesystem(const QString &mount_path) {
+    // NOTE: flush the filesystem first, so that unmount
+    // doesn't hit the timeout
+    const int dir_fd = open(QFile::encodeName(mount_path).constData(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dir_fd >= 0) {
+        syncfs(dir_fd);
+        close(dir_fd);
+    }
+
+    QDBusMessage message = QDBusMessage::createMethodCall("org.freedesktop.UDisks2", partitionPath, "org.freedesktop.UDisks2.Filesystem", "Unmount");
+    message << QVariantMap();
+    QDBusConnection::systemBus().call(message, QDBus::Block, UNMOUNT_TIMEOUT_MILLIS);
+}
+
+bool ExtractJob::extract(const QString &mount_path, QString *error) {
+    QTextStream out(stdout);
+
+    DecompressPipe pipe(what, image_format_from_file(what));
+    TarReader reader([&pipe](char *buffer, const qint64 size) {
+        return pipe.read(buffer, size);
+    });
+
+    // NOTE: pool is destroyed first, it waits for the
+    // writes that use the other two
+    QSemaphore queueSpace(EXTRACT_QUEUE_KIB);
+    std::atomic<bool> writeFailed(false);
+    QThreadPool pool;
+    pool.setMaxThreadCount(EXTRACT_WRITE_THREADS);
+
+    const QDir root(mount_path);
+    QSet<QString> createdDirs;
+    const auto make_dir = [&](const QString &path) {
+        if (path.isEmpty() || path == "." || createdDirs.contains(path)) {
+            return true;
+        }
+
+        const bool mkpath_success = root.mkpath(path);
+        if (mkpath_success) {
+            createdDirs.insert(path);
+        }
+
+        return mkpath_success;
+    };
+
+    // NOTE: an archive may contain several entries for
+    // the same path and the last one has to win, so the
+    // pool is drained before a queued path is written
+    // again. FAT32 ignores case, so paths are compared
+    // without it.
+    QSet<QString> queuedPaths;
+    const auto wait_for_pool = [&]() {
+        pool.waitForDone();
+        queuedPaths.clear();
+    };
+    const auto wait_for_path = [&](const QString &path) {
+        if (queuedPaths.contains(path.toLower())) {
+            wait_for_pool();
+        }
+    };
+
+    QByteArray buffer(EXTRACT_BUFFER_SIZE, Qt::Uninitialized);
+    qint64 reportedRead = 0;
+
+    const auto report_progress = [&]() {
+        const qint64 total_read = pipe.compressedRead();
+        if (total_read != reportedRead) {
+            reportedRead = total_read;
+            out << total_read << "\n";
+            out.flush();
+        }
+    };
+
+    const auto fail = [&](const QString &message) {
+        wait_for_pool();
+        *error = message;
+
+        return false;
+    };
+
+    TarEntry entry;
+    while (reader.next(&entry)) {
+        report_progress();
+
+        if (writeFailed) {
+            return fail(tr("Failed to write files to the drive."));
+        }
+
+        // NOTE: entries that point outside of the archive
+        // root are refused instead of being skipped, an
+        // archive like that is broken or malicious
+        QString path;
+        const bool path_safe = extract_clean_path(entry.path, &path);
+        if (!path_safe) {
+            return fail(tr("The archive contains an unsafe path: %1").arg(QFile::decodeName(entry.path)));
+        }
+
+        switch (entry.type) {
+            case TarEntryType_DIRECTORY: {
+                if (!make_dir(path)) {
+                    return fail(tr("Failed to create directory %1.").arg(path));
+                }
+
+                break;
+            }
+            case TarEntryType_FILE: {
+                if (!make_dir(QFileInfo(path).path())) {
+                    return fail(tr("Failed to create directory %1.").arg(QFileInfo(path).path()));
+                }
+
+                const QString file_path = root.filePath(path);
+                wait_for_path(path);
+
+                if (entry.size <= EXTRACT_SMALL_FILE_SIZE) {
+                    QByteArray data(entry.size, Qt::Uninitialized);
+                    const qint64 read_size = reader.readData(data.data(), data.size());
+                    if (read_size != entry.size) {
+                        return fail(reader.errorString());
+                    }
+
+                    // NOTE: units are KiB, rounded up so that
+                    // empty files count too
+                    const int units = data.size() / 1024 + 1;
+                    queueSpace.acquire(units);
+                    pool.start(new SmallFileWrite(file_path, data, &queueSpace, units, &writeFailed));
+                    queuedPaths.insert(path.toLower());
+                } else {
+                    QFile file(file_path);
+                    const bool open_success = file.open(QIODevice::WriteOnly | QIODevice::Truncate);
+                    if (!open_success) {
+                        return fail(tr("Failed to write files to the drive."));
+                    }
+
+                    while (true) {
+                        const qint64 read_size = reader.readData(buffer.data(), buffer.size());
+                        if (read_size < 0) {
+                            return fail(reader.errorString());
+                        } else if (read_size == 0) {
+                            break;
+                        }
+
+                        const qint64 written = file.write(buffer.constData(), read_size);
+                        if (written != read_size) {
+                            return fail(tr("Failed to write files to the drive."));
+                        }
+
+                        report_progress();
+                    }
+                }
+
+                break;
+            }
+            case TarEntryType_HARDLINK: {
+                // NOTE: FAT32 has no links, so the file is
+                // copied. It has to be written completely
+                // before that.
+                QString target;
+                const bool target_safe = extract_clean_path(entry.linkTarget, &target);
+                if (!target_safe) {
+                    return fail(tr("The archive contains an unsafe path: %1").arg(QFile::decodeName(entry.linkTarget)));
+                }
+
+                wait_for_pool();
+
+                const QString file_path = root.filePath(path);
+                QFile::remove(file_path);
+                const bool copy_success = QFile::copy(root.filePath(target), file_path);
+                if (!copy_success) {
+                    return fail(tr("Failed to write files to the drive."));
+                }
+
+                break;
+            }
+            case TarEntryType_SYMLINK:
+            case TarEntryType_OTHER: {
+                out << "SKIPPED " << path << "\n";
+                out.flush();
+
+                break;
+            }
+        }
+    }
+
+    pool.waitForDone();
+
+    if (reader.failed()) {
+        // NOTE: decompression errors are more specific
+        // than the "truncated" error they cause in tar
+        const QString pipe_error = pipe.errorString();
+        if (!pipe_error.isEmpty()) {
+            *error = pipe_error;
+        } else {
+            *error = reader.errorString();
+        }
+
+        return false;
+    }
+
+    if (writeFailed) {
+        *error = tr("Failed to write files to the drive.");
+
+        return false;
+    }
+
+    report_progress();
+
+    return true;
+}
+
+DecompressPipe::DecompressPipe(const QString &path, const ImageFormat format_arg)
+: file(path) {
+    format = format_arg;
+    finished = false;
+    stopping = false;
+    totalRead = 0;
+    currentPos = 0;
+
+    thread = std::thread(&DecompressPipe::run, this);
+}
+
+DecompressPipe::~DecompressPipe() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    cond.notify_all();
+
+    thread.join();
+}
+
+qint64 DecompressPipe::read(char *buffer, const qint64 size) {
+    if (currentPos == current.size()) {
+        std::unique_lock<std::mutex> lock(mutex);
+        cond.wait(lock, [&]() {
+            return (!chunks.empty() || finished);
+        });
+
+        if (chunks.empty()) {
+            if (error.isEmpty()) {
+                return 0;
+            } else {
+                return -1;
+            }
+        }
+
+        current = chunks.front();
+        chunks.pop_front();
+        currentPos = 0;
+
+        lock.unlock();
+        cond.notify_all();
+    }
+
+    const qint64 len = qMin(size, (qint64) (current.size() - currentPos));
+    memcpy(buffer, current.constData() + currentPos, len);
+    currentPos += len;
+
+    return len;
+}
+
+qint64 DecompressPipe::compressedRead() const {
+    return totalRead;
+}
+
+QString DecompressPipe::errorString() {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    return error;
+}
+
+void DecompressPipe::run() {
+    const bool open_success = file.open(QIODevice::ReadOnly);
+    if (!open_success) {
+        finish(QCoreApplication::translate("ExtractJob", "Source image is not readable"));
+        return;
+    }
+
+    // NOTE: decoder is null for uncompressed archives
+    const std::unique_ptr<StreamDecoder> decoder(stream_decoder_create(format));
+    if (decoder != nullptr && !decoder->init()) {
+        finish(QCoreApplication::translate("ExtractJob", "Failed to start decompressing."));
+        return;
+    }
+
+    QByteArray in(DECOMPRESS_CHUNK_SIZE, Qt::Uninitialized);
+
+    if (decoder == nullptr) {
+        while (true) {
+            const qint64 len = file.read(in.data(), in.size());
+            if (len < 0) {
+                finish(QCoreApplication::translate("ExtractJob", "Source image is not readable"));
+                return;
+            } else if (len == 0) {
+                break;
+            }
+            totalRead += len;
+
+            if (!push(in.left(len))) {
+                return;
+            }
+        }
+
+        finish(QString());
+        return;
+    }
+
+    const uint8_t *next_in = (const uint8_t *) in.constData();
+    size_t avail_in = 0;
+    bool input_finished = false;
+
+    QByteArray outChunk(DECOMPRESS_CHUNK_SIZE, Qt::Uninitialized);
+    uint8_t *next_out = (uint8_t *) outChunk.data();
+    size_t avail_out = outChunk.size();
+
+    while (true) {
+        if (avail_in == 0 && !input_finished) {
+            const qint64 len = file.read(in.data(), in.size());
+            if (len < 0) {
+                finish(QCoreApplication::translate("ExtractJob", "Source image is not readable"));
+                return;
+            }
+            totalRead += len;
+
+            next_in = (const uint8_t *) in.constData();
+            avail_in = len;
+            input_finished = (len == 0);
+        }
+
+        const DecodeResult result = decoder->decode(&next_in, &avail_in, &next_out, &avail_out, input_finished);
+        if (result != DecodeResult_OK && result != DecodeResult_END) {
+            finish(decode_result_message(result));
+            return;
+        }
+
+        if (result == DecodeResult_END || avail_out == 0) {
+            const int len = outChunk.size() - avail_out;
+            if (len > 0) {
+                outChunk.resize(len);
+                if (!push(outChunk)) {
+                    return;
+                }
+            }
+
+            if (result == DecodeResult_END) {
+                finish(QString());
+                return;
+            }
+
+            outChunk = QByteArray(DECOMPRESS_CHUNK_SIZE, Qt::Uninitialized);
+            next_out = (uint8_t *) outChunk.data();
+            avail_out = outChunk.size();
+        }
+    }
+}
+
+// Waits for space in the queue, returns false if reading
+// side has stopped
+bool DecompressPipe::push(const QByteArray &chunk) {
+    std::unique_lock<std::mutex> lock(mutex);
+    cond.wait(lock, [&]() {
+        return (chunks.size() < DECOMPRESS_QUEUE_LENGTH || stopping);
+    });
+
+    if (stopping) {
+        return false;
+    }
+
+    chunks.push_back(chunk);
+
+    lock.unlock();
+    cond.notify_all();
+
+    return true;
+}
+
+void DecompressPipe::finish(const QString &error_arg) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        error = error_arg;
+        finished = true;
+    }
+    cond.notify_all();
+}
+
+SmallFileWrite::SmallFileWrite(const QString &path_arg, const QByteArray &data_arg, QSemaphore *queueSpace_arg, const int queueUnits_arg, std::atomic<bool> *failed_arg)
+: path(path_arg)
+, data(data_arg) {
+    queueSpace = queueSpace_arg;
+    queueUnits = queueUnits_arg;
+    failed = failed_arg;
+}
+
+void SmallFileWrite::run() {
+    QFile file(path);
+    const bool write_success = (file.open(QIODevice::WriteOnly | QIODevice::Truncate) && file.write(data) == data.size());
+    if (!write_success) {
+        *failed = true;
+    }
+
+    // NOTE: release memory before letting more files
+    // into the queue
+    data.clear();
+    queueSpace->release(queueUnits);
+}
+
+// Converts path from the archive to a path relative to the
+// archive root, returns false if it points outside of it
+bool extract_clean_path(const QByteArray &raw_path, QString *out) {
+    const QStringList parts = QFile::decodeName(raw_path).split('/', QString::SkipEmptyParts);
+
+    QStringList clean_parts;
+    for (const QString &part : parts) {
+        if (part == ".") {
+            continue;
+        } else if (part == "..") {
+            return false;
+        }
+
+        clean_parts.append(part);
+    }
+
+    *out = clean_parts.join('/');
+
+    return true;
+}
+
+QString decode_result_message(const DecodeResult result) {
+    switch (result) {
+        case DecodeResult_MEMORY_ERROR: return QCoreApplication::translate("ExtractJob", "There is not enough memory to decompress the file.");
+        case DecodeResult_CORRUPTED: return QCoreApplication::translate("ExtractJob", "The downloaded compressed file is corrupted.");
+        case DecodeResult_UNSUPPORTED: return QCoreApplication::translate("ExtractJob", "Unsupported compression options.");
+        default: return QCoreApplication::translate("ExtractJob", "Unknown decompression error.");
+    }
+}
@@ -0,0 +1,51 @@
+/*
+ * ALT Media Writer
+ * Copyright (C) 2016-2019 Martin Bříza <mbriza@redhat.com>
+ * Copyright (C) 2020-2022 Dmitry Degtyarev <kevl@basealt.ru>
+ *
+ * ALT Media Writer is a fork of Fedora Media Writer
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef EXTRACTJOB_H
+#define EXTRACTJOB_H
+
+#include <QObject>
+
+// Creates a fresh FAT32 filesystem on the device and
+// unpacks a tar archive onto it. The archive may be
+// compressed with any format that the write job supports.
+// Links and special files can't be stored on FAT32 and
+// are skipped.
+class ExtractJob : public QObject {
+    Q_OBJECT
+public:
+    explicit ExtractJob(const QString &what, const QString &where);
+public slots:
+    void work();
+
+private:
+    QString what;
+    QString where;
+    QString partitionPath;
+
+    bool createFilesystem(QString *error);
+    QString mountFilesystem(QString *error);
+    void unmountFilesystem(const QString &mount_path);
+    bool extract(const QString &mount_path, QString *error);
+};
+
+#endif // EXTRACTJOB_H
@@ -0,0 +1,258 @@
+/*
+ * ALT Media Writer
+ * Copyright (C) 2016-2019 Martin Bříza <mbriza@redhat.com>
+ * Copyright (C) 2020-2022 Dmitry Degtyarev <kevl@basealt.ru>
+ *
+ * ALT Media Writer is a fork of Fedora Media Writer
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "fat32layout.h"
+
+#include <QByteArray>
+#include <QCoreApplication>
+#include <QtEndian>
+
+#include <errno.h>
+#include <linux/fs.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+#include <random>
+
+// NOTE: partition starts at 1MiB for optimal alignment
+const quint64 PARTITION_START_BYTES = 1024 * 1024;
+const quint64 RESERVED_SECTORS = 32;
+const quint64 FAT_COUNT = 2;
+const quint64 FAT32_MIN_CLUSTERS = 65525;
+const quint64 FAT32_MAX_CLUSTERS = 0x0FFFFFF5;
+const quint64 ZERO_CHUNK_SIZE = 1024 * 1024;
+
+bool write_at(const int fd, const QByteArray &data, const quint64 offset) {
+    const ssize_t written = pwrite(fd, data.constData(), data.size(), offset);
+
+    return (written == data.size());
+}
+
+bool zero_range(const int fd, const quint64 offset, const quint64 size) {
+    const QByteArray zeroes(ZERO_CHUNK_SIZE, '\0');
+
+    quint64 done = 0;
+    while (done < size) {
+        const quint64 len = qMin(ZERO_CHUNK_SIZE, size - done);
+        if (!write_at(fd, zeroes.left(len), offset + done)) {
+            return false;
+        }
+        done += len;
+    }
+
+    return true;
+}
+
+// Cluster sizes recommended by Microsoft for FAT32, in
+// bytes
+quint64 cluster_size_for_size(const quint64 size) {
+    const quint64 GB = 1024ULL * 1024ULL * 1024ULL;
+
+    if (size <= 8 * GB) {
+        return 4096;
+    } else if (size <= 16 * GB) {
+        return 8192;
+    } else if (size <= 32 * GB) {
+        return 16384;
+    } else {
+        return 32768;
+    }
+}
+
+bool fat32_layout_write(const int fd, QString *error) {
+    quint64 device_size = 0;
+    if (ioctl(fd, BLKGETSIZE64, &device_size) != 0) {
+        *error = QCoreApplication::translate("RestoreJob", "Failed to get drive size: %1").arg(strerror(errno));
+        return false;
+    }
+
+    // NOTE: partition table and filesystem are laid out in
+    // logical sectors of the device, which are 4096 bytes
+    // on some USB bridges
+    int logical_sector_size = 0;
+    if (ioctl(fd, BLKSSZGET, &logical_sector_size) != 0) {
+        *error = QCoreApplication::translate("RestoreJob", "Failed to get drive sector size: %1").arg(strerror(errno));
+        return false;
+    }
+    const quint64 sector_size = logical_sector_size;
+    const bool sector_size_is_supported = (sector_size >= 512 && sector_size <= 4096 && (sector_size & (sector_size - 1)) == 0);
+    if (!sector_size_is_supported) {
+        *error = QCoreApplication::translate("RestoreJob", "Drive sector size %1 is not supported.").arg(sector_size);
+        return false;
+    }
+
+    const quint64 device_sectors = device_size / sector_size;
+    const quint64 partition_start = PARTITION_START_BYTES / sector_size;
+
+    // NOTE: leave 1MiB at the end for alignment and so
+    // that backup GPT location is not inside partition
+    if (device_sectors < partition_start * 2) {
+        *error = QCoreApplication::translate("RestoreJob", "Drive is too small.");
+        return false;
+    }
+    const quint64 partition_sectors = device_sectors - partition_start * 2;
+
+    // MBR can't address partitions past 2TiB
+    if (partition_start + partition_sectors > 0xFFFFFFFFULL) {
+        *error = QCoreApplication::translate("RestoreJob", "Drive is too large.");
+        return false;
+    }
+
+    // Pick cluster size, decrease it if there are not
+    // enough clusters for FAT32
+    quint64 sectors_per_cluster = qMax(cluster_size_for_size(partition_sectors * sector_size) / sector_size, (quint64) 1);
+    quint64 fat_sectors = 0;
+    quint64 cluster_count = 0;
+    while (true) {
+        // Formula from Microsoft FAT specification, which
+        // uses 256 for 512 byte sectors
+        const quint64 tmp1 = partition_sectors - RESERVED_SECTORS;
+        const quint64 tmp2 = ((sector_size / 2) * sectors_per_cluster + FAT_COUNT) / 2;
+        fat_sectors = (tmp1 + tmp2 - 1) / tmp2;
+
+        const quint64 data_sectors = partition_sectors - RESERVED_SECTORS - FAT_COUNT * fat_sectors;
+        cluster_count = data_sectors / sectors_per_cluster;
+
+        if (cluster_count >= FAT32_MIN_CLUSTERS || sectors_per_cluster == 1) {
+            break;
+        }
+
+        sectors_per_cluster /= 2;
+    }
+
+    if (cluster_count < FAT32_MIN_CLUSTERS || cluster_count > FAT32_MAX_CLUSTERS) {
+        *error = QCoreApplication::translate("RestoreJob", "Drive size is not supported by FAT32.");
+        return false;
+    }
+
+    std::random_device random;
+    const quint32 disk_signature = random();
+    const quint32 volume_id = random();
+
+    // Discard everything, this is fast on flash drives
+    // and doesn't matter if it fails
+    quint64 discard_range[2] = {0, device_size};
+    ioctl(fd, BLKDISCARD, &discard_range);
+
+    // NOTE: discard doesn't guarantee that discarded
+    // data reads back as zeroes, so explicitly zero the
+    // areas where old partition tables and filesystem
+    // signatures can be found
+    const quint64 partition_offset = partition_start * sector_size;
+    const quint64 metadata_size = (RESERVED_SECTORS + FAT_COUNT * fat_sectors + sectors_per_cluster) * sector_size;
+    const quint64 tail_offset = (device_sectors - partition_start) * sector_size;
+    const bool zero_success = zero_range(fd, 0, partition_offset) && zero_range(fd, partition_offset, metadata_size) && zero_range(fd, tail_offset, device_size - tail_offset);
+    if (!zero_success) {
+        *error = QCoreApplication::translate("RestoreJob", "Failed to write to the drive: %1").arg(strerror(errno));
+        return false;
+    }
+
+    // Boot sector
+    QByteArray boot(sector_size, '\0');
+    uchar *b = (uchar *) boot.data();
+    b[0] = 0xEB;
+    b[1] = 0x58;
+    b[2] = 0x90;
+    memcpy(b + 3, "MSWIN4.1", 8);
+    qToLittleEndian<quint16>(sector_size, b + 11);
+    b[13] = sectors_per_cluster;
+    qToLittleEndian<quint16>(RESERVED_SECTORS, b + 14);
+    b[16] = FAT_COUNT;
+    b[21] = 0xF8;
+    qToLittleEndian<quint16>(63, b + 24);
+    qToLittleEndian<quint16>(255, b + 26);
+    qToLittleEndian<quint32>(partition_start, b + 28);
+    qToLittleEndian<quint32>(partition_sectors, b + 32);
+    qToLittleEndian<quint32>(fat_sectors, b + 36);
+    qToLittleEndian<quint32>(2, b + 44);
+    qToLittleEndian<quint16>(1, b + 48);
+    qToLittleEndian<quint16>(6, b + 50);
+    b[64] = 0x80;
+    b[66] = 0x29;
+    qToLittleEndian<quint32>(volume_id, b + 67);
+    memcpy(b + 71, "NO NAME    ", 11);
+    memcpy(b + 82, "FAT32   ", 8);
+    b[510] = 0x55;
+    b[511] = 0xAA;
+
+    // FSInfo sector
+    QByteArray fsinfo(sector_size, '\0');
+    uchar *f = (uchar *) fsinfo.data();
+    qToLittleEndian<quint32>(0x41615252, f + 0);
+    qToLittleEndian<quint32>(0x61417272, f + 484);
+    // NOTE: first cluster is used by root directory
+    qToLittleEndian<quint32>(cluster_count - 1, f + 488);
+    qToLittleEndian<quint32>(3, f + 492);
+    qToLittleEndian<quint32>(0xAA550000, f + 508);
+
+    // First FAT sector. Entries 0 and 1 are reserved,
+    // entry 2 is the root directory.
+    QByteArray fat(sector_size, '\0');
+    uchar *t = (uchar *) fat.data();
+    qToLittleEndian<quint32>(0x0FFFFFF8, t + 0);
+    qToLittleEndian<quint32>(0x0FFFFFFF, t + 4);
+    qToLittleEndian<quint32>(0x0FFFFFFF, t + 8);
+
+    // Partition table
+    QByteArray mbr(sector_size, '\0');
+    uchar *m = (uchar *) mbr.data();
+    qToLittleEndian<quint32>(disk_signature, m + 440);
+    uchar *entry = m + 446;
+    entry[0] = 0x00;
+    // NOTE: CHS addresses are not used, fill them with
+    // max values like other partitioning tools do
+    entry[1] = 0xFE;
+    entry[2] = 0xFF;
+    entry[3] = 0xFF;
+    // FAT32 with LBA
+    entry[4] = 0x0C;
+    entry[5] = 0xFE;
+    entry[6] = 0xFF;
+    entry[7] = 0xFF;
+    qToLittleEndian<quint32>(partition_start, entry + 8);
+    qToLittleEndian<quint32>(partition_sectors, entry + 12);
+    m[510] = 0x55;
+    m[511] = 0xAA;
+
+    const bool write_success = [&]() {
+        const quint64 fat_offset = partition_offset + RESERVED_SECTORS * sector_size;
+
+        for (quint64 i = 0; i < FAT_COUNT; i++) {
+            if (!write_at(fd, fat, fat_offset + i * fat_sectors * sector_size)) {
+                return false;
+            }
+        }
+
+        // NOTE: partition table is written last so that
+        // partition doesn't appear before filesystem is
+        // complete
+        return write_at(fd, boot, partition_offset) && write_at(fd, fsinfo, partition_offset + 1 * sector_size) && write_at(fd, boot, partition_offset + 6 * sector_size) && write_at(fd, fsinfo, partition_offset + 7 * sector_size) && fdatasync(fd) == 0 && write_at(fd, mbr, 0) && fdatasync(fd) == 0;
+    }();
+
+    if (!write_success) {
+        *error = QCoreApplication::translate("RestoreJob", "Failed to write to the drive: %1").arg(strerror(errno));
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,41 @@
+/*
+ * ALT Media Writer
+ * Copyright (C) 2016-2019 Martin Bříza <mbriza@redhat.com>
+ * Copyright (C) 2020-2022 Dmitry Degtyarev <kevl@basealt.ru>
+ *
+ * ALT Media Writer is a fork of Fedora Media Writer
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef FAT32LAYOUT_H
+#define FAT32LAYOUT_H
+
+#include <QString>
+
+// Writes a single partition layout directly to the device:
+// an MBR with one FAT32 partition starting at 1MiB and an
+// empty FAT32 filesystem on that partition. Before that,
+// the whole device is discarded, so restoring doesn't
+// depend on device size. Only the structures of the new
+// filesystem are written, which is a few megabytes even
+// for big drives. Everything is laid out in logical
+// sectors of the device, sizes from 512 to 4096 bytes are
+// supported. Returns false on failure, with error
+// describing the reason, callers should fall back to
+// udisks_format_drive() then.
+bool fat32_layout_write(const int fd, QString *error);
+
+#endif // FAT32LAYOUT_H
@@ -0,0 +1,505 @@
+/*
+ * ALT Media Writer
+ * Copyright (C) 2016-2019 Martin Bříza <mbriza@redhat.com>
+ * Copyright (C) 2020-2022 Dmitry Degtyarev <kevl@basealt.ru>
+ *
+ * ALT Media Writer is a fork of Fedora Media Writer
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "imagemap.h"
+
+#include <QPair>
+
+#include <algorithm>
+
+const qint64 IMAGE_MAP_SECTOR_SIZE = 512;
+
+// NOTE: FAT of a 2TB FAT32 filesystem with smallest
+// clusters, anything bigger is not a real filesystem
+const qint64 IMAGE_MAP_FAT_MAX_SIZE = 256 * 1024 * 1024;
+
+struct ImagePartition {
+    qint64 offset;
+    qint64 size;
+};
+
+bool image_map_partitions_mbr(QFile *file, QList<ImagePartition> *out);
+bool image_map_partitions_gpt(QFile *file, QList<ImagePartition> *out);
+bool image_map_ext(QFile *file, const ImagePartition &partition, QList<ImageExtent> *out);
+bool image_map_fat(QFile *file, const ImagePartition &partition, QList<ImageExtent> *out);
+qint64 image_map_ext_block(const char *desc, const int lo_offset, const int hi_offset, const bool has_hi);
+void image_map_add(QList<ImageExtent> *extents, const qint64 offset, const qint64 length);
+QList<ImageExtent> image_map_align(const QList<ImageExtent> &extents, const qint64 alignment, const qint64 file_size);
+QByteArray image_map_read_at(QFile *file, const qint64 offset, const qint64 size);
+quint16 image_map_le16(const char *data);
+quint32 image_map_le32(const char *data);
+quint64 image_map_le64(const char *data);
+
+bool image_map_read(QFile *file, const qint64 alignment, ImageMap *map) {
+    const qint64 file_size = file->size();
+
+    QList<ImagePartition> partitions;
+    const bool partitions_success = image_map_partitions_mbr(file, &partitions);
+    if (!partitions_success) {
+        return false;
+    }
+
+    // NOTE: partitions may be cut off if the image was
+    // truncated to its last used byte
+    QList<ImagePartition> clamped;
+    for (const ImagePartition &partition : partitions) {
+        if (partition.offset >= file_size || partition.size <= 0) {
+            continue;
+        }
+
+        ImagePartition out;
+        out.offset = partition.offset;
+        out.size = qMin(partition.size, file_size - partition.offset);
+        clamped.append(out);
+    }
+    if (clamped.isEmpty()) {
+        return false;
+    }
+
+    std::sort(clamped.begin(), clamped.end(),
+        [](const ImagePartition &a, const ImagePartition &b) {
+            return a.offset < b.offset;
+        });
+
+    QList<ImageExtent> outside;
+    qint64 pos = 0;
+    for (const ImagePartition &partition : clamped) {
+        if (partition.offset > pos) {
+            image_map_add(&outside, pos, partition.offset - pos);
+        }
+        pos = qMax(pos, partition.offset + partition.size);
+    }
+    if (pos < file_size) {
+        image_map_add(&outside, pos, file_size - pos);
+    }
+
+    map->clear();
+    map->append(image_map_align(outside, alignment, file_size));
+
+    for (const ImagePartition &partition : clamped) {
+        QList<ImageExtent> used;
+
+        const bool known_filesystem = (image_map_ext(file, partition, &used) || image_map_fat(file, partition, &used));
+        if (!known_filesystem) {
+            used.clear();
+            image_map_add(&used, partition.offset, partition.size);
+        }
+
+        map->append(image_map_align(used, alignment, file_size));
+    }
+
+    return true;
+}
+
+qint64 image_map_size(const ImageMap &map) {
+    qint64 out = 0;
+
+    for (const QList<ImageExtent> &group : map) {
+        for (const ImageExtent &extent : group) {
+            out += extent.length;
+        }
+    }
+
+    return out;
+}
+
+bool image_map_partitions_mbr(QFile *file, QList<ImagePartition> *out) {
+    const QByteArray mbr = image_map_read_at(file, 0, IMAGE_MAP_SECTOR_SIZE);
+    if (mbr.size() != IMAGE_MAP_SECTOR_SIZE || image_map_le16(mbr.constData() + 510) != 0xAA55) {
+        return false;
+    }
+
+    for (int i = 0; i < 4; i++) {
+        const char *entry = mbr.constData() + 446 + i * 16;
+        const quint8 type = entry[4];
+        const qint64 start = image_map_le32(entry + 8);
+        const qint64 count = image_map_le32(entry + 12);
+
+        // NOTE: protective MBR covers the whole disk, the
+        // real partitions are in GPT
+        if (type == 0xEE) {
+            out->clear();
+
+            return image_map_partitions_gpt(file, out);
+        }
+
+        // NOTE: extended partitions are written completely,
+        // including the logical partitions inside
+        if (type != 0x00 && count > 0) {
+            ImagePartition partition;
+            partition.offset = start * IMAGE_MAP_SECTOR_SIZE;
+            partition.size = count * IMAGE_MAP_SECTOR_SIZE;
+            out->append(partition);
+        }
+    }
+
+    return true;
+}
+
+bool image_map_partitions_gpt(QFile *file, QList<ImagePartition> *out) {
+    // NOTE: images for 4K sector drives have the header
+    // at 4096
+    for (const qint64 sector_size : {IMAGE_MAP_SECTOR_SIZE, (qint64) 4096}) {
+        const QByteArray header = image_map_read_at(file, sector_size, 92);
+        if (header.size() != 92 || !header.startsWith("EFI PART")) {
+            continue;
+        }
+
+        const qint64 entries_lba = image_map_le64(header.constData() + 72);
+        const qint64 entry_count = image_map_le32(header.constData() + 80);
+        const qint64 entry_size = image_map_le32(header.constData() + 84);
+        // NOTE: the spec requires entry size to be 128 * 2^n,
+        // bound it like entry count so the read stays small
+        const bool entry_size_valid = (entry_size >= 128 && entry_size <= 4096 && (entry_size & (entry_size - 1)) == 0);
+        if (!entry_size_valid || entry_count > 1024) {
+            return false;
+        }
+
+        const QByteArray entries = image_map_read_at(file, entries_lba * sector_size, entry_count * entry_size);
+        if (entries.size() != entry_count * entry_size) {
+            return false;
+        }
+
+        for (int i = 0; i < entry_count; i++) {
+            const char *entry = entries.constData() + i * entry_size;
+
+            const bool unused = std::all_of(entry, entry + 16,
+                [](const char c) {
+                    return c == 0;
+                });
+            if (unused) {
+                continue;
+            }
+
+            const qint64 first_lba = image_map_le64(entry + 32);
+            const qint64 last_lba = image_map_le64(entry + 40);
+            if (last_lba < first_lba) {
+                continue;
+            }
+
+            ImagePartition partition;
+            partition.offset = first_lba * sector_size;
+            partition.size = (last_lba - first_lba + 1) * sector_size;
+            out->append(partition);
+        }
+
+        return true;
+    }
+
+    return false;
+}
+
+// Adds blocks marked in block bitmaps of ext2/3/4
+bool image_map_ext(QFile *file, const ImagePartition &partition, QList<ImageExtent> *out) {
+    const QByteArray superblock = image_map_read_at(file, partition.offset + 1024, 1024);
+    if (superblock.size() != 1024 || image_map_le16(superblock.constData() + 56) != 0xEF53) {
+        return false;
+    }
+    const char *sb = superblock.constData();
+
+    const quint32 log_block_size = image_map_le32(sb + 24);
+    if (log_block_size > 6) {
+        return false;
+    }
+    const qint64 block_size = 1024LL << log_block_size;
+
+    const quint32 incompat = image_map_le32(sb + 96);
+    const bool is_64bit = (incompat & 0x80);
+
+    // NOTE: with meta_bg, group descriptors are spread
+    // over the filesystem, which is rare enough to not
+    // bother with
+    const bool meta_bg = (incompat & 0x10);
+    if (meta_bg) {
+        return false;
+    }
+
+    const qint64 first_data_block = image_map_le32(sb + 20);
+    const qint64 blocks_per_group = image_map_le32(sb + 32);
+    qint64 blocks_count = image_map_le32(sb + 4);
+    if (is_64bit) {
+        blocks_count |= (qint64) image_map_le32(sb + 0x150) << 32;
+    }
+    const qint64 desc_size = is_64bit ? image_map_le16(sb + 0xFE) : 32;
+
+    const bool valid = (blocks_per_group > 0 && blocks_per_group <= block_size * 8 && desc_size >= 32 && blocks_count > first_data_block && blocks_count * block_size <= partition.size);
+    if (!valid) {
+        return false;
+    }
+
+    const qint64 group_count = (blocks_count - first_data_block + blocks_per_group - 1) / blocks_per_group;
+    const qint64 gdt_blocks = (group_count * desc_size + block_size - 1) / block_size;
+    const qint64 reserved_gdt_blocks = image_map_le16(sb + 0xCE);
+
+    const qint64 inodes_per_group = image_map_le32(sb + 40);
+    const qint64 inode_size = (image_map_le32(sb + 76) == 0) ? 128 : image_map_le16(sb + 88);
+    const qint64 inode_table_blocks = (inodes_per_group * inode_size + block_size - 1) / block_size;
+
+    const bool sparse_super = (image_map_le32(sb + 100) & 0x1);
+    const bool sparse_super2 = (image_map_le32(sb + 92) & 0x200);
+
+    // NOTE: with sparse_super, superblock backups are
+    // only in groups 0, 1 and powers of 3, 5 and 7
+    const auto has_super = [&](const qint64 group) {
+        if (!sparse_super || group <= 1) {
+            return true;
+        }
+
+        for (const qint64 base : {3, 5, 7}) {
+            qint64 power = base;
+            while (power < group) {
+                power *= base;
+            }
+            if (power == group) {
+                return true;
+            }
+        }
+
+        return false;
+    };
+    const QByteArray descriptors = image_map_read_at(file, partition.offset + (first_data_block + 1) * block_size, group_count * desc_size);
+    if (descriptors.size() != group_count * desc_size) {
+        return false;
+    }
+
+    QList<ImageExtent> used;
+
+    // NOTE: blocks before the first data block are not in
+    // any group, this is the boot sector on filesystems
+    // with 1K blocks
+    if (first_data_block > 0) {
+        image_map_add(&used, partition.offset, first_data_block * block_size);
+    }
+
+    for (qint64 group = 0; group < group_count; group++) {
+        const char *desc = descriptors.constData() + group * desc_size;
+        const quint16 flags = image_map_le16(desc + 18);
+        const qint64 bitmap_block = image_map_ext_block(desc, 0, 0x20, is_64bit && desc_size >= 64);
+
+        const qint64 group_start = first_data_block + group * blocks_per_group;
+        const qint64 group_blocks = qMin(blocks_per_group, blocks_count - group_start);
+
+        // NOTE: bitmap of a group with BLOCK_UNINIT is not
+        // on disk. Like the kernel, assume that such a group
+        // only contains superblock and descriptor backups
+        // and its own metadata.
+        const bool bitmap_uninit = (flags & 0x2);
+        if (bitmap_uninit) {
+            if (sparse_super2) {
+                image_map_add(&used, partition.offset + group_start * block_size, group_blocks * block_size);
+                continue;
+            }
+
+            QList<QPair<qint64, qint64>> metadata;
+            if (has_super(group)) {
+                metadata.append({group_start, 1 + gdt_blocks + reserved_gdt_blocks});
+            }
+            metadata.append({bitmap_block, 1});
+            metadata.append({image_map_ext_block(desc, 4, 0x24, is_64bit && desc_size >= 64), 1});
+            metadata.append({image_map_ext_block(desc, 8, 0x28, is_64bit && desc_size >= 64), inode_table_blocks});
+            std::sort(metadata.begin(), metadata.end());
+
+            for (const QPair<qint64, qint64> &range : metadata) {
+                const qint64 start = qMax(range.first, group_start);
+                const qint64 end = qMin(range.first + range.second, group_start + group_blocks);
+                if (end > start) {
+                    image_map_add(&used, partition.offset + start * block_size, (end - start) * block_size);
+                }
+            }
+
+            continue;
+        }
+
+        if (bitmap_block >= blocks_count) {
+            return false;
+        }
+
+        const QByteArray bitmap = image_map_read_at(file, partition.offset + bitmap_block * block_size, block_size);
+        if (bitmap.size() != block_size) {
+            return false;
+        }
+
+        for (qint64 i = 0; i < group_blocks; i++) {
+            const bool block_used = ((quint8) bitmap[(int) (i / 8)] >> (i % 8)) & 1;
+            if (block_used) {
+                image_map_add(&used, partition.offset + (group_start + i) * block_size, block_size);
+            }
+        }
+    }
+
+    *out = used;
+
+    return true;
+}
+
+// Reads block number from group descriptor, which is
+// split in two halves on 64bit filesystems
+qint64 image_map_ext_block(const char *desc, const int lo_offset, const int hi_offset, const bool has_hi) {
+    qint64 out = image_map_le32(desc + lo_offset);
+    if (has_hi) {
+        out |= (qint64) image_map_le32(desc + hi_offset) << 32;
+    }
+
+    return out;
+}
+
+// Adds reserved area, FATs, root directory and clusters
+// that are not free in FAT12/16/32
+bool image_map_fat(QFile *file, const ImagePartition &partition, QList<ImageExtent> *out) {
+    const QByteArray boot = image_map_read_at(file, partition.offset, 512);
+    if (boot.size() != 512 || image_map_le16(boot.constData() + 510) != 0xAA55) {
+        return false;
+    }
+    const char *b = boot.constData();
+
+    const qint64 bytes_per_sector = image_map_le16(b + 11);
+    const qint64 sectors_per_cluster = (quint8) b[13];
+    const qint64 reserved_sectors = image_map_le16(b + 14);
+    const qint64 fat_count = (quint8) b[16];
+    const qint64 root_entries = image_map_le16(b + 17);
+    const qint64 total_sectors = (image_map_le16(b + 19) != 0) ? image_map_le16(b + 19) : image_map_le32(b + 32);
+    const qint64 fat_sectors = (image_map_le16(b + 22) != 0) ? image_map_le16(b + 22) : image_map_le32(b + 36);
+
+    const auto is_power_of_two = [](const qint64 x) {
+        return (x > 0 && (x & (x - 1)) == 0);
+    };
+
+    // NOTE: NTFS and exFAT have zeros in some of these
+    // fields, so they don't pass
+    const bool jump_valid = ((quint8) b[0] == 0xEB || (quint8) b[0] == 0xE9);
+    const bool geometry_valid = (jump_valid && is_power_of_two(bytes_per_sector) && bytes_per_sector >= 512 && bytes_per_sector <= 4096 && is_power_of_two(sectors_per_cluster) && reserved_sectors > 0 && fat_count > 0 && total_sectors > 0 && fat_sectors > 0);
+    if (!geometry_valid) {
+        return false;
+    }
+
+    const qint64 root_sectors = (root_entries * 32 + bytes_per_sector - 1) / bytes_per_sector;
+    const qint64 data_start = reserved_sectors + fat_count * fat_sectors + root_sectors;
+    const qint64 fat_size = fat_sectors * bytes_per_sector;
+    if (data_start >= total_sectors || total_sectors * bytes_per_sector > partition.size || fat_size > IMAGE_MAP_FAT_MAX_SIZE) {
+        return false;
+    }
+
+    const qint64 cluster_count = (total_sectors - data_start) / sectors_per_cluster;
+    const int fat_bits = [&]() {
+        if (cluster_count < 4085) {
+            return 12;
+        } else if (cluster_count < 65525) {
+            return 16;
+        } else {
+            return 32;
+        }
+    }();
+    if ((cluster_count + 2) * fat_bits / 8 + 2 > fat_size) {
+        return false;
+    }
+
+    const QByteArray fat = image_map_read_at(file, partition.offset + reserved_sectors * bytes_per_sector, fat_size);
+    if (fat.size() != fat_size) {
+        return false;
+    }
+
+    QList<ImageExtent> used;
+    image_map_add(&used, partition.offset, data_start * bytes_per_sector);
+
+    const qint64 cluster_size = sectors_per_cluster * bytes_per_sector;
+    for (qint64 cluster = 2; cluster < cluster_count + 2; cluster++) {
+        const quint32 entry = [&]() -> quint32 {
+            switch (fat_bits) {
+                case 12: {
+                    const quint16 value = image_map_le16(fat.constData() + cluster + cluster / 2);
+                    if (cluster % 2 == 0) {
+                        return value & 0xFFF;
+                    } else {
+                        return value >> 4;
+                    }
+                }
+                case 16: return image_map_le16(fat.constData() + cluster * 2);
+                default: return image_map_le32(fat.constData() + cluster * 4) & 0x0FFFFFFF;
+            }
+        }();
+
+        if (entry != 0) {
+            image_map_add(&used, partition.offset + data_start * bytes_per_sector + (cluster - 2) * cluster_size, cluster_size);
+        }
+    }
+
+    *out = used;
+
+    return true;
+}
+
+// Adds extent to the end, merging it with the last one if
+// they touch. Extents have to be added in order.
+void image_map_add(QList<ImageExtent> *extents, const qint64 offset, const qint64 length) {
+    if (!extents->isEmpty()) {
+        ImageExtent &last = (*extents)[extents->size() - 1];
+        if (last.offset + last.length >= offset) {
+            last.length = qMax(last.length, offset + length - last.offset);
+
+            return;
+        }
+    }
+
+    ImageExtent extent;
+    extent.offset = offset;
+    extent.length = length;
+    extents->append(extent);
+}
+
+// NOTE: device is written with O_DIRECT, which needs
+// aligned offsets. Writing a bit more of the image
+// around an extent is harmless.
+QList<ImageExtent> image_map_align(const QList<ImageExtent> &extents, const qint64 alignment, const qint64 file_size) {
+    QList<ImageExtent> out;
+
+    for (const ImageExtent &extent : extents) {
+        const qint64 start = extent.offset / alignment * alignment;
+        const qint64 end = qMin(file_size, (extent.offset + extent.length + alignment - 1) / alignment * alignment);
+        if (end > start) {
+            image_map_add(&out, start, end - start);
+        }
+    }
+
+    return out;
+}
+
+QByteArray image_map_read_at(QFile *file, const qint64 offset, const qint64 size) {
+    file->seek(offset);
+
+    return file->read(size);
+}
+
+quint16 image_map_le16(const char *data) {
+    const quint8 *p = (const quint8 *) data;
+
+    return p[0] | (p[1] << 8);
+}
+
+quint32 image_map_le32(const char *data) {
+    const quint8 *p = (const quint8 *) data;
+
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((quint32) p[3] << 24);
+}
+
+quint64 image_map_le64(const char *data) {
+    return image_map_le32(data) | ((quint64) image_map_le32(data + 4) << 32);
+}
@@ -0,0 +1,57 @@
+/*
+ * ALT Media Writer
+ * Copyright (C) 2016-2019 Martin Bříza <mbriza@redhat.com>
+ * Copyright (C) 2020-2022 Dmitry Degtyarev <kevl@basealt.ru>
+ *
+ * ALT Media Writer is a fork of Fedora Media Writer
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef IMAGEMAP_H
+#define IMAGEMAP_H
+
+/**
+ * Image map lists the parts of a partitioned disk image
+ * that have to be written. Partition tables and
+ * everything outside of partitions is always written,
+ * because bootloaders often live there. Inside of
+ * partitions with ext2/3/4 or FAT filesystems, only
+ * blocks that the filesystem uses are written. Other
+ * partitions are written completely.
+ */
+
+#include <QFile>
+#include <QList>
+
+struct ImageExtent {
+    qint64 offset;
+    qint64 length;
+};
+
+// NOTE: first group is the area outside of partitions,
+// followed by a group for each partition. Extents within
+// a group are sorted and don't overlap.
+typedef QList<QList<ImageExtent>> ImageMap;
+
+// Reads partition table of the image and the filesystems
+// on it. Extents are aligned to the alignment, but don't
+// go past the end of the image. Returns false if the image
+// has no partition table.
+bool image_map_read(QFile *file, const qint64 alignment, ImageMap *map);
+
+qint64 image_map_size(const ImageMap &map);
+
+#endif // IMAGEMAP_H
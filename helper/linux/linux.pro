@@ -3,9 +3,9 @@ TEMPLATE = app
 QT += core network dbus
 
 CONFIG += link_pkgconfig
-PKGCONFIG += liblzma
+PKGCONFIG += liblzma zlib libzstd
 
-LIBS += -lisomd5
+LIBS += -lisomd5 -limageformat -lbz2
 
 CONFIG += c++11
 CONFIG += console
@@ -19,10 +19,36 @@ INSTALLS += target
 
 SOURCES = main.cpp \
     writejob.cpp \
-    restorejob.cpp
+    restorejob.cpp \
+    pagealignedbuffer.cpp \
+    fat32layout.cpp \
+    udisksunmount.cpp \
+    probejob.cpp \
+    surfacetestjob.cpp \
+    writetuner.cpp \
+    streamdecoder.cpp \
+    xzindex.cpp \
+    writejournal.cpp \
+    tarreader.cpp \
+    extractjob.cpp \
+    imagemap.cpp \
+    bmap.cpp
 
 HEADERS += \
     writejob.h \
-    restorejob.h
+    restorejob.h \
+    pagealignedbuffer.h \
+    fat32layout.h \
+    udisksunmount.h \
+    probejob.h \
+    surfacetestjob.h \
+    writetuner.h \
+    streamdecoder.h \
+    xzindex.h \
+    writejournal.h \
+    tarreader.h \
+    extractjob.h \
+    imagemap.h \
+    bmap.h
 
 RESOURCES += ../../translations/translations.qrc
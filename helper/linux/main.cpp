@@ -24,7 +24,10 @@
 #include <QTextStream>
 #include <QTranslator>
 
+#include "extractjob.h"
+#include "probejob.h"
 #include "restorejob.h"
+#include "surfacetestjob.h"
 #include "writejob.h"
 
 int main(int argc, char *argv[]) {
@@ -36,8 +39,16 @@ int main(int argc, char *argv[]) {
 
     if (app.arguments().count() == 3 && app.arguments()[1] == "restore") {
         new RestoreJob(app.arguments()[2]);
-    } else if (app.arguments().count() == 5 && app.arguments()[1] == "write") {
-        new WriteJob(app.arguments()[2], app.arguments()[3], app.arguments()[4]);
+    } else if (app.arguments().count() == 3 && app.arguments()[1] == "probe") {
+        new ProbeJob(app.arguments()[2]);
+    } else if ((app.arguments().count() == 3 || app.arguments().count() == 4) && app.arguments()[1] == "surface-test") {
+        // NOTE: optional seed to repeat a previous test
+        new SurfaceTestJob(app.arguments()[2], app.arguments().value(3));
+    } else if (app.arguments().count() == 4 && app.arguments()[1] == "extract") {
+        new ExtractJob(app.arguments()[2], app.arguments()[3]);
+    } else if (app.arguments().count() >= 5 && app.arguments()[1] == "write") {
+        // NOTE: arguments after md5 are options
+        new WriteJob(app.arguments()[2], app.arguments()[3], app.arguments()[4], app.arguments().mid(5));
     } else {
         QTextStream err(stderr);
         err << "Helper: Wrong arguments entered";
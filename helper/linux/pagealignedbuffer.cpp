@@ -0,0 +1,47 @@
+/*
+ * ALT Media Writer
+ * Copyright (C) 2016-2019 Martin Bříza <mbriza@redhat.com>
+ * Copyright (C) 2020-2022 Dmitry Degtyarev <kevl@basealt.ru>
+ *
+ * ALT Media Writer is a fork of Fedora Media Writer
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "pagealignedbuffer.h"
+
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+
+#include <unistd.h>
+
+PageAlignedBuffer::PageAlignedBuffer(const size_t page_count) {
+    static const size_t page_size = getpagesize();
+    size = page_count * page_size;
+    const size_t unaligned_size = size + page_size;
+    unaligned_buffer = malloc(unaligned_size * sizeof(uint8_t));
+
+    // NOTE: align() modifies space and ptr args to
+    // return values for aligned buffer
+    void *ptr_arg = unaligned_buffer;
+    size_t space_arg = unaligned_size;
+
+    buffer = std::align(page_size, size, ptr_arg, space_arg);
+}
+
+PageAlignedBuffer::~PageAlignedBuffer() {
+    free(unaligned_buffer);
+}
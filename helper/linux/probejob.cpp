@@ -0,0 +1,298 @@
+/*
+ * ALT Media Writer
+ * Copyright (C) 2016-2019 Martin Bříza <mbriza@redhat.com>
+ * Copyright (C) 2020-2022 Dmitry Degtyarev <kevl@basealt.ru>
+ *
+ * ALT Media Writer is a fork of Fedora Media Writer
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "probejob.h"
+#include "pagealignedbuffer.h"
+#include "udisksunmount.h"
+
+#include <QCoreApplication>
+#include <QDBusInterface>
+#include <QDBusUnixFileDescriptor>
+#include <QElapsedTimer>
+#include <QTextStream>
+#include <QTimer>
+#include <QtDBus>
+
+#include <fcntl.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <random>
+#include <vector>
+
+typedef QHash<QString, QVariant> Properties;
+Q_DECLARE_METATYPE(Properties)
+
+// NOTE: probe should take a few seconds, so only a small
+// part of the device is tested
+const size_t PROBE_SEQUENTIAL_SIZE = 32 * 1024 * 1024;
+// NOTE: smaller drives don't leave enough room for tags
+const uint64_t PROBE_MIN_DEVICE_SIZE = 1024 * 1024;
+const size_t PROBE_RANDOM_SIZE = 4096;
+const int PROBE_RANDOM_COUNT = 64;
+const size_t PROBE_TAG_SIZE = 4096;
+const int PROBE_TAG_COUNT = 64;
+const char PROBE_TAG_MAGIC[] = "AMWPROBE";
+
+void probe_tag_fill(uint8_t *buffer, const uint64_t run_id, const uint64_t offset);
+
+ProbeJob::ProbeJob(const QString &where)
+: QObject(nullptr)
+, where(where) {
+    qDBusRegisterMetaType<Properties>();
+
+    deviceSize = 0;
+    sequentialSize = 0;
+    ioErrors = false;
+
+    QTimer::singleShot(0, this, SLOT(work()));
+}
+
+void ProbeJob::work() {
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+
+    udisks_unmount_drive(where);
+
+    QDBusInterface device("org.freedesktop.UDisks2", where, "org.freedesktop.UDisks2.Block", QDBusConnection::systemBus(), this);
+    QDBusReply<QDBusUnixFileDescriptor> reply = device.callWithArgumentList(QDBus::Block, "OpenDevice", {"rw", Properties{{"flags", O_DIRECT | O_SYNC | O_CLOEXEC}, {"writable", true}}});
+    const QDBusUnixFileDescriptor fd = reply.value();
+    if (!fd.isValid()) {
+        err << reply.error().message();
+        err.flush();
+        qApp->exit(2);
+        return;
+    }
+
+    const bool size_success = (ioctl(fd.fileDescriptor(), BLKGETSIZE64, &deviceSize) == 0);
+    if (!size_success) {
+        err << tr("Failed to get device size");
+        err.flush();
+        qApp->exit(3);
+        return;
+    }
+    if (deviceSize < PROBE_MIN_DEVICE_SIZE) {
+        err << tr("The drive is too small to be checked");
+        err.flush();
+        qApp->exit(3);
+        return;
+    }
+
+    // NOTE: sequential area is shrunk to fit in half of
+    // small drives, it stays a power of two for alignment
+    sequentialSize = PROBE_SEQUENTIAL_SIZE;
+    while (sequentialSize > deviceSize / 2) {
+        sequentialSize /= 2;
+    }
+
+    probeSequential(fd.fileDescriptor());
+    probeRandom(fd.fileDescriptor());
+
+    const bool capacity_ok = probeCapacity(fd.fileDescriptor());
+    if (!capacity_ok) {
+        out << "FAKECAPACITY\n";
+    }
+    if (ioErrors) {
+        out << "IOERRORS\n";
+    }
+
+    out << "DONE\n";
+    out.flush();
+    qApp->exit(0);
+}
+
+bool ProbeJob::readAt(int fd, void *buffer, const size_t size, const uint64_t offset) {
+    const ssize_t result = pread(fd, buffer, size, offset);
+    const bool success = (result == (ssize_t) size);
+
+    if (!success) {
+        ioErrors = true;
+    }
+
+    return success;
+}
+
+bool ProbeJob::writeAt(int fd, const void *buffer, const size_t size, const uint64_t offset) {
+    const ssize_t result = pwrite(fd, buffer, size, offset);
+    const bool success = (result == (ssize_t) size);
+
+    if (!success) {
+        ioErrors = true;
+    }
+
+    return success;
+}
+
+// Reads an area in the middle of the device and writes
+// the same data back
+void ProbeJob::probeSequential(int fd) {
+    QTextStream out(stdout);
+
+    const PageAlignedBuffer buffer(sequentialSize / getpagesize());
+    const uint64_t offset = (deviceSize / 2) & ~((uint64_t) sequentialSize - 1);
+
+    QElapsedTimer timer;
+    timer.start();
+    const bool read_success = readAt(fd, buffer.buffer, sequentialSize, offset);
+    const qint64 read_nsecs = timer.nsecsElapsed();
+    if (!read_success) {
+        return;
+    }
+
+    timer.restart();
+    const bool write_success = writeAt(fd, buffer.buffer, sequentialSize, offset);
+    const qint64 write_nsecs = timer.nsecsElapsed();
+    if (!write_success) {
+        return;
+    }
+
+    out << "READSPEED " << (qint64) (sequentialSize * 1e9 / qMax(read_nsecs, (qint64) 1)) << "\n";
+    out << "WRITESPEED " << (qint64) (sequentialSize * 1e9 / qMax(write_nsecs, (qint64) 1)) << "\n";
+    out.flush();
+}
+
+// Reads small blocks at random offsets and writes the
+// same data back
+void ProbeJob::probeRandom(int fd) {
+    QTextStream out(stdout);
+
+    const PageAlignedBuffer buffer(PROBE_RANDOM_SIZE * PROBE_RANDOM_COUNT / getpagesize());
+    uint8_t *const data = (uint8_t *) buffer.buffer;
+
+    std::mt19937_64 random((std::random_device()) ());
+    std::uniform_int_distribution<uint64_t> distribution(0, deviceSize / PROBE_RANDOM_SIZE - 1);
+    std::vector<uint64_t> offsets;
+    for (int i = 0; i < PROBE_RANDOM_COUNT; i++) {
+        offsets.push_back(distribution(random) * PROBE_RANDOM_SIZE);
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    for (int i = 0; i < PROBE_RANDOM_COUNT; i++) {
+        const bool success = readAt(fd, data + i * PROBE_RANDOM_SIZE, PROBE_RANDOM_SIZE, offsets[i]);
+        if (!success) {
+            return;
+        }
+    }
+    const qint64 read_nsecs = timer.nsecsElapsed();
+
+    timer.restart();
+    for (int i = 0; i < PROBE_RANDOM_COUNT; i++) {
+        const bool success = writeAt(fd, data + i * PROBE_RANDOM_SIZE, PROBE_RANDOM_SIZE, offsets[i]);
+        if (!success) {
+            return;
+        }
+    }
+    const qint64 write_nsecs = timer.nsecsElapsed();
+
+    const qint64 total = PROBE_RANDOM_SIZE * PROBE_RANDOM_COUNT;
+    out << "RANDOMREADSPEED " << (qint64) (total * 1e9 / qMax(read_nsecs, (qint64) 1)) << "\n";
+    out << "RANDOMWRITESPEED " << (qint64) (total * 1e9 / qMax(write_nsecs, (qint64) 1)) << "\n";
+    out.flush();
+}
+
+// Fake drives report a larger size than they have and
+// map addresses past their real capacity onto existing
+// blocks, usually modulo the real capacity. Write unique
+// tags across the whole device first and only then check
+// that every tag still holds its own contents, so that a
+// tag overwritten through an alias is noticed. Returns
+// false if the capacity is fake.
+bool ProbeJob::probeCapacity(int fd) {
+    const PageAlignedBuffer tag(PROBE_TAG_SIZE / getpagesize());
+    const PageAlignedBuffer readback(PROBE_TAG_SIZE / getpagesize());
+    uint8_t *const tag_data = (uint8_t *) tag.buffer;
+
+    const uint64_t run_id = std::mt19937_64((std::random_device()) ())();
+
+    std::vector<uint64_t> offsets;
+    const uint64_t last_block = deviceSize / PROBE_TAG_SIZE - 1;
+    for (int i = 0; i < PROBE_TAG_COUNT; i++) {
+        const uint64_t block = last_block * i / (PROBE_TAG_COUNT - 1);
+        offsets.push_back(block * PROBE_TAG_SIZE);
+    }
+
+    // NOTE: real capacity is usually a power of two, so
+    // tags at powers of two past it wrap onto the tag at
+    // offset 0 or onto each other
+    for (uint64_t offset = PROBE_TAG_SIZE; offset <= last_block * PROBE_TAG_SIZE; offset *= 2) {
+        offsets.push_back(offset);
+    }
+
+    std::sort(offsets.begin(), offsets.end());
+    offsets.erase(std::unique(offsets.begin(), offsets.end()), offsets.end());
+    const int tag_count = offsets.size();
+
+    const PageAlignedBuffer originals(PROBE_TAG_SIZE * tag_count / getpagesize());
+    uint8_t *const original_data = (uint8_t *) originals.buffer;
+
+    // NOTE: if original data can't be read, it can't be
+    // restored, so nothing is written
+    for (int i = 0; i < tag_count; i++) {
+        const bool success = readAt(fd, original_data + i * PROBE_TAG_SIZE, PROBE_TAG_SIZE, offsets[i]);
+        if (!success) {
+            return true;
+        }
+    }
+
+    bool capacity_ok = true;
+
+    for (int i = 0; i < tag_count; i++) {
+        probe_tag_fill(tag_data, run_id, offsets[i]);
+        const bool success = writeAt(fd, tag_data, PROBE_TAG_SIZE, offsets[i]);
+        if (!success) {
+            capacity_ok = false;
+        }
+    }
+
+    for (int i = 0; i < tag_count; i++) {
+        probe_tag_fill(tag_data, run_id, offsets[i]);
+        const bool read_success = readAt(fd, readback.buffer, PROBE_TAG_SIZE, offsets[i]);
+        const bool tag_matches = read_success && (memcmp(readback.buffer, tag_data, PROBE_TAG_SIZE) == 0);
+        if (!tag_matches) {
+            capacity_ok = false;
+        }
+    }
+
+    for (int i = 0; i < tag_count; i++) {
+        writeAt(fd, original_data + i * PROBE_TAG_SIZE, PROBE_TAG_SIZE, offsets[i]);
+    }
+
+    return capacity_ok;
+}
+
+// Fills the buffer with a tag that is unique for this
+// run and offset
+void probe_tag_fill(uint8_t *buffer, const uint64_t run_id, const uint64_t offset) {
+    memcpy(buffer, PROBE_TAG_MAGIC, sizeof(PROBE_TAG_MAGIC));
+    memcpy(buffer + 16, &run_id, sizeof(run_id));
+    memcpy(buffer + 24, &offset, sizeof(offset));
+
+    std::mt19937_64 pattern(run_id ^ offset);
+    for (size_t i = 32; i + sizeof(uint64_t) <= PROBE_TAG_SIZE; i += sizeof(uint64_t)) {
+        const uint64_t value = pattern();
+        memcpy(buffer + i, &value, sizeof(value));
+    }
+}
@@ -0,0 +1,54 @@
+/*
+ * ALT Media Writer
+ * Copyright (C) 2016-2019 Martin Bříza <mbriza@redhat.com>
+ * Copyright (C) 2020-2022 Dmitry Degtyarev <kevl@basealt.ru>
+ *
+ * ALT Media Writer is a fork of Fedora Media Writer
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef PROBEJOB_H
+#define PROBEJOB_H
+
+#include <QObject>
+
+#include <cstdint>
+
+// Measures read and write speed of the device and checks
+// that it really has the capacity it reports. The probe
+// restores all data that it overwrites.
+class ProbeJob : public QObject {
+    Q_OBJECT
+public:
+    explicit ProbeJob(const QString &where);
+public slots:
+    void work();
+
+private:
+    QString where;
+    uint64_t deviceSize;
+    // Size of the area used to measure sequential speed
+    uint64_t sequentialSize;
+    bool ioErrors;
+
+    bool readAt(int fd, void *buffer, const size_t size, const uint64_t offset);
+    bool writeAt(int fd, const void *buffer, const size_t size, const uint64_t offset);
+    void probeSequential(int fd);
+    void probeRandom(int fd);
+    bool probeCapacity(int fd);
+};
+
+#endif // PROBEJOB_H
@@ -21,6 +21,8 @@
  */
 
 #include "restorejob.h"
+#include "fat32layout.h"
+#include "udisksunmount.h"
 
 #include <QCoreApplication>
 #include <QTextStream>
@@ -31,6 +33,10 @@
 #include <QDBusUnixFileDescriptor>
 #include <QtDBus>
 
+#include <fcntl.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+
 typedef QHash<QString, QVariant> Properties;
 typedef QHash<QString, Properties> InterfacesAndProperties;
 typedef QHash<QDBusObjectPath, InterfacesAndProperties> DBusIntrospection;
@@ -48,52 +54,55 @@ void RestoreJob::work() {
     QTextStream err(stderr);
 
     QDBusInterface device("org.freedesktop.UDisks2", where, "org.freedesktop.UDisks2.Block", QDBusConnection::systemBus(), this);
-    QString drivePath = qvariant_cast<QDBusObjectPath>(device.property("Drive")).path();
-    QDBusInterface drive("org.freedesktop.UDisks2", drivePath, "org.freedesktop.UDisks2.Drive", QDBusConnection::systemBus(), this);
-    QDBusInterface manager("org.freedesktop.UDisks2", "/org/freedesktop/UDisks2", "org.freedesktop.DBus.ObjectManager", QDBusConnection::systemBus());
-    QDBusMessage message = manager.call("GetManagedObjects");
-
-    if (message.arguments().length() == 1) {
-        QDBusArgument arg = qvariant_cast<QDBusArgument>(message.arguments().first());
-        DBusIntrospection objects;
-        arg >> objects;
-        for (const QDBusObjectPath &i : objects.keys()) {
-            if (objects[i].contains("org.freedesktop.UDisks2.Filesystem")) {
-                QString currentDrivePath = qvariant_cast<QDBusObjectPath>(objects[i]["org.freedesktop.UDisks2.Block"]["Drive"]).path();
-                if (currentDrivePath == drivePath) {
-                    QDBusInterface partition("org.freedesktop.UDisks2", i.path(), "org.freedesktop.UDisks2.Filesystem", QDBusConnection::systemBus());
-                    message = partition.call("Unmount", Properties{{"force", true}});
-                }
-            }
-        }
-    }
 
-    QDBusReply<void> formatReply = device.call("Format", "dos", Properties());
-    if (!formatReply.isValid() && formatReply.error().type() != QDBusError::NoReply) {
-        err << formatReply.error().message() << "\n";
-        err.flush();
-        qApp->exit(1);
-        return;
-    }
+    udisks_unmount_drive(where);
 
-    QDBusInterface partitionTable("org.freedesktop.UDisks2", where, "org.freedesktop.UDisks2.PartitionTable", QDBusConnection::systemBus(), this);
-    QDBusReply<QDBusObjectPath> partitionReply = partitionTable.call("CreatePartition", 1ULL, 0ULL, "", "", Properties());
-    if (!partitionReply.isValid()) {
-        err << partitionReply.error().message();
+    // Writing the layout directly is much faster than
+    // formatting through UDisks, which may wipe or scan
+    // the whole drive. UDisks is used as a fallback.
+    const bool direct_success = restoreDirect(device);
+    if (direct_success) {
         err.flush();
-        qApp->exit(2);
+        qApp->exit(0);
         return;
     }
-    QString partitionPath = partitionReply.value().path();
-    QDBusInterface partition("org.freedesktop.UDisks2", partitionPath, "org.freedesktop.UDisks2.Block", QDBusConnection::systemBus(), this);
-    QDBusReply<void> formatPartitionReply = partition.call("Format", "vfat", Properties{{"update-partition-type", true}});
-    if (!formatPartitionReply.isValid() && formatPartitionReply.error().type() != QDBusError::NoReply) {
-        err << formatPartitionReply.error().message() << "\n";
+
+    QString error;
+    const bool format_success = udisks_format_drive(where, &error);
+    if (!format_success) {
+        err << error << "\n";
         err.flush();
-        qApp->exit(3);
+        qApp->exit(1);
         return;
     }
     err.flush();
 
     qApp->exit(0);
 }
+
+bool RestoreJob::restoreDirect(QDBusInterface &device) {
+    QTextStream err(stderr);
+
+    QDBusReply<QDBusUnixFileDescriptor> reply = device.callWithArgumentList(QDBus::Block, "OpenDevice", {"rw", Properties{{"flags", O_CLOEXEC}, {"writable", true}}});
+    const QDBusUnixFileDescriptor fd = reply.value();
+    if (!fd.isValid()) {
+        err << reply.error().message() << "\n";
+        return false;
+    }
+
+    QString error;
+    const bool layout_success = fat32_layout_write(fd.fileDescriptor(), &error);
+    if (!layout_success) {
+        err << error << "\n";
+        return false;
+    }
+
+    // Let the kernel know about the new partition. If
+    // that fails, ask UDisks to do it.
+    const bool rescan_success = (ioctl(fd.fileDescriptor(), BLKRRPART) == 0);
+    if (!rescan_success) {
+        device.call("Rescan", Properties());
+    }
+
+    return true;
+}
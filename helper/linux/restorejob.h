@@ -25,6 +25,8 @@
 
 #include <QObject>
 
+class QDBusInterface;
+
 class RestoreJob : public QObject {
     Q_OBJECT
 public:
@@ -34,6 +36,8 @@ public slots:
 
 private:
     QString where;
+
+    bool restoreDirect(QDBusInterface &device);
 };
 
 #endif // RESTOREJOB_H
@@ -0,0 +1,352 @@
+/*
+ * ALT Media Writer
+ * Copyright (C) 2016-2019 Martin Bříza <mbriza@redhat.com>
+ * Copyright (C) 2020-2022 Dmitry Degtyarev <kevl@basealt.ru>
+ *
+ * ALT Media Writer is a fork of Fedora Media Writer
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "streamdecoder.h"
+
+#include <QtGlobal>
+
+#include <bzlib.h>
+#include <lzma.h>
+#include <zlib.h>
+#include <zstd.h>
+
+// NOTE: all decoders accept concatenated streams, which
+// parallel compressors like pigz, pbzip2 and pzstd create
+
+class XzDecoder : public StreamDecoder {
+public:
+    XzDecoder();
+    ~XzDecoder();
+
+    bool init() override;
+    DecodeResult decode(const uint8_t **in, size_t *in_size, uint8_t **out, size_t *out_size, const bool finish) override;
+
+private:
+    lzma_stream strm;
+};
+
+class GzipDecoder : public StreamDecoder {
+public:
+    GzipDecoder();
+    ~GzipDecoder();
+
+    bool init() override;
+    DecodeResult decode(const uint8_t **in, size_t *in_size, uint8_t **out, size_t *out_size, const bool finish) override;
+
+private:
+    z_stream strm;
+    bool initialized;
+    bool streamFinished;
+};
+
+class ZstdDecoder : public StreamDecoder {
+public:
+    ZstdDecoder();
+    ~ZstdDecoder();
+
+    bool init() override;
+    DecodeResult decode(const uint8_t **in, size_t *in_size, uint8_t **out, size_t *out_size, const bool finish) override;
+
+private:
+    ZSTD_DStream *strm;
+    bool frameFinished;
+};
+
+class Bzip2Decoder : public StreamDecoder {
+public:
+    Bzip2Decoder();
+    ~Bzip2Decoder();
+
+    bool init() override;
+    DecodeResult decode(const uint8_t **in, size_t *in_size, uint8_t **out, size_t *out_size, const bool finish) override;
+
+private:
+    bz_stream strm;
+    bool initialized;
+    bool streamFinished;
+};
+
+StreamDecoder::~StreamDecoder() {
+}
+
+StreamDecoder *stream_decoder_create(const ImageFormat format) {
+    switch (format) {
+        case ImageFormat_XZ: return new XzDecoder();
+        case ImageFormat_GZIP: return new GzipDecoder();
+        case ImageFormat_ZSTD: return new ZstdDecoder();
+        case ImageFormat_BZIP2: return new Bzip2Decoder();
+        default: return nullptr;
+    }
+}
+
+XzDecoder::XzDecoder() {
+    const lzma_stream strm_init = LZMA_STREAM_INIT;
+    strm = strm_init;
+}
+
+XzDecoder::~XzDecoder() {
+    lzma_end(&strm);
+}
+
+bool XzDecoder::init() {
+    const lzma_ret ret = lzma_stream_decoder(&strm, MEDIAWRITER_LZMA_LIMIT, LZMA_CONCATENATED);
+
+    return (ret == LZMA_OK);
+}
+
+DecodeResult XzDecoder::decode(const uint8_t **in, size_t *in_size, uint8_t **out, size_t *out_size, const bool finish) {
+    strm.next_in = *in;
+    strm.avail_in = *in_size;
+    strm.next_out = *out;
+    strm.avail_out = *out_size;
+
+    const lzma_ret ret = lzma_code(&strm, finish ? LZMA_FINISH : LZMA_RUN);
+
+    *in = strm.next_in;
+    *in_size = strm.avail_in;
+    *out = strm.next_out;
+    *out_size = strm.avail_out;
+
+    switch (ret) {
+        case LZMA_OK: return DecodeResult_OK;
+        case LZMA_STREAM_END: return DecodeResult_END;
+        case LZMA_MEM_ERROR: return DecodeResult_MEMORY_ERROR;
+        case LZMA_FORMAT_ERROR:
+        case LZMA_DATA_ERROR:
+        case LZMA_BUF_ERROR: return DecodeResult_CORRUPTED;
+        case LZMA_OPTIONS_ERROR: return DecodeResult_UNSUPPORTED;
+        default: return DecodeResult_ERROR;
+    }
+}
+
+GzipDecoder::GzipDecoder() {
+    strm = z_stream();
+    initialized = false;
+    streamFinished = false;
+}
+
+GzipDecoder::~GzipDecoder() {
+    if (initialized) {
+        inflateEnd(&strm);
+    }
+}
+
+bool GzipDecoder::init() {
+    // NOTE: 16 added to window bits selects gzip format
+    const int ret = inflateInit2(&strm, 16 + MAX_WBITS);
+    initialized = (ret == Z_OK);
+
+    return initialized;
+}
+
+DecodeResult GzipDecoder::decode(const uint8_t **in, size_t *in_size, uint8_t **out, size_t *out_size, const bool finish) {
+    if (finish && *in_size == 0 && streamFinished) {
+        return DecodeResult_END;
+    }
+
+    // NOTE: zlib sizes are 32-bit
+    const uInt in_chunk = (uInt) qMin(*in_size, (size_t) UINT32_MAX);
+    const uInt out_chunk = (uInt) qMin(*out_size, (size_t) UINT32_MAX);
+
+    strm.next_in = (Bytef *) *in;
+    strm.avail_in = in_chunk;
+    strm.next_out = *out;
+    strm.avail_out = out_chunk;
+
+    const int ret = inflate(&strm, Z_NO_FLUSH);
+
+    const size_t consumed = in_chunk - strm.avail_in;
+    const size_t produced = out_chunk - strm.avail_out;
+    *in += consumed;
+    *in_size -= consumed;
+    *out += produced;
+    *out_size -= produced;
+
+    if (consumed > 0) {
+        streamFinished = false;
+    }
+
+    switch (ret) {
+        case Z_OK: return DecodeResult_OK;
+        case Z_STREAM_END: {
+            // NOTE: another stream may follow
+            inflateReset(&strm);
+            streamFinished = true;
+
+            return DecodeResult_OK;
+        }
+        case Z_BUF_ERROR: {
+            // NOTE: input ended in the middle of a stream
+            if (finish && *in_size == 0) {
+                return DecodeResult_CORRUPTED;
+            } else {
+                return DecodeResult_OK;
+            }
+        }
+        case Z_MEM_ERROR: return DecodeResult_MEMORY_ERROR;
+        case Z_DATA_ERROR: return DecodeResult_CORRUPTED;
+        default: return DecodeResult_ERROR;
+    }
+}
+
+ZstdDecoder::ZstdDecoder() {
+    strm = nullptr;
+    frameFinished = false;
+}
+
+ZstdDecoder::~ZstdDecoder() {
+    if (strm != nullptr) {
+        ZSTD_freeDStream(strm);
+    }
+}
+
+bool ZstdDecoder::init() {
+    strm = ZSTD_createDStream();
+    if (strm == nullptr) {
+        return false;
+    }
+
+    const size_t ret = ZSTD_initDStream(strm);
+
+    return !ZSTD_isError(ret);
+}
+
+DecodeResult ZstdDecoder::decode(const uint8_t **in, size_t *in_size, uint8_t **out, size_t *out_size, const bool finish) {
+    if (finish && *in_size == 0 && frameFinished) {
+        return DecodeResult_END;
+    }
+
+    ZSTD_inBuffer input = {*in, *in_size, 0};
+    ZSTD_outBuffer output = {*out, *out_size, 0};
+
+    const size_t ret = ZSTD_decompressStream(strm, &output, &input);
+
+    *in += input.pos;
+    *in_size -= input.pos;
+    *out += output.pos;
+    *out_size -= output.pos;
+
+    if (ZSTD_isError(ret)) {
+        if (ZSTD_getErrorCode(ret) == ZSTD_error_memory_allocation) {
+            return DecodeResult_MEMORY_ERROR;
+        } else if (ZSTD_getErrorCode(ret) == ZSTD_error_frameParameter_windowTooLarge) {
+            return DecodeResult_UNSUPPORTED;
+        } else {
+            return DecodeResult_CORRUPTED;
+        }
+    }
+
+    // NOTE: 0 means that a frame was finished and fully
+    // flushed, another frame may follow
+    if (ret == 0) {
+        frameFinished = true;
+    } else if (input.pos > 0) {
+        frameFinished = false;
+    }
+
+    // NOTE: input ended in the middle of a frame
+    const bool stuck = (finish && *in_size == 0 && !frameFinished && output.pos == 0);
+    if (stuck) {
+        return DecodeResult_CORRUPTED;
+    }
+
+    return DecodeResult_OK;
+}
+
+Bzip2Decoder::Bzip2Decoder() {
+    strm = bz_stream();
+    initialized = false;
+    streamFinished = false;
+}
+
+Bzip2Decoder::~Bzip2Decoder() {
+    if (initialized) {
+        BZ2_bzDecompressEnd(&strm);
+    }
+}
+
+bool Bzip2Decoder::init() {
+    const int ret = BZ2_bzDecompressInit(&strm, 0, 0);
+    initialized = (ret == BZ_OK);
+
+    return initialized;
+}
+
+DecodeResult Bzip2Decoder::decode(const uint8_t **in, size_t *in_size, uint8_t **out, size_t *out_size, const bool finish) {
+    if (finish && *in_size == 0 && streamFinished) {
+        return DecodeResult_END;
+    }
+
+    // NOTE: bzip2 sizes are 32-bit
+    const unsigned int in_chunk = (unsigned int) qMin(*in_size, (size_t) UINT32_MAX);
+    const unsigned int out_chunk = (unsigned int) qMin(*out_size, (size_t) UINT32_MAX);
+
+    strm.next_in = (char *) *in;
+    strm.avail_in = in_chunk;
+    strm.next_out = (char *) *out;
+    strm.avail_out = out_chunk;
+
+    const int ret = BZ2_bzDecompress(&strm);
+
+    const size_t consumed = in_chunk - strm.avail_in;
+    const size_t produced = out_chunk - strm.avail_out;
+    *in += consumed;
+    *in_size -= consumed;
+    *out += produced;
+    *out_size -= produced;
+
+    if (consumed > 0) {
+        streamFinished = false;
+    }
+
+    switch (ret) {
+        case BZ_OK: {
+            // NOTE: bzip2 doesn't report truncated input,
+            // it just stops making progress
+            const bool stuck = (finish && *in_size == 0 && produced == 0);
+
+            if (stuck) {
+                return DecodeResult_CORRUPTED;
+            } else {
+                return DecodeResult_OK;
+            }
+        }
+        case BZ_STREAM_END: {
+            // NOTE: another stream may follow, bzip2 can't
+            // be reset so start a new decompressor
+            BZ2_bzDecompressEnd(&strm);
+            strm = bz_stream();
+            initialized = (BZ2_bzDecompressInit(&strm, 0, 0) == BZ_OK);
+            streamFinished = true;
+
+            if (initialized) {
+                return DecodeResult_OK;
+            } else {
+                return DecodeResult_MEMORY_ERROR;
+            }
+        }
+        case BZ_MEM_ERROR: return DecodeResult_MEMORY_ERROR;
+        case BZ_DATA_ERROR:
+        case BZ_DATA_ERROR_MAGIC: return DecodeResult_CORRUPTED;
+        default: return DecodeResult_ERROR;
+    }
+}
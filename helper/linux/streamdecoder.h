@@ -0,0 +1,62 @@
+/*
+ * ALT Media Writer
+ * Copyright (C) 2016-2019 Martin Bříza <mbriza@redhat.com>
+ * Copyright (C) 2020-2022 Dmitry Degtyarev <kevl@basealt.ru>
+ *
+ * ALT Media Writer is a fork of Fedora Media Writer
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef STREAMDECODER_H
+#define STREAMDECODER_H
+
+#include "imageformat/imageformat.h"
+
+#include <cstddef>
+#include <cstdint>
+
+#ifndef MEDIAWRITER_LZMA_LIMIT
+// 256MB memory limit for the decompressor
+#define MEDIAWRITER_LZMA_LIMIT (1024 * 1024 * 256)
+#endif
+
+enum DecodeResult {
+    DecodeResult_OK,
+    DecodeResult_END,
+    DecodeResult_MEMORY_ERROR,
+    DecodeResult_CORRUPTED,
+    DecodeResult_UNSUPPORTED,
+    DecodeResult_ERROR,
+};
+
+// Decompresses an image while it's being written. Works
+// like the streaming APIs of compression libraries:
+// decode() consumes input and produces output, advancing
+// the pointers and decreasing the sizes. "finish" is set
+// once there is no more input.
+class StreamDecoder {
+public:
+    virtual ~StreamDecoder();
+
+    virtual bool init() = 0;
+    virtual DecodeResult decode(const uint8_t **in, size_t *in_size, uint8_t **out, size_t *out_size, const bool finish) = 0;
+};
+
+// Returns decoder for the format, nullptr if format
+// isn't compressed
+StreamDecoder *stream_decoder_create(const ImageFormat format);
+
+#endif // STREAMDECODER_H
@@ -0,0 +1,263 @@
+/*
+ * ALT Media Writer
+ * Copyright (C) 2016-2019 Martin Bříza <mbriza@redhat.com>
+ * Copyright (C) 2020-2022 Dmitry Degtyarev <kevl@basealt.ru>
+ *
+ * ALT Media Writer is a fork of Fedora Media Writer
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "surfacetestjob.h"
+#include "pagealignedbuffer.h"
+#include "udisksunmount.h"
+
+#include <QCoreApplication>
+#include <QDBusInterface>
+#include <QDBusUnixFileDescriptor>
+#include <QElapsedTimer>
+#include <QTextStream>
+#include <QTimer>
+#include <QtDBus>
+
+#include <fcntl.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <future>
+#include <random>
+
+typedef QHash<QString, QVariant> Properties;
+Q_DECLARE_METATYPE(Properties)
+
+// NOTE: chunks have to be large to get full speed out of
+// O_DIRECT I/O
+const size_t SURFACE_CHUNK_PAGES = 1024;
+const size_t SURFACE_SECTOR_SIZE = 4096;
+const uint64_t SURFACE_SPEED_INTERVAL = 256 * 1024 * 1024;
+
+void surface_pattern_fill(const uint64_t seed, const uint64_t offset, void *buffer, const size_t size);
+
+SurfaceTestJob::SurfaceTestJob(const QString &where, const QString &seed_arg)
+: QObject(nullptr)
+, where(where) {
+    qDBusRegisterMetaType<Properties>();
+
+    deviceSize = 0;
+
+    // NOTE: seed can be passed to repeat a test
+    bool seed_ok = false;
+    seed = seed_arg.toULongLong(&seed_ok);
+    if (!seed_ok) {
+        seed = std::mt19937_64((std::random_device()) ())();
+    }
+
+    QTimer::singleShot(0, this, SLOT(work()));
+}
+
+void SurfaceTestJob::work() {
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+
+    udisks_unmount_drive(where);
+
+    QDBusInterface device("org.freedesktop.UDisks2", where, "org.freedesktop.UDisks2.Block", QDBusConnection::systemBus(), this);
+    QDBusReply<QDBusUnixFileDescriptor> reply = device.callWithArgumentList(QDBus::Block, "OpenDevice", {"rw", Properties{{"flags", O_DIRECT | O_CLOEXEC}, {"writable", true}}});
+    const QDBusUnixFileDescriptor fd = reply.value();
+    if (!fd.isValid()) {
+        err << reply.error().message();
+        err.flush();
+        qApp->exit(2);
+        return;
+    }
+
+    const bool size_success = (ioctl(fd.fileDescriptor(), BLKGETSIZE64, &deviceSize) == 0);
+    if (!size_success) {
+        err << tr("Failed to get device size");
+        err.flush();
+        qApp->exit(3);
+        return;
+    }
+
+    out << "SEED " << seed << "\n";
+    out.flush();
+
+    writePattern(fd.fileDescriptor());
+    verifyPattern(fd.fileDescriptor());
+
+    for (const QPair<uint64_t, uint64_t> &range : badRanges) {
+        out << "BADRANGE " << range.first << " " << range.second << "\n";
+    }
+    out << "DONE\n";
+    out.flush();
+
+    if (!badRanges.isEmpty()) {
+        err << tr("Your drive is probably damaged.");
+        err.flush();
+        qApp->exit(1);
+        return;
+    }
+
+    qApp->exit(0);
+}
+
+// Writes the pattern over the whole device. Next chunk
+// is generated while the current one is being written.
+void SurfaceTestJob::writePattern(int fd) {
+    QTextStream out(stdout);
+
+    out << "WRITE\n";
+    out.flush();
+
+    const PageAlignedBuffer first_buffer(SURFACE_CHUNK_PAGES);
+    const PageAlignedBuffer second_buffer(SURFACE_CHUNK_PAGES);
+    void *const buffers[2] = {first_buffer.buffer, second_buffer.buffer};
+    const uint64_t chunk_size = first_buffer.size;
+
+    QElapsedTimer timer;
+    timer.start();
+    uint64_t interval_start = 0;
+
+    surface_pattern_fill(seed, 0, buffers[0], qMin(chunk_size, deviceSize));
+
+    for (uint64_t offset = 0, i = 0; offset < deviceSize; offset += chunk_size, i++) {
+        const size_t len = qMin(chunk_size, deviceSize - offset);
+        const uint64_t next_offset = offset + len;
+
+        std::future<void> next_fill;
+        if (next_offset < deviceSize) {
+            void *next_buffer = buffers[(i + 1) % 2];
+            const size_t next_len = qMin(chunk_size, deviceSize - next_offset);
+            next_fill = std::async(std::launch::async, surface_pattern_fill, seed, next_offset, next_buffer, next_len);
+        }
+
+        const ssize_t written = pwrite(fd, buffers[i % 2], len, offset);
+        if (written != (ssize_t) len) {
+            addBadRange(offset, offset + len);
+        }
+
+        if (next_fill.valid()) {
+            next_fill.get();
+        }
+
+        out << next_offset << "\n";
+        if (next_offset - interval_start >= SURFACE_SPEED_INTERVAL || next_offset == deviceSize) {
+            out << "SPEED " << next_offset << " " << (qint64) ((next_offset - interval_start) * 1e9 / qMax(timer.nsecsElapsed(), (qint64) 1)) << "\n";
+            interval_start = next_offset;
+            timer.restart();
+        }
+        out.flush();
+    }
+
+    fdatasync(fd);
+}
+
+// Reads the device back and compares it to the pattern.
+// Next chunk is read while the current one is checked.
+void SurfaceTestJob::verifyPattern(int fd) {
+    QTextStream out(stdout);
+
+    out << "CHECK\n";
+    out.flush();
+
+    const PageAlignedBuffer first_buffer(SURFACE_CHUNK_PAGES);
+    const PageAlignedBuffer second_buffer(SURFACE_CHUNK_PAGES);
+    const PageAlignedBuffer expected(SURFACE_CHUNK_PAGES);
+    void *const buffers[2] = {first_buffer.buffer, second_buffer.buffer};
+    const uint64_t chunk_size = first_buffer.size;
+
+    QElapsedTimer timer;
+    timer.start();
+    uint64_t interval_start = 0;
+
+    const auto read_chunk = [fd](void *buffer, const size_t len, const uint64_t offset) {
+        return pread(fd, buffer, len, offset) == (ssize_t) len;
+    };
+
+    std::future<bool> current_read = std::async(std::launch::deferred, read_chunk, buffers[0], qMin(chunk_size, deviceSize), 0);
+
+    for (uint64_t offset = 0, i = 0; offset < deviceSize; offset += chunk_size, i++) {
+        const size_t len = qMin(chunk_size, deviceSize - offset);
+        const uint64_t next_offset = offset + len;
+
+        const bool read_success = current_read.get();
+
+        if (next_offset < deviceSize) {
+            void *next_buffer = buffers[(i + 1) % 2];
+            const size_t next_len = qMin(chunk_size, deviceSize - next_offset);
+            current_read = std::async(std::launch::async, read_chunk, next_buffer, next_len, next_offset);
+        }
+
+        if (read_success) {
+            const uint8_t *actual = (const uint8_t *) buffers[i % 2];
+            const uint8_t *pattern = (const uint8_t *) expected.buffer;
+            surface_pattern_fill(seed, offset, expected.buffer, len);
+
+            // NOTE: memcmp() is vectorized, so compare
+            // the whole chunk first and only look for
+            // bad sectors if it doesn't match
+            if (memcmp(actual, pattern, len) != 0) {
+                for (size_t sector = 0; sector < len; sector += SURFACE_SECTOR_SIZE) {
+                    const size_t sector_len = qMin(SURFACE_SECTOR_SIZE, len - sector);
+
+                    if (memcmp(actual + sector, pattern + sector, sector_len) != 0) {
+                        addBadRange(offset + sector, offset + sector + sector_len);
+                    }
+                }
+            }
+        } else {
+            addBadRange(offset, offset + len);
+        }
+
+        out << next_offset << "\n";
+        if (next_offset - interval_start >= SURFACE_SPEED_INTERVAL || next_offset == deviceSize) {
+            out << "SPEED " << next_offset << " " << (qint64) ((next_offset - interval_start) * 1e9 / qMax(timer.nsecsElapsed(), (qint64) 1)) << "\n";
+            interval_start = next_offset;
+            timer.restart();
+        }
+        out.flush();
+    }
+}
+
+// Adds a range, merging it with the previous one if they
+// are adjacent
+void SurfaceTestJob::addBadRange(const uint64_t start, const uint64_t end) {
+    if (!badRanges.isEmpty() && badRanges.last().second == start) {
+        badRanges.last().second = end;
+    } else {
+        badRanges.append({start, end});
+    }
+}
+
+// Fills the buffer with the pattern for this offset of
+// the device. Every 8 bytes of the pattern only depend on
+// their offset, so any part of it can be regenerated for
+// checking.
+void surface_pattern_fill(const uint64_t seed, const uint64_t offset, void *buffer, const size_t size) {
+    uint8_t *data = (uint8_t *) buffer;
+
+    for (size_t i = 0; i < size; i += sizeof(uint64_t)) {
+        // NOTE: this is splitmix64 applied to the
+        // position of the word
+        uint64_t value = seed + ((offset + i) / sizeof(uint64_t)) * 0x9E3779B97F4A7C15ULL;
+        value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        value = (value ^ (value >> 27)) * 0x94D049BB133111EBULL;
+        value = value ^ (value >> 31);
+
+        memcpy(data + i, &value, qMin(sizeof(value), size - i));
+    }
+}
@@ -0,0 +1,55 @@
+/*
+ * ALT Media Writer
+ * Copyright (C) 2016-2019 Martin Bříza <mbriza@redhat.com>
+ * Copyright (C) 2020-2022 Dmitry Degtyarev <kevl@basealt.ru>
+ *
+ * ALT Media Writer is a fork of Fedora Media Writer
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef SURFACETESTJOB_H
+#define SURFACETESTJOB_H
+
+#include <QList>
+#include <QObject>
+#include <QPair>
+
+#include <cstdint>
+
+// Writes a pattern derived from a seed over the whole
+// device, then reads it back and reports ranges that
+// didn't match. Destroys all data on the device.
+class SurfaceTestJob : public QObject {
+    Q_OBJECT
+public:
+    explicit SurfaceTestJob(const QString &where, const QString &seed_arg);
+public slots:
+    void work();
+
+private:
+    QString where;
+    uint64_t seed;
+    uint64_t deviceSize;
+
+    // Ranges of bytes as [start, end)
+    QList<QPair<uint64_t, uint64_t>> badRanges;
+
+    void writePattern(int fd);
+    void verifyPattern(int fd);
+    void addBadRange(const uint64_t start, const uint64_t end);
+};
+
+#endif // SURFACETESTJOB_H
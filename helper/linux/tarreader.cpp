@@ -0,0 +1,373 @@
+/*
+ * ALT Media Writer
+ * Copyright (C) 2016-2019 Martin Bříza <mbriza@redhat.com>
+ * Copyright (C) 2020-2022 Dmitry Degtyarev <kevl@basealt.ru>
+ *
+ * ALT Media Writer is a fork of Fedora Media Writer
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "tarreader.h"
+
+#include <QCoreApplication>
+
+#include <cstring>
+
+const int TAR_BLOCK_SIZE = 512;
+
+// NOTE: long names and pax records are read into memory,
+// anything bigger than this is not a real archive
+const qint64 TAR_RECORD_MAX_SIZE = 1024 * 1024;
+
+bool tar_parse_number(const char *field, const int size, qint64 *out);
+QByteArray tar_parse_string(const char *field, const int size);
+
+TarReader::TarReader(const TarReadFunction &read_function)
+: readFunction(read_function) {
+    dataLeft = 0;
+    paddingLeft = 0;
+    error = false;
+}
+
+bool TarReader::next(TarEntry *entry) {
+    if (error) {
+        return false;
+    }
+
+    const bool skip_success = skip(dataLeft + paddingLeft);
+    if (!skip_success) {
+        return false;
+    }
+    dataLeft = 0;
+    paddingLeft = 0;
+
+    // NOTE: these come from extension entries that
+    // precede the entry they apply to
+    QByteArray long_path;
+    QByteArray long_link;
+    qint64 pax_size = -1;
+
+    while (true) {
+        char header[TAR_BLOCK_SIZE];
+        const qint64 header_read = readFull(header, TAR_BLOCK_SIZE);
+        if (header_read == 0) {
+            // NOTE: archive ended without the terminating
+            // zero blocks, which tar accepts too
+            return false;
+        } else if (header_read != TAR_BLOCK_SIZE) {
+            setError(QCoreApplication::translate("ExtractJob", "The archive is truncated."));
+            return false;
+        }
+
+        const bool end_of_archive = [&]() {
+            for (int i = 0; i < TAR_BLOCK_SIZE; i++) {
+                if (header[i] != 0) {
+                    return false;
+                }
+            }
+
+            return true;
+        }();
+        if (end_of_archive) {
+            return false;
+        }
+
+        // NOTE: checksum is the sum of all header bytes,
+        // with the checksum field itself counted as spaces
+        const bool checksum_valid = [&]() {
+            qint64 expected;
+            if (!tar_parse_number(header + 148, 8, &expected)) {
+                return false;
+            }
+
+            qint64 sum = 0;
+            for (int i = 0; i < TAR_BLOCK_SIZE; i++) {
+                if (i >= 148 && i < 156) {
+                    sum += ' ';
+                } else {
+                    sum += (unsigned char) header[i];
+                }
+            }
+
+            return (sum == expected);
+        }();
+        if (!checksum_valid) {
+            setError(QCoreApplication::translate("ExtractJob", "The archive is corrupted."));
+            return false;
+        }
+
+        qint64 size;
+        if (!tar_parse_number(header + 124, 12, &size) || size < 0) {
+            setError(QCoreApplication::translate("ExtractJob", "The archive is corrupted."));
+            return false;
+        }
+
+        const char type = header[156];
+
+        if (type == 'L' || type == 'K' || type == 'x') {
+            QByteArray record;
+            if (!readRecord(size, &record)) {
+                return false;
+            }
+
+            if (type == 'L') {
+                long_path = tar_parse_string(record.constData(), record.size());
+            } else if (type == 'K') {
+                long_link = tar_parse_string(record.constData(), record.size());
+            } else {
+                // NOTE: pax records look like
+                // "<length> <key>=<value>\n"
+                int pos = 0;
+                while (pos < record.size()) {
+                    const int space = record.indexOf(' ', pos);
+                    if (space < 0) {
+                        break;
+                    }
+                    const int length = record.mid(pos, space - pos).toInt();
+                    if (length <= 0 || pos + length > record.size()) {
+                        break;
+                    }
+                    const QByteArray key_value = record.mid(space + 1, pos + length - space - 2);
+                    pos += length;
+
+                    const int equals = key_value.indexOf('=');
+                    if (equals < 0) {
+                        continue;
+                    }
+                    const QByteArray key = key_value.left(equals);
+                    const QByteArray value = key_value.mid(equals + 1);
+
+                    if (key == "path") {
+                        long_path = value;
+                    } else if (key == "linkpath") {
+                        long_link = value;
+                    } else if (key == "size") {
+                        pax_size = value.toLongLong();
+                    }
+                }
+            }
+
+            continue;
+        }
+
+        if (pax_size >= 0) {
+            size = pax_size;
+        }
+
+        const qint64 padded_size = (size + TAR_BLOCK_SIZE - 1) / TAR_BLOCK_SIZE * TAR_BLOCK_SIZE;
+
+        // NOTE: global pax headers and other extensions
+        // are skipped
+        if (type == 'g') {
+            if (!skip(padded_size)) {
+                return false;
+            }
+
+            continue;
+        }
+
+        entry->path = [&]() {
+            if (!long_path.isEmpty()) {
+                return long_path;
+            }
+
+            const QByteArray name = tar_parse_string(header, 100);
+
+            // NOTE: only POSIX ustar has the prefix field,
+            // GNU tar stores other data there
+            const bool posix_ustar = (memcmp(header + 257, "ustar\0", 6) == 0);
+            const QByteArray prefix = tar_parse_string(header + 345, 155);
+            if (posix_ustar && !prefix.isEmpty()) {
+                return prefix + "/" + name;
+            } else {
+                return name;
+            }
+        }();
+
+        entry->linkTarget = [&]() {
+            if (!long_link.isEmpty()) {
+                return long_link;
+            } else {
+                return tar_parse_string(header + 157, 100);
+            }
+        }();
+
+        entry->type = [&]() {
+            switch (type) {
+                case '0':
+                case '\0':
+                case '7': return TarEntryType_FILE;
+                case '5': return TarEntryType_DIRECTORY;
+                case '2': return TarEntryType_SYMLINK;
+                case '1': return TarEntryType_HARDLINK;
+                default: return TarEntryType_OTHER;
+            }
+        }();
+
+        // NOTE: old archives mark directories only with a
+        // trailing slash
+        if (entry->type == TarEntryType_FILE && entry->path.endsWith('/')) {
+            entry->type = TarEntryType_DIRECTORY;
+        }
+
+        // NOTE: hard links have a size in some archives,
+        // but no data
+        const bool has_data = (entry->type == TarEntryType_FILE || entry->type == TarEntryType_OTHER);
+        if (has_data) {
+            entry->size = size;
+            dataLeft = size;
+            paddingLeft = padded_size - size;
+        } else {
+            entry->size = 0;
+        }
+
+        return true;
+    }
+}
+
+qint64 TarReader::readData(char *buffer, const qint64 size) {
+    if (error) {
+        return -1;
+    }
+
+    const qint64 len = qMin(size, dataLeft);
+    if (len == 0) {
+        return 0;
+    }
+
+    const qint64 read_size = readFull(buffer, len);
+    if (read_size != len) {
+        setError(QCoreApplication::translate("ExtractJob", "The archive is truncated."));
+        return -1;
+    }
+    dataLeft -= len;
+
+    return len;
+}
+
+bool TarReader::failed() const {
+    return error;
+}
+
+QString TarReader::errorString() const {
+    return errorMessage;
+}
+
+// Reads until buffer is full or stream ends
+qint64 TarReader::readFull(char *buffer, const qint64 size) {
+    qint64 total = 0;
+
+    while (total < size) {
+        const qint64 read_size = readFunction(buffer + total, size - total);
+        if (read_size < 0) {
+            setError(QCoreApplication::translate("ExtractJob", "Failed to read the archive."));
+            return -1;
+        } else if (read_size == 0) {
+            break;
+        }
+
+        total += read_size;
+    }
+
+    return total;
+}
+
+bool TarReader::skip(qint64 size) {
+    char buffer[16 * TAR_BLOCK_SIZE];
+
+    while (size > 0) {
+        const qint64 len = qMin(size, (qint64) sizeof(buffer));
+        const qint64 read_size = readFull(buffer, len);
+        if (read_size != len) {
+            setError(QCoreApplication::translate("ExtractJob", "The archive is truncated."));
+            return false;
+        }
+
+        size -= len;
+    }
+
+    return true;
+}
+
+// Reads data of an extension entry together with padding
+bool TarReader::readRecord(const qint64 size, QByteArray *out) {
+    if (size > TAR_RECORD_MAX_SIZE) {
+        setError(QCoreApplication::translate("ExtractJob", "The archive is corrupted."));
+        return false;
+    }
+
+    out->resize(size);
+    const qint64 read_size = readFull(out->data(), size);
+    if (read_size != size) {
+        setError(QCoreApplication::translate("ExtractJob", "The archive is truncated."));
+        return false;
+    }
+
+    const qint64 padded_size = (size + TAR_BLOCK_SIZE - 1) / TAR_BLOCK_SIZE * TAR_BLOCK_SIZE;
+
+    return skip(padded_size - size);
+}
+
+void TarReader::setError(const QString &message) {
+    // NOTE: keep the first error, later ones are caused
+    // by it
+    if (!error) {
+        error = true;
+        errorMessage = message;
+    }
+}
+
+// Numbers are octal text, or big-endian binary if the top
+// bit of the first byte is set, for values that don't fit
+bool tar_parse_number(const char *field, const int size, qint64 *out) {
+    if ((unsigned char) field[0] & 0x80) {
+        qint64 value = (unsigned char) field[0] & 0x7f;
+        for (int i = 1; i < size; i++) {
+            value = (value << 8) | (unsigned char) field[i];
+        }
+        *out = value;
+
+        return true;
+    }
+
+    qint64 value = 0;
+    int i = 0;
+
+    while (i < size && field[i] == ' ') {
+        i++;
+    }
+
+    bool any_digits = false;
+    while (i < size && field[i] >= '0' && field[i] <= '7') {
+        value = value * 8 + (field[i] - '0');
+        any_digits = true;
+        i++;
+    }
+
+    // NOTE: number is terminated by a space or zero,
+    // empty fields mean 0
+    const bool valid_end = (i == size || field[i] == ' ' || field[i] == '\0');
+    *out = value;
+
+    return (valid_end && (any_digits || i == size || field[i] == '\0'));
+}
+
+// Fields are zero-terminated unless they are full
+QByteArray tar_parse_string(const char *field, const int size) {
+    const int length = strnlen(field, size);
+
+    return QByteArray(field, length);
+}
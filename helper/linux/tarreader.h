@@ -0,0 +1,85 @@
+/*
+ * ALT Media Writer
+ * Copyright (C) 2016-2019 Martin Bříza <mbriza@redhat.com>
+ * Copyright (C) 2020-2022 Dmitry Degtyarev <kevl@basealt.ru>
+ *
+ * ALT Media Writer is a fork of Fedora Media Writer
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef TARREADER_H
+#define TARREADER_H
+
+#include <QByteArray>
+#include <QString>
+
+#include <functional>
+
+// Reads entries of a tar archive from a stream. Supports
+// ustar headers, GNU long names and pax path, linkpath
+// and size records, which covers archives made by GNU tar
+// and bsdtar.
+
+// Fills buffer from the stream, returns number of bytes
+// read, 0 at the end and -1 on error
+typedef std::function<qint64(char *buffer, const qint64 size)> TarReadFunction;
+
+enum TarEntryType {
+    TarEntryType_FILE,
+    TarEntryType_DIRECTORY,
+    TarEntryType_SYMLINK,
+    TarEntryType_HARDLINK,
+    TarEntryType_OTHER,
+};
+
+struct TarEntry {
+    // NOTE: paths are raw bytes from the archive
+    QByteArray path;
+    QByteArray linkTarget;
+    TarEntryType type;
+    qint64 size;
+};
+
+class TarReader {
+public:
+    TarReader(const TarReadFunction &read_function);
+
+    // Moves to the next entry, skipping data of the
+    // current one. Returns false at the end of the
+    // archive or on error.
+    bool next(TarEntry *entry);
+
+    // Reads data of the current entry, returns 0 at the
+    // end of it and -1 on error
+    qint64 readData(char *buffer, const qint64 size);
+
+    bool failed() const;
+    QString errorString() const;
+
+private:
+    TarReadFunction readFunction;
+    qint64 dataLeft;
+    qint64 paddingLeft;
+    bool error;
+    QString errorMessage;
+
+    qint64 readFull(char *buffer, const qint64 size);
+    bool skip(qint64 size);
+    bool readRecord(const qint64 size, QByteArray *out);
+    void setError(const QString &message);
+};
+
+#endif // TARREADER_H
@@ -0,0 +1,189 @@
+/*
+ * ALT Media Writer
+ * Copyright (C) 2016-2019 Martin Bříza <mbriza@redhat.com>
+ * Copyright (C) 2020-2022 Dmitry Degtyarev <kevl@basealt.ru>
+ *
+ * ALT Media Writer is a fork of Fedora Media Writer
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "udisksunmount.h"
+
+#include <QDBusArgument>
+#include <QDBusConnection>
+#include <QDBusMessage>
+#include <QDBusObjectPath>
+#include <QDBusPendingCall>
+#include <QDBusReply>
+#include <QDBusVariant>
+#include <QList>
+#include <QtDBus>
+
+typedef QHash<QString, QVariant> Properties;
+typedef QHash<QString, Properties> InterfacesAndProperties;
+typedef QHash<QDBusObjectPath, InterfacesAndProperties> DBusIntrospection;
+Q_DECLARE_METATYPE(Properties)
+Q_DECLARE_METATYPE(InterfacesAndProperties)
+Q_DECLARE_METATYPE(DBusIntrospection)
+
+// NOTE: forced unmount can take a while if there's a lot
+// of dirty data to flush
+const int UNMOUNT_TIMEOUT_MILLIS = 30000;
+
+QDBusMessage udisks_get_property(const QString &path, const QString &interface, const QString &property);
+QList<QString> get_filesystem_paths(const QString &block_path);
+QList<QString> get_filesystem_paths_slow(const QString &block_path);
+
+void udisks_unmount_drive(const QString &block_path) {
+    const QList<QString> paths = get_filesystem_paths(block_path);
+
+    // NOTE: messages are created manually instead of
+    // using QDBusInterface because QDBusInterface does a
+    // blocking introspection call on construction
+    QList<QDBusPendingCall> calls;
+    for (const QString &path : paths) {
+        QDBusMessage message = QDBusMessage::createMethodCall("org.freedesktop.UDisks2", path, "org.freedesktop.UDisks2.Filesystem", "Unmount");
+        message << QVariantMap{{"force", true}};
+
+        const QDBusPendingCall call = QDBusConnection::systemBus().asyncCall(message, UNMOUNT_TIMEOUT_MILLIS);
+        calls.append(call);
+    }
+
+    for (QDBusPendingCall &call : calls) {
+        call.waitForFinished();
+    }
+}
+
+QString udisks_drive_id(const QString &block_path) {
+    const QDBusMessage drive_reply = udisks_get_property(block_path, "org.freedesktop.UDisks2.Block", "Drive");
+    if (drive_reply.type() != QDBusMessage::ReplyMessage || drive_reply.arguments().isEmpty()) {
+        return QString();
+    }
+    const QString drive_path = qvariant_cast<QDBusObjectPath>(qvariant_cast<QDBusVariant>(drive_reply.arguments().first()).variant()).path();
+    if (drive_path.isEmpty() || drive_path == "/") {
+        return QString();
+    }
+
+    auto get_drive_string = [drive_path](const QString &property) {
+        const QDBusMessage reply = udisks_get_property(drive_path, "org.freedesktop.UDisks2.Drive", property);
+        if (reply.type() != QDBusMessage::ReplyMessage || reply.arguments().isEmpty()) {
+            return QString();
+        }
+
+        return qvariant_cast<QDBusVariant>(reply.arguments().first()).variant().toString();
+    };
+
+    const QString serial = get_drive_string("Serial");
+    const QString wwn = get_drive_string("WWN");
+
+    if (serial.isEmpty() && wwn.isEmpty()) {
+        return drive_path;
+    } else {
+        return serial + "/" + wwn;
+    }
+}
+
+bool udisks_format_drive(const QString &block_path, QString *error) {
+    QDBusInterface device("org.freedesktop.UDisks2", block_path, "org.freedesktop.UDisks2.Block", QDBusConnection::systemBus());
+    QDBusReply<void> format_reply = device.call("Format", "dos", QVariantMap());
+    if (!format_reply.isValid() && format_reply.error().type() != QDBusError::NoReply) {
+        *error = format_reply.error().message();
+        return false;
+    }
+
+    QDBusInterface partition_table("org.freedesktop.UDisks2", block_path, "org.freedesktop.UDisks2.PartitionTable", QDBusConnection::systemBus());
+    QDBusReply<QDBusObjectPath> partition_reply = partition_table.call("CreatePartition", 1ULL, 0ULL, "", "", QVariantMap());
+    if (!partition_reply.isValid()) {
+        *error = partition_reply.error().message();
+        return false;
+    }
+
+    QDBusInterface partition("org.freedesktop.UDisks2", partition_reply.value().path(), "org.freedesktop.UDisks2.Block", QDBusConnection::systemBus());
+    QDBusReply<void> format_partition_reply = partition.call("Format", "vfat", QVariantMap{{"update-partition-type", true}});
+    if (!format_partition_reply.isValid() && format_partition_reply.error().type() != QDBusError::NoReply) {
+        *error = format_partition_reply.error().message();
+        return false;
+    }
+
+    return true;
+}
+
+QDBusMessage udisks_get_property(const QString &path, const QString &interface, const QString &property) {
+    QDBusMessage message = QDBusMessage::createMethodCall("org.freedesktop.UDisks2", path, "org.freedesktop.DBus.Properties", "Get");
+    message << interface << property;
+
+    return QDBusConnection::systemBus().call(message);
+}
+
+// Returns the block device and all of its partitions
+QList<QString> get_filesystem_paths(const QString &block_path) {
+    const QDBusMessage reply = udisks_get_property(block_path, "org.freedesktop.UDisks2.PartitionTable", "Partitions");
+
+    // NOTE: "Partitions" property is missing if there's
+    // no partition table or if UDisks is older than
+    // 2.7.2, do a full search in that case
+    if (reply.type() != QDBusMessage::ReplyMessage || reply.arguments().isEmpty()) {
+        return get_filesystem_paths_slow(block_path);
+    }
+
+    const QVariant value = qvariant_cast<QDBusVariant>(reply.arguments().first()).variant();
+    QList<QDBusObjectPath> partitions;
+    if (value.canConvert<QDBusArgument>()) {
+        qvariant_cast<QDBusArgument>(value) >> partitions;
+    } else {
+        partitions = qvariant_cast<QList<QDBusObjectPath>>(value);
+    }
+
+    QList<QString> out = {block_path};
+    for (const QDBusObjectPath &partition : partitions) {
+        out.append(partition.path());
+    }
+
+    return out;
+}
+
+// Returns all block devices of the drive that have a
+// filesystem by going through every UDisks object
+QList<QString> get_filesystem_paths_slow(const QString &block_path) {
+    const QDBusMessage drive_reply = udisks_get_property(block_path, "org.freedesktop.UDisks2.Block", "Drive");
+    if (drive_reply.type() != QDBusMessage::ReplyMessage || drive_reply.arguments().isEmpty()) {
+        return {block_path};
+    }
+    const QString drive_path = qvariant_cast<QDBusObjectPath>(qvariant_cast<QDBusVariant>(drive_reply.arguments().first()).variant()).path();
+
+    const QDBusMessage message = QDBusMessage::createMethodCall("org.freedesktop.UDisks2", "/org/freedesktop/UDisks2", "org.freedesktop.DBus.ObjectManager", "GetManagedObjects");
+    const QDBusMessage reply = QDBusConnection::systemBus().call(message);
+    if (reply.arguments().length() != 1) {
+        return {block_path};
+    }
+
+    QDBusArgument arg = qvariant_cast<QDBusArgument>(reply.arguments().first());
+    DBusIntrospection objects;
+    arg >> objects;
+
+    QList<QString> out;
+    for (const QDBusObjectPath &i : objects.keys()) {
+        if (objects[i].contains("org.freedesktop.UDisks2.Filesystem")) {
+            const QString current_drive_path = qvariant_cast<QDBusObjectPath>(objects[i]["org.freedesktop.UDisks2.Block"]["Drive"]).path();
+
+            if (current_drive_path == drive_path) {
+                out.append(i.path());
+            }
+        }
+    }
+
+    return out;
+}
@@ -0,0 +1,47 @@
+/*
+ * ALT Media Writer
+ * Copyright (C) 2016-2019 Martin Bříza <mbriza@redhat.com>
+ * Copyright (C) 2020-2022 Dmitry Degtyarev <kevl@basealt.ru>
+ *
+ * ALT Media Writer is a fork of Fedora Media Writer
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef UDISKSUNMOUNT_H
+#define UDISKSUNMOUNT_H
+
+#include <QString>
+
+// Unmounts all filesystems on the drive that contains this
+// block device. Only the block device and its partitions
+// are queried and all unmount calls are made in parallel,
+// so this takes as long as the slowest unmount. Errors are
+// ignored, if a filesystem stays mounted, opening the
+// device for writing will report it.
+void udisks_unmount_drive(const QString &block_path);
+
+// Returns a string that identifies the drive that contains
+// this block device, made of its serial number and WWN.
+// Falls back to drive's object path if both are missing
+// and returns empty string if there's no drive.
+QString udisks_drive_id(const QString &block_path);
+
+// Creates a partition table with one FAT32 partition
+// through UDisks. This is slower than writing the layout
+// directly, but works for any drive UDisks supports.
+bool udisks_format_drive(const QString &block_path, QString *error);
+
+#endif // UDISKSUNMOUNT_H
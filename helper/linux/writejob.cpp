@@ -21,26 +21,59 @@
  */
 
 #include "writejob.h"
+#include "udisksunmount.h"
 
 #include <QCoreApplication>
 #include <QDBusInterface>
 #include <QDBusUnixFileDescriptor>
+#include <QElapsedTimer>
+#include <QFileInfo>
 #include <QProcess>
 #include <QTextStream>
+#include <QThread>
 #include <QTimer>
 #include <QtDBus>
 #include <QtGlobal>
 
 #include <errno.h>
+#include <linux/fs.h>
+#include <string.h>
 #include <sys/fcntl.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
 #include <unistd.h>
 
+#include <atomic>
+#include <chrono>
+#include <future>
 #include <tuple>
 #include <utility>
+#include <vector>
 
-#include <lzma.h>
-
+#include "imagemap.h"
 #include "isomd5/libcheckisomd5.h"
+#include "pagealignedbuffer.h"
+#include "streamdecoder.h"
+#include "xzindex.h"
+
+// NOTE: same as the size of the default page-aligned
+// buffer, which delta mode uses for reading the device
+const size_t DELTA_CHUNK_SIZE = 4 * 1024 * 1024;
+
+const qint64 WRITE_FLUSH_INTERVAL = 256 * 1024 * 1024;
+
+// NOTE: flaky connections often fail a write once and
+// then recover, so failed writes are retried a few times
+// with increasing delay before giving up
+const int WRITE_RETRY_COUNT = 3;
+const unsigned long WRITE_RETRY_DELAY_MILLIS = 1000;
+
+// Number of partitions written at the same time in sparse
+// mode, if the drive benefits from it
+const int SPARSE_WRITE_THREADS = 4;
+
+bool device_parallel_writes(const int fd);
 
 typedef QHash<QString, QVariant> Properties;
 typedef QHash<QString, Properties> InterfacesAndProperties;
@@ -49,23 +82,44 @@ Q_DECLARE_METATYPE(Properties)
 Q_DECLARE_METATYPE(InterfacesAndProperties)
 Q_DECLARE_METATYPE(DBusIntrospection)
 
-// NOTE: aligned buffers are used for reading and
-// writing to ensure optimal speed
-class PageAlignedBuffer {
-public:
-    PageAlignedBuffer(const size_t page_count = 1024);
-    ~PageAlignedBuffer();
-
-    void *unaligned_buffer;
-    void *buffer;
-    size_t size;
-};
-
-WriteJob::WriteJob(const QString &what, const QString &where, const QString &md5_arg)
+WriteJob::WriteJob(const QString &what, const QString &where, const QString &md5_arg, const QStringList &options)
 : QObject(nullptr)
 , what(what)
 , where(where)
-, md5(md5_arg) {
+, md5(md5_arg)
+, writtenHash(QCryptographicHash::Md5) {
+    deltaMode = options.contains("--delta");
+    sparseMode = options.contains("--sparse") && !deltaMode;
+    bmapMode = false;
+    bmapRange = 0;
+    bmapOffset = 0;
+    resumeMode = options.contains("--resume");
+    journalEnabled = false;
+    format = ImageFormat_UNKNOWN;
+    writeOffset = 0;
+    flushedOffset = 0;
+
+    // NOTE: flush interval of 0 means that every write
+    // is synchronous
+    flushInterval = WRITE_FLUSH_INTERVAL;
+    size_t chunk_size = 0;
+    for (const QString &option : options) {
+        if (option.startsWith("--flush-interval=")) {
+            flushInterval = option.section("=", 1).toLongLong();
+        } else if (option.startsWith("--chunk-size=")) {
+            chunk_size = option.section("=", 1).toULongLong();
+        }
+    }
+
+    // NOTE: in delta mode most chunks are skipped, so
+    // timing them doesn't measure the drive. A fixed
+    // chunk size is used by benchmarks to compare sizes.
+    if (deltaMode) {
+        tuner.fix(DELTA_CHUNK_SIZE);
+    } else if (chunk_size > 0) {
+        tuner.fix(qBound(WRITE_TUNER_MIN_CHUNK, chunk_size, WRITE_TUNER_MAX_CHUNK));
+    }
+
     qDBusRegisterMetaType<Properties>();
     qDBusRegisterMetaType<InterfacesAndProperties>();
     qDBusRegisterMetaType<DBusIntrospection>();
@@ -95,31 +149,18 @@ QDBusUnixFileDescriptor WriteJob::getDescriptor() {
     QTextStream err(stderr);
 
     QDBusInterface device("org.freedesktop.UDisks2", where, "org.freedesktop.UDisks2.Block", QDBusConnection::systemBus(), this);
-    QString drivePath = qvariant_cast<QDBusObjectPath>(device.property("Drive")).path();
-    QDBusInterface manager("org.freedesktop.UDisks2", "/org/freedesktop/UDisks2", "org.freedesktop.DBus.ObjectManager", QDBusConnection::systemBus());
-    QDBusMessage message = manager.call("GetManagedObjects");
-
-    if (message.arguments().length() == 1) {
-        QDBusArgument arg = qvariant_cast<QDBusArgument>(message.arguments().first());
-        DBusIntrospection objects;
-        arg >> objects;
-        for (const QDBusObjectPath &i : objects.keys()) {
-            if (objects[i].contains("org.freedesktop.UDisks2.Filesystem")) {
-                QString currentDrivePath = qvariant_cast<QDBusObjectPath>(objects[i]["org.freedesktop.UDisks2.Block"]["Drive"]).path();
-                if (currentDrivePath == drivePath) {
-                    QDBusInterface partition("org.freedesktop.UDisks2", i.path(), "org.freedesktop.UDisks2.Filesystem", QDBusConnection::systemBus());
-                    message = partition.call("Unmount", Properties{{"force", true}});
-                }
-            }
+
+    udisks_unmount_drive(where);
+
+    const int flags = [&]() {
+        if (flushInterval > 0) {
+            return O_DIRECT | O_CLOEXEC;
+        } else {
+            return O_DIRECT | O_SYNC | O_CLOEXEC;
         }
-    } else {
-        err << message.errorMessage();
-        err.flush();
-        qApp->exit(2);
-        return QDBusUnixFileDescriptor(-1);
-    }
+    }();
 
-    QDBusReply<QDBusUnixFileDescriptor> reply = device.callWithArgumentList(QDBus::Block, "OpenDevice", {"rw", Properties{{"flags", O_DIRECT | O_SYNC | O_CLOEXEC}, {"writable", true}}});
+    QDBusReply<QDBusUnixFileDescriptor> reply = device.callWithArgumentList(QDBus::Block, "OpenDevice", {"rw", Properties{{"flags", flags}, {"writable", true}}});
     QDBusUnixFileDescriptor fd = reply.value();
 
     if (!fd.isValid()) {
@@ -133,11 +174,359 @@ QDBusUnixFileDescriptor WriteJob::getDescriptor() {
 }
 
 bool WriteJob::write(int fd) {
-    if (what.endsWith(".xz")) {
-        return writeCompressed(fd);
+    // NOTE: format is detected from contents, so that
+    // misnamed images are written correctly. Image may
+    // not exist until now because of delayed write.
+    format = image_format_from_file(what);
+
+    // NOTE: block map is optional, images without one are
+    // written completely. In delta mode, the whole image
+    // is compared anyway.
+    bmapMode = [&]() {
+        const QString bmap_path = bmap_find(what);
+        if (deltaMode || bmap_path.isEmpty()) {
+            return false;
+        }
+
+        const bool load_success = bmap_load(bmap_path, &bmap);
+        if (!load_success) {
+            return false;
+        }
+
+        // NOTE: size of compressed images is only known
+        // at the end
+        if (!image_format_is_compressed(format) && bmap.imageSize != QFileInfo(what).size()) {
+            return false;
+        }
+
+        return true;
+    }();
+
+    if (bmapMode) {
+        bmapHash.reset(new QCryptographicHash(bmap.algorithm));
+
+        QTextStream out(stdout);
+        out << "BMAP " << bmap_find(what) << "\n";
+        out.flush();
+    }
+
+    const bool write_success = [&]() {
+        if (image_format_is_compressed(format)) {
+            return writeCompressed(fd);
+        } else if (bmapMode) {
+            return writeBmap(fd);
+        } else if (sparseMode && (format == ImageFormat_GPT || format == ImageFormat_MBR)) {
+            return writeSparse(fd);
+        } else {
+            return writePlain(fd);
+        }
+    }();
+
+    if (!write_success) {
+        return false;
+    }
+
+    // NOTE: unless flush interval is 0, device is opened
+    // without O_SYNC, so written data is only guaranteed
+    // to be on the drive after a flush. With O_SYNC the
+    // flush has nothing left to wait for. Only this device
+    // is flushed, unlike with sync(), which would wait for
+    // all devices.
+    const bool flush_success = flushWritten(fd);
+    if (!flush_success) {
+        QTextStream err(stderr);
+        err << tr("Destination drive is not writable");
+        err.flush();
+        qApp->exit(3);
+        return false;
+    }
+
+    if (journalEnabled) {
+        write_journal_remove(what);
+    }
+
+    if (deltaMode) {
+        return verifyWritten(fd);
     } else {
-        return writePlain(fd);
+        return true;
+    }
+}
+
+// Waits until everything written so far is on the drive
+bool WriteJob::flushWritten(int fd) {
+    // NOTE: EINVAL means that the destination can't be
+    // synced, like /dev/null, so there is nothing to wait for
+    if (fdatasync(fd) != 0 && errno != EINVAL) {
+        return false;
     }
+    flushedOffset = writeOffset;
+
+    QTextStream out(stdout);
+    out << "FLUSHED " << flushedOffset << "\n";
+    out.flush();
+
+    // NOTE: failing to save the journal only means that
+    // writing can't be resumed, so it's not an error
+    if (journalEnabled) {
+        journal.written = flushedOffset;
+        write_journal_save(what, journal);
+    }
+
+    return true;
+}
+
+// Starts recording write progress, returns offset up to
+// which the drive already contains the image
+qint64 WriteJob::startJournal(int fd) {
+    bool create_success;
+    journal = write_journal_create(what, where, udisks_drive_id(where), fd, &create_success);
+    journalEnabled = create_success;
+    if (!journalEnabled) {
+        return 0;
+    }
+
+    WriteJournal saved;
+    const bool can_resume = (resumeMode && write_journal_load(what, &saved) && write_journal_matches(saved, journal));
+    if (can_resume) {
+        journal.written = saved.written;
+    }
+
+    write_journal_save(what, journal);
+
+    return journal.written;
+}
+
+// Writes buffer at current write offset. In delta mode,
+// the same range is read from the device first and the
+// write is skipped if contents are already the same.
+qint64 WriteJob::writeBuffer(int fd, const void *buffer, const qint64 len) {
+    // NOTE: flushing in large batches lets the drive
+    // make full use of its write cache. Synchronous
+    // writes are still flushed sometimes, so that the
+    // journal is updated.
+    const qint64 interval = (flushInterval > 0) ? flushInterval : WRITE_FLUSH_INTERVAL;
+    if (writeOffset - flushedOffset >= interval) {
+        const bool flush_success = flushWritten(fd);
+        if (!flush_success) {
+            return -1;
+        }
+    }
+
+    if (!deltaMode) {
+        QElapsedTimer timer;
+        timer.start();
+
+        const qint64 written = pwrite(fd, buffer, len, writeOffset);
+        if (written > 0) {
+            writeOffset += written;
+
+            const bool tuning_finished = tuner.addSample(written, timer.nsecsElapsed());
+            if (tuning_finished) {
+                QTextStream out(stdout);
+                out << "CHUNKSIZE " << (qint64) tuner.chunkSize() << "\n";
+                out.flush();
+            }
+        }
+
+        return written;
+    }
+
+    // NOTE: device is opened with O_DIRECT, so read
+    // buffer has to be aligned too
+    static const PageAlignedBuffer deviceBuffer;
+    if ((size_t) len > deviceBuffer.size) {
+        return -1;
+    }
+
+    // NOTE: only data that ended up on the drive is
+    // hashed, because failed writes are retried
+    const qint64 read_size = pread(fd, deviceBuffer.buffer, len, writeOffset);
+    const bool same_contents = (read_size == len && memcmp(deviceBuffer.buffer, buffer, len) == 0);
+
+    if (same_contents) {
+        writtenHash.addData((const char *) buffer, len);
+        writeOffset += len;
+
+        return len;
+    }
+
+    const qint64 written = pwrite(fd, buffer, len, writeOffset);
+    if (written > 0) {
+        writtenHash.addData((const char *) buffer, written);
+        writeOffset += written;
+    }
+
+    return written;
+}
+
+// Writes whole buffer, retrying each failed write a few
+// times
+bool WriteJob::writeWithRetry(int fd, const void *buffer, const qint64 len) {
+    QTextStream out(stdout);
+
+    qint64 done = 0;
+    int failures = 0;
+
+    while (done < len) {
+        const qint64 written = writeBuffer(fd, (const char *) buffer + done, len - done);
+        if (written > 0) {
+            done += written;
+            failures = 0;
+
+            continue;
+        }
+
+        // NOTE: only I/O errors may go away by themselves
+        failures++;
+        const bool can_retry = (failures <= WRITE_RETRY_COUNT && (written == 0 || errno == EIO));
+        if (!can_retry) {
+            return false;
+        }
+
+        out << "RETRY " << writeOffset << "\n";
+        out.flush();
+
+        QThread::msleep(WRITE_RETRY_DELAY_MILLIS * failures);
+    }
+
+    return true;
+}
+
+// Checks that the part of the drive right before offset
+// matches the image, before trusting the journal
+bool WriteJob::verifyTail(int fd, QFile *file, const qint64 offset) {
+    const PageAlignedBuffer deviceBuffer;
+    const qint64 start = qMax((qint64) 0, offset - (qint64) deviceBuffer.size);
+    const qint64 len = offset - start;
+
+    file->seek(start);
+    const QByteArray image_data = file->read(len);
+    const qint64 read_size = pread(fd, deviceBuffer.buffer, len, start);
+
+    return (image_data.size() == len && read_size == len && memcmp(deviceBuffer.buffer, image_data.constData(), len) == 0);
+}
+
+// Decodes one block of an xz image and checks that the
+// drive contains it at its offset
+bool WriteJob::verifyXzBlock(int fd, QFile *file, const XzIndex &index, const int block_index) {
+    const XzBlock &block = index.blocks[block_index];
+
+    const std::unique_ptr<StreamDecoder> decoder(xz_index_decoder(index));
+    if (!decoder->init()) {
+        return false;
+    }
+
+    file->seek(block.compressedOffset);
+
+    // NOTE: block doesn't have to start at an aligned
+    // offset, so device is read from the aligned range
+    // around each decoded chunk
+    const qint64 page_size = getpagesize();
+    const PageAlignedBuffer inBuffer;
+    const PageAlignedBuffer outBuffer;
+    const PageAlignedBuffer deviceBuffer(outBuffer.size / page_size + 2);
+
+    const uint8_t *next_in = (const uint8_t *) inBuffer.buffer;
+    size_t avail_in = 0;
+    bool input_finished = false;
+    qint64 checked = 0;
+
+    while (checked < block.uncompressedSize) {
+        if (avail_in == 0 && !input_finished) {
+            const qint64 len = file->read((char *) inBuffer.buffer, inBuffer.size);
+            if (len < 0) {
+                return false;
+            }
+
+            next_in = (const uint8_t *) inBuffer.buffer;
+            avail_in = len;
+            input_finished = (len == 0);
+        }
+
+        uint8_t *next_out = (uint8_t *) outBuffer.buffer;
+        size_t avail_out = qMin((qint64) outBuffer.size, block.uncompressedSize - checked);
+        const size_t out_size = avail_out;
+
+        const DecodeResult result = decoder->decode(&next_in, &avail_in, &next_out, &avail_out, input_finished);
+        if (result != DecodeResult_OK) {
+            return false;
+        }
+
+        const qint64 len = out_size - avail_out;
+        if (len == 0) {
+            if (input_finished) {
+                return false;
+            }
+
+            continue;
+        }
+
+        const qint64 offset = block.uncompressedOffset + checked;
+        const qint64 aligned_start = offset / page_size * page_size;
+        const qint64 aligned_end = (offset + len + page_size - 1) / page_size * page_size;
+        const qint64 read_size = pread(fd, deviceBuffer.buffer, aligned_end - aligned_start, aligned_start);
+        const bool same_contents = (read_size == aligned_end - aligned_start && memcmp((const char *) deviceBuffer.buffer + (offset - aligned_start), outBuffer.buffer, len) == 0);
+        if (!same_contents) {
+            return false;
+        }
+
+        checked += len;
+    }
+
+    return true;
+}
+
+// Read back everything that was written in delta mode and
+// compare it to the image
+bool WriteJob::verifyWritten(int fd) {
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+
+    if (fdatasync(fd) != 0) {
+        err << tr("Destination drive is not writable");
+        err.flush();
+        qApp->exit(3);
+        return false;
+    }
+
+    out << "CHECK\n";
+    out.flush();
+
+    // NOTE: progress is reported relative to source file
+    // size because that is what the app expects
+    const qint64 file_size = QFileInfo(what).size();
+
+    const PageAlignedBuffer buffer;
+    QCryptographicHash deviceHash(QCryptographicHash::Md5);
+    qint64 offset = 0;
+
+    while (offset < writeOffset) {
+        const qint64 len = qMin((qint64) buffer.size, writeOffset - offset);
+        const qint64 read_size = pread(fd, buffer.buffer, len, offset);
+        if (read_size != len) {
+            err << tr("Your drive is probably damaged.") << "\n";
+            err.flush();
+            qApp->exit(1);
+            return false;
+        }
+
+        deviceHash.addData((const char *) buffer.buffer, len);
+        offset += len;
+
+        if (writeOffset > 0) {
+            out << (offset * file_size / writeOffset) << "\n";
+            out.flush();
+        }
+    }
+
+    if (deviceHash.result() != writtenHash.result()) {
+        err << tr("Your drive is probably damaged.") << "\n";
+        err.flush();
+        qApp->exit(1);
+        return false;
+    }
+
+    return true;
 }
 
 bool WriteJob::writeCompressed(int fd) {
@@ -146,11 +535,9 @@ bool WriteJob::writeCompressed(int fd) {
 
     qint64 totalRead = 0;
 
-    lzma_stream strm = LZMA_STREAM_INIT;
-    lzma_ret ret;
-
     const PageAlignedBuffer inBuffer;
-    const PageAlignedBuffer outBuffer;
+    const PageAlignedBuffer outBuffer(WRITE_TUNER_MAX_CHUNK / getpagesize());
+    size_t outSize = tuner.chunkSize();
 
     QFile file(what);
     const bool open_success = file.open(QIODevice::ReadOnly);
@@ -161,50 +548,90 @@ bool WriteJob::writeCompressed(int fd) {
         return false;
     }
 
-    ret = lzma_stream_decoder(&strm, MEDIAWRITER_LZMA_LIMIT, LZMA_CONCATENATED);
-    if (ret != LZMA_OK) {
+    // NOTE: xz images made by multi-threaded xz consist
+    // of many blocks, so an interrupted write can continue
+    // from the block where it stopped. O_DIRECT needs the
+    // block to start at an aligned offset.
+    XzIndex index;
+    const bool resumable = (format == ImageFormat_XZ && !deltaMode && !bmapMode && xz_index_read(&file, &index) && index.blocks.size() > 1);
+
+    // NOTE: drive contents before the resume block are
+    // only trusted if the block right before it still
+    // matches the image
+    const int resume_block = [&]() {
+        if (!resumable) {
+            return 0;
+        }
+
+        const qint64 written = startJournal(fd);
+        const int found_block = xz_index_find_block(index, written, getpagesize());
+        if (found_block > 0 && verifyXzBlock(fd, &file, index, found_block - 1)) {
+            return found_block;
+        } else {
+            return 0;
+        }
+    }();
+    file.seek(0);
+
+    const std::unique_ptr<StreamDecoder> decoder([&]() {
+        if (resume_block > 0) {
+            return xz_index_decoder(index);
+        } else {
+            return stream_decoder_create(format);
+        }
+    }());
+    if (decoder == nullptr || !decoder->init()) {
         err << tr("Failed to start decompressing.");
         return false;
     }
 
-    strm.next_in = (uint8_t *) inBuffer.buffer;
-    strm.avail_in = 0;
-    strm.next_out = (uint8_t *) outBuffer.buffer;
-    strm.avail_out = outBuffer.size;
+    if (resume_block > 0) {
+        const XzBlock &block = index.blocks[resume_block];
+
+        file.seek(block.compressedOffset);
+        totalRead = block.compressedOffset;
+        writeOffset = block.uncompressedOffset;
+        flushedOffset = writeOffset;
+
+        out << "RESUME " << writeOffset << "\n";
+        out.flush();
+    }
+
+    const uint8_t *next_in = (const uint8_t *) inBuffer.buffer;
+    size_t avail_in = 0;
+    bool input_finished = false;
+    uint8_t *next_out = (uint8_t *) outBuffer.buffer;
+    size_t avail_out = outSize;
 
     while (true) {
-        if (strm.avail_in == 0) {
+        if (avail_in == 0 && !input_finished) {
             qint64 len = file.read((char *) inBuffer.buffer, inBuffer.size);
+            if (len < 0) {
+                err << tr("Source image is not readable");
+                err.flush();
+                qApp->exit(3);
+                return false;
+            }
             totalRead += len;
 
-            strm.next_in = (uint8_t *) inBuffer.buffer;
-            strm.avail_in = len;
+            next_in = (const uint8_t *) inBuffer.buffer;
+            avail_in = len;
+            input_finished = (len == 0);
 
             out << totalRead << "\n";
             out.flush();
         }
 
-        ret = lzma_code(&strm, strm.avail_in == 0 ? LZMA_FINISH : LZMA_RUN);
-        if (ret == LZMA_STREAM_END) {
-            quint64 len = ::write(fd, outBuffer.buffer, outBuffer.size - strm.avail_out);
-            if (len != outBuffer.size - strm.avail_out) {
-                err << tr("Destination drive is not writable");
-                qApp->exit(3);
-                return false;
-            }
-            return true;
-        }
-        if (ret != LZMA_OK) {
-            switch (ret) {
-                case LZMA_MEM_ERROR:
+        const DecodeResult result = decoder->decode(&next_in, &avail_in, &next_out, &avail_out, input_finished);
+        if (result != DecodeResult_OK && result != DecodeResult_END) {
+            switch (result) {
+                case DecodeResult_MEMORY_ERROR:
                     err << tr("There is not enough memory to decompress the file.");
                     break;
-                case LZMA_FORMAT_ERROR:
-                case LZMA_DATA_ERROR:
-                case LZMA_BUF_ERROR:
+                case DecodeResult_CORRUPTED:
                     err << tr("The downloaded compressed file is corrupted.");
                     break;
-                case LZMA_OPTIONS_ERROR:
+                case DecodeResult_UNSUPPORTED:
                     err << tr("Unsupported compression options.");
                     break;
                 default:
@@ -215,15 +642,36 @@ bool WriteJob::writeCompressed(int fd) {
             return false;
         }
 
-        if (strm.avail_out == 0) {
-            quint64 len = ::write(fd, outBuffer.buffer, outBuffer.size - strm.avail_out);
-            if (len != outBuffer.size - strm.avail_out) {
-                err << tr("Destination drive is not writable");
-                qApp->exit(3);
-                return false;
+        if (result == DecodeResult_END || avail_out == 0) {
+            if (bmapMode) {
+                const bool mapped_success = writeMapped(fd, (const char *) outBuffer.buffer, outSize - avail_out);
+                if (!mapped_success) {
+                    return false;
+                }
+            } else {
+                const bool write_success = writeWithRetry(fd, outBuffer.buffer, outSize - avail_out);
+                if (!write_success) {
+                    err << tr("Destination drive is not writable");
+                    qApp->exit(3);
+                    return false;
+                }
             }
-            strm.next_out = (uint8_t *) outBuffer.buffer;
-            strm.avail_out = outBuffer.size;
+
+            if (result == DecodeResult_END) {
+                // NOTE: image ended before all mapped ranges
+                if (bmapMode && bmapRange < bmap.ranges.size()) {
+                    err << tr("The image doesn't match its block map.");
+                    err.flush();
+                    qApp->exit(4);
+                    return false;
+                }
+
+                return true;
+            }
+
+            outSize = tuner.chunkSize();
+            next_out = (uint8_t *) outBuffer.buffer;
+            avail_out = outSize;
         }
     }
 }
@@ -241,29 +689,45 @@ bool WriteJob::writePlain(int fd) {
         return false;
     }
 
-    const PageAlignedBuffer buffer;
-    qint64 total = 0;
+    // NOTE: drive contents before the journaled offset
+    // are only trusted if their last part still matches
+    // the image. Offset is aligned for O_DIRECT.
+    const qint64 resume_offset = [&]() -> qint64 {
+        if (deltaMode) {
+            return 0;
+        }
+
+        const qint64 written = startJournal(fd) / getpagesize() * getpagesize();
+        if (written > 0 && verifyTail(fd, &inFile, written)) {
+            return written;
+        } else {
+            return 0;
+        }
+    }();
+
+    inFile.seek(resume_offset);
+    writeOffset = resume_offset;
+    flushedOffset = resume_offset;
+
+    if (resume_offset > 0) {
+        out << "RESUME " << resume_offset << "\n";
+        out.flush();
+    }
+
+    const PageAlignedBuffer buffer(WRITE_TUNER_MAX_CHUNK / getpagesize());
+    qint64 total = resume_offset;
 
     while (!inFile.atEnd()) {
-        qint64 len = inFile.read((char *) buffer.buffer, buffer.size);
+        qint64 len = inFile.read((char *) buffer.buffer, tuner.chunkSize());
         if (len < 0) {
             err << tr("Source image is not readable");
             err.flush();
             qApp->exit(3);
             return false;
         }
-    try_again:
-        qint64 written = ::write(fd, buffer.buffer, len);
-        if (written != len) {
-            if (written < 0) {
-                if (errno == EIO) {
-                    static int skip_once = 0;
-                    if (!skip_once) {
-                        skip_once = 1;
-                        goto try_again;
-                    }
-                }
-            }
+
+        const bool write_success = writeWithRetry(fd, buffer.buffer, len);
+        if (!write_success) {
             err << tr("Destination drive is not writable");
             err.flush();
             qApp->exit(3);
@@ -275,7 +739,237 @@ bool WriteJob::writePlain(int fd) {
     }
 
     inFile.close();
-    sync();
+
+    return true;
+}
+
+// Writes only the ranges of the block map, without
+// reading the rest of the image
+bool WriteJob::writeBmap(int fd) {
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+
+    QFile inFile(what);
+    const bool open_success = inFile.open(QIODevice::ReadOnly);
+    if (!open_success) {
+        err << tr("Source image is not readable") << what;
+        err.flush();
+        qApp->exit(2);
+        return false;
+    }
+
+    const PageAlignedBuffer buffer(WRITE_TUNER_MAX_CHUNK / getpagesize());
+
+    for (const BmapRange &range : bmap.ranges) {
+        inFile.seek(range.start);
+        bmapOffset = range.start;
+
+        while (bmapOffset < range.end) {
+            const qint64 len = inFile.read((char *) buffer.buffer, qMin((qint64) tuner.chunkSize(), range.end - bmapOffset));
+            if (len <= 0) {
+                err << tr("Source image is not readable");
+                err.flush();
+                qApp->exit(3);
+                return false;
+            }
+
+            const bool mapped_success = writeMapped(fd, (const char *) buffer.buffer, len);
+            if (!mapped_success) {
+                return false;
+            }
+
+            out << bmapOffset << "\n";
+            out.flush();
+        }
+    }
+
+    return true;
+}
+
+// Writes the mapped parts of data that starts at
+// bmapOffset in the image. Checksum of each range is
+// checked once all of it was written.
+bool WriteJob::writeMapped(int fd, const char *data, const qint64 len) {
+    QTextStream err(stderr);
+
+    qint64 pos = 0;
+
+    while (pos < len && bmapRange < bmap.ranges.size()) {
+        const BmapRange &range = bmap.ranges[bmapRange];
+        const qint64 offset = bmapOffset + pos;
+
+        if (offset < range.start) {
+            pos += qMin(len - pos, range.start - offset);
+            continue;
+        }
+
+        const qint64 chunk = qMin(len - pos, range.end - offset);
+
+        writeOffset = offset;
+        const bool write_success = writeWithRetry(fd, data + pos, chunk);
+        if (!write_success) {
+            err << tr("Destination drive is not writable");
+            err.flush();
+            qApp->exit(3);
+            return false;
+        }
+
+        bmapHash->addData(data + pos, chunk);
+        pos += chunk;
+
+        if (offset + chunk == range.end) {
+            const QByteArray checksum = bmapHash->result().toHex();
+            bmapHash->reset();
+
+            if (!range.checksum.isEmpty() && checksum != range.checksum) {
+                err << tr("The image doesn't match its block map.");
+                err.flush();
+                qApp->exit(4);
+                return false;
+            }
+
+            bmapRange++;
+        }
+    }
+
+    bmapOffset += len;
+
+    return true;
+}
+
+// Writes only the parts of a partitioned image that
+// contain data. Partitions are written concurrently if
+// the drive benefits from it.
+bool WriteJob::writeSparse(int fd) {
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+
+    QFile inFile(what);
+    const bool open_success = inFile.open(QIODevice::ReadOnly);
+    if (!open_success) {
+        err << tr("Source image is not readable") << what;
+        err.flush();
+        qApp->exit(2);
+        return false;
+    }
+
+    ImageMap map;
+    const bool map_success = image_map_read(&inFile, getpagesize(), &map);
+    inFile.close();
+    if (!map_success) {
+        return writePlain(fd);
+    }
+
+    // NOTE: progress is reported relative to source file
+    // size because that is what the app expects
+    const qint64 file_size = QFileInfo(what).size();
+    const qint64 total = image_map_size(map);
+
+    out << "SPARSE " << total << "\n";
+    out.flush();
+
+    const int thread_count = [&]() {
+        if (device_parallel_writes(fd)) {
+            return qMin(map.size(), SPARSE_WRITE_THREADS);
+        } else {
+            return 1;
+        }
+    }();
+
+    std::atomic<qint64> written(0);
+    std::atomic<bool> readFailed(false);
+    std::atomic<bool> writeFailed(false);
+
+    // NOTE: each thread writes every n-th group, with
+    // its own buffer and image descriptor
+    const auto write_groups = [&](const int first_group) {
+        const int image_fd = open(QFile::encodeName(what).constData(), O_RDONLY | O_CLOEXEC);
+        if (image_fd < 0) {
+            readFailed = true;
+            return;
+        }
+
+        const PageAlignedBuffer buffer;
+
+        for (int group = first_group; group < map.size(); group += thread_count) {
+            for (const ImageExtent &extent : map[group]) {
+                qint64 offset = extent.offset;
+                const qint64 end = extent.offset + extent.length;
+
+                while (offset < end && !readFailed && !writeFailed) {
+                    const qint64 len = qMin((qint64) buffer.size, end - offset);
+
+                    const qint64 read_size = pread(image_fd, buffer.buffer, len, offset);
+                    if (read_size != len) {
+                        readFailed = true;
+                        break;
+                    }
+
+                    // NOTE: same retry rules as writeWithRetry(), which
+                    // can't be used here because it tracks writeOffset
+                    qint64 done = 0;
+                    int failures = 0;
+                    while (done < len) {
+                        const qint64 write_size = pwrite(fd, (const char *) buffer.buffer + done, len - done, offset + done);
+                        if (write_size > 0) {
+                            done += write_size;
+                            failures = 0;
+
+                            continue;
+                        }
+
+                        failures++;
+                        const bool can_retry = (failures <= WRITE_RETRY_COUNT && (write_size == 0 || errno == EIO));
+                        if (!can_retry) {
+                            writeFailed = true;
+                            break;
+                        }
+
+                        QThread::msleep(WRITE_RETRY_DELAY_MILLIS * failures);
+                    }
+                    if (writeFailed) {
+                        break;
+                    }
+
+                    offset += len;
+                    written += len;
+                }
+            }
+        }
+
+        close(image_fd);
+    };
+
+    std::vector<std::future<void>> threads;
+    for (int i = 0; i < thread_count; i++) {
+        threads.push_back(std::async(std::launch::async, write_groups, i));
+    }
+
+    for (std::future<void> &thread : threads) {
+        while (thread.wait_for(std::chrono::milliseconds(200)) != std::future_status::ready) {
+            out << (qint64) ((double) written * file_size / qMax(total, (qint64) 1)) << "\n";
+            out.flush();
+        }
+    }
+
+    if (readFailed) {
+        err << tr("Source image is not readable");
+        err.flush();
+        qApp->exit(3);
+        return false;
+    }
+
+    if (writeFailed) {
+        err << tr("Destination drive is not writable");
+        err.flush();
+        qApp->exit(3);
+        return false;
+    }
+
+    out << file_size << "\n";
+    out.flush();
+
+    writeOffset = file_size;
 
     return true;
 }
@@ -284,7 +978,7 @@ bool WriteJob::check(int fd) {
     QTextStream out(stdout);
     QTextStream err(stderr);
 
-    if (what.endsWith(".xz")) {
+    if (image_format_is_compressed(format)) {
         out << "NOT CHECKING BECAUSE IMAGE IS ZIPPED\n";
         out << "DONE\n";
         out.flush();
@@ -294,6 +988,17 @@ bool WriteJob::check(int fd) {
         return false;
     }
 
+    // NOTE: checksum can only be implanted into ISO9660
+    if (format != ImageFormat_ISO9660) {
+        out << "NOT CHECKING BECAUSE IMAGE IS NOT ISO9660\n";
+        out << "DONE\n";
+        out.flush();
+        err << "OK\n";
+        err.flush();
+        qApp->exit(0);
+        return false;
+    }
+
     if (md5.isEmpty()) {
         out << "NOT CHECKING BECAUSE NO MD5 IS PROVIDED\n";
         out << "DONE\n";
@@ -391,20 +1096,24 @@ void WriteJob::onFileChanged(const QString &path) {
     }
 }
 
-PageAlignedBuffer::PageAlignedBuffer(const size_t page_count) {
-    static const size_t page_size = getpagesize();
-    size = page_count * page_size;
-    const size_t unaligned_size = size + page_size;
-    unaligned_buffer = malloc(unaligned_size * sizeof(uint8_t));
+// Returns true if the device is likely to write faster
+// with several requests at once. USB drives and spinning
+// disks handle one request at a time anyway.
+bool device_parallel_writes(const int fd) {
+    struct stat info;
+    if (fstat(fd, &info) != 0 || !S_ISBLK(info.st_mode)) {
+        return false;
+    }
+
+    const QString sysfs_path = QString("/sys/dev/block/%1:%2").arg(major(info.st_rdev)).arg(minor(info.st_rdev));
 
-    // NOTE: align() modifies space and ptr args to
-    // return values for aligned buffer
-    void *ptr_arg = unaligned_buffer;
-    size_t space_arg = unaligned_size;
+    QFile rotational(sysfs_path + "/queue/rotational");
+    const bool open_success = rotational.open(QIODevice::ReadOnly);
+    if (!open_success || rotational.readAll().trimmed() != "0") {
+        return false;
+    }
 
-    buffer = std::align(page_size, size, ptr_arg, space_arg);
-}
+    const QString device_path = QFileInfo(sysfs_path).canonicalFilePath();
 
-PageAlignedBuffer::~PageAlignedBuffer() {
-    free(unaligned_buffer);
+    return !device_path.contains("/usb");
 }
@@ -23,27 +23,29 @@
 #ifndef WRITEJOB_H
 #define WRITEJOB_H
 
+#include <QCryptographicHash>
 #include <QDBusUnixFileDescriptor>
 #include <QFile>
 #include <QFileSystemWatcher>
 #include <QObject>
 #include <QProcess>
 
+#include "bmap.h"
+#include "imageformat/imageformat.h"
+#include "writejournal.h"
+#include "writetuner.h"
+#include "xzindex.h"
+
 #include <unistd.h>
 
 #include <memory>
 #include <tuple>
 #include <utility>
 
-#ifndef MEDIAWRITER_LZMA_LIMIT
-// 256MB memory limit for the decompressor
-#define MEDIAWRITER_LZMA_LIMIT (1024 * 1024 * 256)
-#endif
-
 class WriteJob : public QObject {
     Q_OBJECT
 public:
-    explicit WriteJob(const QString &what, const QString &where, const QString &md5_arg);
+    explicit WriteJob(const QString &what, const QString &where, const QString &md5_arg, const QStringList &options);
 
     static int staticOnMediaCheckAdvanced(void *data, long long offset, long long total);
     int onMediaCheckAdvanced(long long offset, long long total);
@@ -52,6 +54,16 @@ public:
     bool write(int fd);
     bool writeCompressed(int fd);
     bool writePlain(int fd);
+    bool writeSparse(int fd);
+    bool writeBmap(int fd);
+    bool writeMapped(int fd, const char *data, const qint64 len);
+    qint64 writeBuffer(int fd, const void *buffer, const qint64 len);
+    bool writeWithRetry(int fd, const void *buffer, const qint64 len);
+    bool verifyTail(int fd, QFile *file, const qint64 offset);
+    bool verifyXzBlock(int fd, QFile *file, const XzIndex &index, const int block_index);
+    bool flushWritten(int fd);
+    qint64 startJournal(int fd);
+    bool verifyWritten(int fd);
     bool check(int fd);
 public slots:
     void work();
@@ -64,6 +76,38 @@ private:
     QString md5;
     QDBusUnixFileDescriptor fd;
     QFileSystemWatcher watcher;
+    ImageFormat format;
+
+    // In bmap mode, only ranges listed in the block map
+    // of the image are written
+    bool bmapMode;
+    Bmap bmap;
+    int bmapRange;
+    qint64 bmapOffset;
+    std::unique_ptr<QCryptographicHash> bmapHash;
+
+    // In sparse mode, only partition tables and used
+    // blocks of filesystems are written
+    bool sparseMode;
+
+    // In delta mode, device contents are compared to
+    // the image and only blocks that differ are written
+    bool deltaMode;
+    qint64 writeOffset;
+    QCryptographicHash writtenHash;
+
+    // Written data is flushed to the drive every time
+    // this many bytes were written since last flush
+    qint64 flushInterval;
+    qint64 flushedOffset;
+
+    WriteTuner tuner;
+
+    // With resume, writing continues from where an
+    // interrupted write of the same image stopped
+    bool resumeMode;
+    bool journalEnabled;
+    WriteJournal journal;
 };
 
 #endif // WRITEJOB_H
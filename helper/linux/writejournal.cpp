@@ -0,0 +1,135 @@
+/*
+ * ALT Media Writer
+ * Copyright (C) 2016-2019 Martin Bříza <mbriza@redhat.com>
+ * Copyright (C) 2020-2022 Dmitry Degtyarev <kevl@basealt.ru>
+ *
+ * ALT Media Writer is a fork of Fedora Media Writer
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "writejournal.h"
+
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+
+#include <linux/fs.h>
+#include <stdio.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+
+QString write_journal_path(const QString &image_path) {
+    return image_path + ".journal";
+}
+
+WriteJournal write_journal_create(const QString &image_path, const QString &device, const QString &drive_id, const int device_fd, bool *ok) {
+    WriteJournal out;
+    out.device = device;
+    out.driveId = drive_id;
+    out.deviceSize = 0;
+    out.imageSize = 0;
+    out.imageModified = 0;
+    out.written = 0;
+
+    struct stat info;
+    const int stat_result = stat(QFile::encodeName(image_path).constData(), &info);
+    if (stat_result != 0) {
+        *ok = false;
+
+        return out;
+    }
+    out.imageSize = info.st_size;
+    out.imageModified = (qint64) info.st_mtim.tv_sec * 1000000000LL + info.st_mtim.tv_nsec;
+
+    // NOTE: device path alone is not enough, a different
+    // drive can get the same path after replugging. Drive
+    // id tells apart drives of the same model and size.
+    quint64 device_size = 0;
+    const int ioctl_result = ioctl(device_fd, BLKGETSIZE64, &device_size);
+    if (ioctl_result != 0) {
+        *ok = false;
+
+        return out;
+    }
+    out.deviceSize = device_size;
+
+    *ok = true;
+
+    return out;
+}
+
+bool write_journal_load(const QString &image_path, WriteJournal *journal) {
+    QFile file(write_journal_path(image_path));
+    const bool open_success = file.open(QIODevice::ReadOnly);
+    if (!open_success) {
+        return false;
+    }
+
+    const QJsonObject json = QJsonDocument::fromJson(file.readAll()).object();
+    if (!json.contains("written")) {
+        return false;
+    }
+
+    // NOTE: 64bit values are stored as strings because
+    // json numbers are doubles
+    journal->device = json["device"].toString();
+    journal->driveId = json["driveId"].toString();
+    journal->deviceSize = json["deviceSize"].toString().toLongLong();
+    journal->imageSize = json["imageSize"].toString().toLongLong();
+    journal->imageModified = json["imageModified"].toString().toLongLong();
+    journal->written = json["written"].toString().toLongLong();
+
+    return true;
+}
+
+bool write_journal_save(const QString &image_path, const WriteJournal &journal) {
+    QJsonObject json;
+    json["device"] = journal.device;
+    json["driveId"] = journal.driveId;
+    json["deviceSize"] = QString::number(journal.deviceSize);
+    json["imageSize"] = QString::number(journal.imageSize);
+    json["imageModified"] = QString::number(journal.imageModified);
+    json["written"] = QString::number(journal.written);
+
+    // NOTE: journal is written to a temporary file first,
+    // so that an interruption doesn't leave half of it
+    const QString path = write_journal_path(image_path);
+    const QString temp_path = path + ".tmp";
+
+    QFile file(temp_path);
+    const bool open_success = file.open(QIODevice::WriteOnly | QIODevice::Truncate);
+    if (!open_success) {
+        return false;
+    }
+
+    const qint64 write_result = file.write(QJsonDocument(json).toJson());
+    file.close();
+    if (write_result == -1) {
+        QFile::remove(temp_path);
+
+        return false;
+    }
+
+    return (rename(QFile::encodeName(temp_path).constData(), QFile::encodeName(path).constData()) == 0);
+}
+
+void write_journal_remove(const QString &image_path) {
+    QFile::remove(write_journal_path(image_path));
+}
+
+bool write_journal_matches(const WriteJournal &a, const WriteJournal &b) {
+    return (!a.driveId.isEmpty() && a.device == b.device && a.driveId == b.driveId && a.deviceSize == b.deviceSize && a.imageSize == b.imageSize && a.imageModified == b.imageModified);
+}
@@ -0,0 +1,64 @@
+/*
+ * ALT Media Writer
+ * Copyright (C) 2016-2019 Martin Bříza <mbriza@redhat.com>
+ * Copyright (C) 2020-2022 Dmitry Degtyarev <kevl@basealt.ru>
+ *
+ * ALT Media Writer is a fork of Fedora Media Writer
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef WRITEJOURNAL_H
+#define WRITEJOURNAL_H
+
+/**
+ * Write journal is a sidecar file stored next to the
+ * image (as "<image>.journal") while it's being written.
+ * It records how much of the image is known to be on the
+ * drive, together with the identity of the image and the
+ * drive. If writing is interrupted, the next write of the
+ * same image to the same drive can continue from there.
+ */
+
+#include <QString>
+
+struct WriteJournal {
+    QString device;
+    // Serial number of the drive, see udisks_drive_id()
+    QString driveId;
+    qint64 deviceSize;
+    qint64 imageSize;
+    qint64 imageModified;
+
+    // Amount of uncompressed image data that was flushed
+    // to the drive
+    qint64 written;
+};
+
+QString write_journal_path(const QString &image_path);
+
+// Journal for current state of the image and device, with
+// nothing written
+WriteJournal write_journal_create(const QString &image_path, const QString &device, const QString &drive_id, const int device_fd, bool *ok);
+
+bool write_journal_load(const QString &image_path, WriteJournal *journal);
+bool write_journal_save(const QString &image_path, const WriteJournal &journal);
+void write_journal_remove(const QString &image_path);
+
+// Returns true if both journals are for the same image
+// and drive. Drives without an id never match.
+bool write_journal_matches(const WriteJournal &a, const WriteJournal &b);
+
+#endif // WRITEJOURNAL_H
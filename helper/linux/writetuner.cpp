@@ -0,0 +1,100 @@
+/*
+ * ALT Media Writer
+ * Copyright (C) 2016-2019 Martin Bříza <mbriza@redhat.com>
+ * Copyright (C) 2020-2022 Dmitry Degtyarev <kevl@basealt.ru>
+ *
+ * ALT Media Writer is a fork of Fedora Media Writer
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "writetuner.h"
+
+// NOTE: each size is tried for long enough to not be
+// affected by timing noise
+const size_t WRITE_TUNER_TRIAL_BYTES = 16 * 1024 * 1024;
+
+// NOTE: speed usually goes up with chunk size and then
+// levels off, so stop trying larger sizes once speed
+// drops noticeably below the best one
+const double WRITE_TUNER_GIVE_UP_RATIO = 0.8;
+
+WriteTuner::WriteTuner() {
+    for (size_t size = WRITE_TUNER_MIN_CHUNK; size <= WRITE_TUNER_MAX_CHUNK; size *= 2) {
+        candidates.append(size);
+    }
+
+    current = 0;
+    currentBytes = 0;
+    currentNsecs = 0;
+    bestChunk = candidates.first();
+    bestSpeed = 0;
+    tuned = false;
+}
+
+size_t WriteTuner::chunkSize() const {
+    if (tuned) {
+        return bestChunk;
+    } else {
+        return candidates[current];
+    }
+}
+
+bool WriteTuner::isTuned() const {
+    return tuned;
+}
+
+bool WriteTuner::addSample(const size_t bytes, const qint64 nsecs) {
+    if (tuned) {
+        return false;
+    }
+
+    currentBytes += bytes;
+    currentNsecs += nsecs;
+
+    const size_t trial_bytes = qMax(WRITE_TUNER_TRIAL_BYTES, 2 * candidates[current]);
+    if (currentBytes < trial_bytes) {
+        return false;
+    }
+
+    finishCandidate();
+
+    return tuned;
+}
+
+void WriteTuner::fix(const size_t chunk_size) {
+    bestChunk = chunk_size;
+    tuned = true;
+}
+
+void WriteTuner::finishCandidate() {
+    const double speed = (double) currentBytes / qMax(currentNsecs, (qint64) 1);
+
+    if (speed > bestSpeed) {
+        bestSpeed = speed;
+        bestChunk = candidates[current];
+    }
+
+    const bool give_up = (speed < bestSpeed * WRITE_TUNER_GIVE_UP_RATIO);
+    const bool last_candidate = (current == candidates.size() - 1);
+
+    if (give_up || last_candidate) {
+        tuned = true;
+    } else {
+        current++;
+        currentBytes = 0;
+        currentNsecs = 0;
+    }
+}
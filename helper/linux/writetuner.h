@@ -0,0 +1,63 @@
+/*
+ * ALT Media Writer
+ * Copyright (C) 2016-2019 Martin Bříza <mbriza@redhat.com>
+ * Copyright (C) 2020-2022 Dmitry Degtyarev <kevl@basealt.ru>
+ *
+ * ALT Media Writer is a fork of Fedora Media Writer
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef WRITETUNER_H
+#define WRITETUNER_H
+
+#include <QList>
+#include <QtGlobal>
+
+#include <cstddef>
+
+const size_t WRITE_TUNER_MIN_CHUNK = 256 * 1024;
+const size_t WRITE_TUNER_MAX_CHUNK = 64 * 1024 * 1024;
+
+// Picks the chunk size for writing to the device. Drives
+// are fastest at different write sizes, so at the start
+// of writing, each size is tried in turn and the fastest
+// one is used for the rest of writing.
+class WriteTuner {
+public:
+    WriteTuner();
+
+    size_t chunkSize() const;
+    bool isTuned() const;
+
+    // Returns true when tuning has just finished
+    bool addSample(const size_t bytes, const qint64 nsecs);
+
+    // Stops tuning and uses the given chunk size
+    void fix(const size_t chunk_size);
+
+private:
+    QList<size_t> candidates;
+    int current;
+    size_t currentBytes;
+    qint64 currentNsecs;
+    size_t bestChunk;
+    double bestSpeed;
+    bool tuned;
+
+    void finishCandidate();
+};
+
+#endif // WRITETUNER_H
@@ -0,0 +1,242 @@
+/*
+ * ALT Media Writer
+ * Copyright (C) 2016-2019 Martin Bříza <mbriza@redhat.com>
+ * Copyright (C) 2020-2022 Dmitry Degtyarev <kevl@basealt.ru>
+ *
+ * ALT Media Writer is a fork of Fedora Media Writer
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "xzindex.h"
+#include "streamdecoder.h"
+
+#include <cstdlib>
+#include <cstring>
+
+// Decodes blocks one by one, without the stream header
+class XzBlocksDecoder : public StreamDecoder {
+public:
+    XzBlocksDecoder(const lzma_check check);
+    ~XzBlocksDecoder();
+
+    bool init() override;
+    DecodeResult decode(const uint8_t **in, size_t *in_size, uint8_t **out, size_t *out_size, const bool finish) override;
+
+private:
+    lzma_check check;
+    lzma_stream strm;
+    lzma_block block;
+    bool inBlock;
+    uint8_t header[LZMA_BLOCK_HEADER_SIZE_MAX];
+    size_t headerSize;
+    size_t headerRead;
+
+    DecodeResult startBlock();
+};
+
+bool xz_index_read(QFile *file, XzIndex *out) {
+    const qint64 file_size = file->size();
+    if (file_size < 2 * LZMA_STREAM_HEADER_SIZE) {
+        return false;
+    }
+
+    file->seek(0);
+    const QByteArray header = file->read(LZMA_STREAM_HEADER_SIZE);
+    file->seek(file_size - LZMA_STREAM_HEADER_SIZE);
+    const QByteArray footer = file->read(LZMA_STREAM_HEADER_SIZE);
+    if (header.size() != LZMA_STREAM_HEADER_SIZE || footer.size() != LZMA_STREAM_HEADER_SIZE) {
+        return false;
+    }
+
+    lzma_stream_flags header_flags;
+    lzma_stream_flags footer_flags;
+    const bool flags_valid = (lzma_stream_header_decode(&header_flags, (const uint8_t *) header.constData()) == LZMA_OK
+        && lzma_stream_footer_decode(&footer_flags, (const uint8_t *) footer.constData()) == LZMA_OK
+        && lzma_stream_flags_compare(&header_flags, &footer_flags) == LZMA_OK);
+    if (!flags_valid) {
+        return false;
+    }
+
+    // NOTE: index is right before the footer and footer
+    // stores its size
+    const qint64 index_size = footer_flags.backward_size;
+    const qint64 index_offset = file_size - LZMA_STREAM_HEADER_SIZE - index_size;
+    if (index_offset < LZMA_STREAM_HEADER_SIZE) {
+        return false;
+    }
+
+    file->seek(index_offset);
+    const QByteArray index_data = file->read(index_size);
+    if (index_data.size() != index_size) {
+        return false;
+    }
+
+    lzma_index *index = nullptr;
+    uint64_t memlimit = UINT64_MAX;
+    size_t in_pos = 0;
+    const lzma_ret index_ret = lzma_index_buffer_decode(&index, &memlimit, nullptr, (const uint8_t *) index_data.constData(), &in_pos, index_data.size());
+    if (index_ret != LZMA_OK) {
+        return false;
+    }
+
+    // NOTE: if there are multiple streams, this index
+    // only covers the last one
+    const bool single_stream = ((qint64) lzma_index_stream_size(index) == file_size);
+    if (!single_stream) {
+        lzma_index_end(index, nullptr);
+        return false;
+    }
+
+    out->check = header_flags.check;
+    out->blocks.clear();
+
+    lzma_index_iter iter;
+    lzma_index_iter_init(&iter, index);
+    while (!lzma_index_iter_next(&iter, LZMA_INDEX_ITER_BLOCK)) {
+        XzBlock block;
+        block.compressedOffset = iter.block.compressed_file_offset;
+        block.uncompressedOffset = iter.block.uncompressed_file_offset;
+        block.uncompressedSize = iter.block.uncompressed_size;
+
+        out->blocks.append(block);
+    }
+
+    lzma_index_end(index, nullptr);
+
+    return true;
+}
+
+int xz_index_find_block(const XzIndex &index, const qint64 uncompressed_offset, const qint64 alignment) {
+    for (int i = index.blocks.size() - 1; i >= 0; i--) {
+        const XzBlock &block = index.blocks[i];
+        if (block.uncompressedOffset <= uncompressed_offset && block.uncompressedOffset % alignment == 0) {
+            return i;
+        }
+    }
+
+    return 0;
+}
+
+StreamDecoder *xz_index_decoder(const XzIndex &index) {
+    return new XzBlocksDecoder(index.check);
+}
+
+XzBlocksDecoder::XzBlocksDecoder(const lzma_check check_arg) {
+    const lzma_stream strm_init = LZMA_STREAM_INIT;
+    strm = strm_init;
+    check = check_arg;
+    inBlock = false;
+    headerSize = 0;
+    headerRead = 0;
+}
+
+XzBlocksDecoder::~XzBlocksDecoder() {
+    lzma_end(&strm);
+}
+
+bool XzBlocksDecoder::init() {
+    return true;
+}
+
+DecodeResult XzBlocksDecoder::decode(const uint8_t **in, size_t *in_size, uint8_t **out, size_t *out_size, const bool finish) {
+    if (!inBlock) {
+        // NOTE: header size is stored in its first byte,
+        // 0 means that this is the index and there are
+        // no more blocks
+        if (headerRead == 0 && *in_size > 0) {
+            if (**in == 0x00) {
+                return DecodeResult_END;
+            }
+            headerSize = lzma_block_header_size_decode(**in);
+        }
+
+        const size_t header_chunk = qMin(*in_size, headerSize - headerRead);
+        memcpy(header + headerRead, *in, header_chunk);
+        headerRead += header_chunk;
+        *in += header_chunk;
+        *in_size -= header_chunk;
+
+        if (headerRead < headerSize || headerRead == 0) {
+            if (finish && *in_size == 0) {
+                return DecodeResult_CORRUPTED;
+            } else {
+                return DecodeResult_OK;
+            }
+        }
+
+        return startBlock();
+    }
+
+    strm.next_in = *in;
+    strm.avail_in = *in_size;
+    strm.next_out = *out;
+    strm.avail_out = *out_size;
+
+    const lzma_ret ret = lzma_code(&strm, finish ? LZMA_FINISH : LZMA_RUN);
+
+    *in = strm.next_in;
+    *in_size = strm.avail_in;
+    *out = strm.next_out;
+    *out_size = strm.avail_out;
+
+    switch (ret) {
+        case LZMA_OK: return DecodeResult_OK;
+        case LZMA_STREAM_END: {
+            inBlock = false;
+            headerSize = 0;
+            headerRead = 0;
+
+            return DecodeResult_OK;
+        }
+        case LZMA_MEM_ERROR: return DecodeResult_MEMORY_ERROR;
+        case LZMA_FORMAT_ERROR:
+        case LZMA_DATA_ERROR:
+        case LZMA_BUF_ERROR: return DecodeResult_CORRUPTED;
+        case LZMA_OPTIONS_ERROR: return DecodeResult_UNSUPPORTED;
+        default: return DecodeResult_ERROR;
+    }
+}
+
+DecodeResult XzBlocksDecoder::startBlock() {
+    // NOTE: block decoder keeps a pointer to block
+    // options, so they can't be local
+    lzma_filter filters[LZMA_FILTERS_MAX + 1];
+    memset(&block, 0, sizeof(block));
+    block.version = 1;
+    block.check = check;
+    block.filters = filters;
+    block.header_size = headerSize;
+
+    const lzma_ret header_ret = lzma_block_header_decode(&block, nullptr, header);
+    if (header_ret != LZMA_OK) {
+        return DecodeResult_CORRUPTED;
+    }
+
+    const lzma_ret init_ret = lzma_block_decoder(&strm, &block);
+
+    // NOTE: decoder makes its own copy of filter options
+    for (int i = 0; filters[i].id != LZMA_VLI_UNKNOWN; i++) {
+        free(filters[i].options);
+    }
+
+    if (init_ret != LZMA_OK) {
+        return DecodeResult_MEMORY_ERROR;
+    }
+
+    inBlock = true;
+
+    return DecodeResult_OK;
+}
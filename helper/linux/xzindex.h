@@ -0,0 +1,62 @@
+/*
+ * ALT Media Writer
+ * Copyright (C) 2016-2019 Martin Bříza <mbriza@redhat.com>
+ * Copyright (C) 2020-2022 Dmitry Degtyarev <kevl@basealt.ru>
+ *
+ * ALT Media Writer is a fork of Fedora Media Writer
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef XZINDEX_H
+#define XZINDEX_H
+
+#include <QFile>
+#include <QList>
+
+#include <lzma.h>
+
+class StreamDecoder;
+
+// xz files made by multi-threaded xz consist of many
+// independent blocks. The index at the end of the file
+// lists where each block starts, so decoding can start
+// from any block instead of the beginning.
+
+struct XzBlock {
+    qint64 compressedOffset;
+    qint64 uncompressedOffset;
+    qint64 uncompressedSize;
+};
+
+struct XzIndex {
+    lzma_check check;
+    QList<XzBlock> blocks;
+};
+
+// Reads block index of the file. Only files with one
+// stream are supported, which is what xz creates.
+bool xz_index_read(QFile *file, XzIndex *index);
+
+// Returns index of the last block that starts at or
+// before the offset in uncompressed data, at a multiple
+// of alignment
+int xz_index_find_block(const XzIndex &index, const qint64 uncompressed_offset, const qint64 alignment);
+
+// Returns decoder for consecutive blocks of the file,
+// input should start at the beginning of a block
+StreamDecoder *xz_index_decoder(const XzIndex &index);
+
+#endif // XZINDEX_H
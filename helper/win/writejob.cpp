@@ -35,6 +35,7 @@
 
 #include <lzma.h>
 
+#include "imageformat/imageformat.h"
 #include "isomd5/libcheckisomd5.h"
 
 const int BLOCK_SIZE = 512 * 128;
@@ -273,7 +274,7 @@ bool WriteJob::write() {
         return false;
     }
 
-    if (what.endsWith(".xz")) {
+    if (image_format_from_file(what) == ImageFormat_XZ) {
         return writeCompressed(drive);
     } else {
         return writePlain(drive);
@@ -471,7 +472,7 @@ bool WriteJob::check() {
     QTextStream out(stdout);
     QTextStream err(stdout);
 
-    if (what.endsWith(".xz")) {
+    if (image_format_from_file(what) == ImageFormat_XZ) {
         out << "NOT CHECKING BECAUSE IMAGE IS ZIPPED\n";
         out << "DONE\n";
         out.flush();
@@ -0,0 +1,99 @@
+/*
+ * ALT Media Writer
+ * Copyright (C) 2016-2019 Martin Bříza <mbriza@redhat.com>
+ * Copyright (C) 2020-2022 Dmitry Degtyarev <kevl@basealt.ru>
+ *
+ * ALT Media Writer is a fork of Fedora Media Writer
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "imageformat.h"
+
+#include <QFile>
+#include <QList>
+
+struct ImageFormatMagic {
+    ImageFormat format;
+    int offset;
+    QByteArray magic;
+};
+
+ImageFormat image_format_from_header(const QByteArray &header) {
+    // NOTE: order matters, compressed formats go first.
+    // Hybrid ISO images also have an MBR, so ISO9660 has
+    // to be checked before MBR. Images for drives with
+    // 4096 byte sectors have GPT header at 4096.
+    static const QList<ImageFormatMagic> magics = {
+        {ImageFormat_XZ, 0, QByteArray("\xFD" "7zXZ\x00", 6)},
+        {ImageFormat_GZIP, 0, QByteArray("\x1F\x8B", 2)},
+        {ImageFormat_ZSTD, 0, QByteArray("\x28\xB5\x2F\xFD", 4)},
+        {ImageFormat_BZIP2, 0, QByteArray("BZh", 3)},
+        {ImageFormat_ISO9660, 32769, QByteArray("CD001", 5)},
+        {ImageFormat_GPT, 512, QByteArray("EFI PART", 8)},
+        {ImageFormat_GPT, 4096, QByteArray("EFI PART", 8)},
+        {ImageFormat_MBR, 510, QByteArray("\x55\xAA", 2)},
+    };
+
+    for (const ImageFormatMagic &magic : magics) {
+        const QByteArray actual = header.mid(magic.offset, magic.magic.size());
+
+        if (actual == magic.magic) {
+            return magic.format;
+        }
+    }
+
+    return ImageFormat_UNKNOWN;
+}
+
+ImageFormat image_format_from_file(const QString &path) {
+    QFile file(path);
+    const bool open_success = file.open(QIODevice::ReadOnly);
+    if (!open_success) {
+        return ImageFormat_UNKNOWN;
+    }
+
+    const QByteArray header = file.read(IMAGE_FORMAT_HEADER_SIZE);
+
+    return image_format_from_header(header);
+}
+
+bool image_format_is_compressed(const ImageFormat format) {
+    switch (format) {
+        case ImageFormat_XZ: return true;
+        case ImageFormat_GZIP: return true;
+        case ImageFormat_ZSTD: return true;
+        case ImageFormat_BZIP2: return true;
+        case ImageFormat_ISO9660: return false;
+        case ImageFormat_GPT: return false;
+        case ImageFormat_MBR: return false;
+        case ImageFormat_UNKNOWN: return false;
+    }
+    return false;
+}
+
+QString image_format_name(const ImageFormat format) {
+    switch (format) {
+        case ImageFormat_XZ: return "xz";
+        case ImageFormat_GZIP: return "gzip";
+        case ImageFormat_ZSTD: return "zstd";
+        case ImageFormat_BZIP2: return "bzip2";
+        case ImageFormat_ISO9660: return "iso9660";
+        case ImageFormat_GPT: return "gpt";
+        case ImageFormat_MBR: return "mbr";
+        case ImageFormat_UNKNOWN: return "unknown";
+    }
+    return QString();
+}
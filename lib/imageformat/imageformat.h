@@ -0,0 +1,52 @@
+/*
+ * ALT Media Writer
+ * Copyright (C) 2016-2019 Martin Bříza <mbriza@redhat.com>
+ * Copyright (C) 2020-2022 Dmitry Degtyarev <kevl@basealt.ru>
+ *
+ * ALT Media Writer is a fork of Fedora Media Writer
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef IMAGEFORMAT_H
+#define IMAGEFORMAT_H
+
+#include <QByteArray>
+#include <QString>
+
+// Format of image contents, detected from the first
+// bytes of the file, so that it doesn't matter how the
+// file is named. Shared by the app and the helper.
+enum ImageFormat {
+    ImageFormat_XZ,
+    ImageFormat_GZIP,
+    ImageFormat_ZSTD,
+    ImageFormat_BZIP2,
+    ImageFormat_ISO9660,
+    ImageFormat_GPT,
+    ImageFormat_MBR,
+    ImageFormat_UNKNOWN,
+};
+
+// NOTE: ISO9660 signature is the furthest from the start
+// of the file, at 32769
+const int IMAGE_FORMAT_HEADER_SIZE = 36 * 1024;
+
+ImageFormat image_format_from_header(const QByteArray &header);
+ImageFormat image_format_from_file(const QString &path);
+bool image_format_is_compressed(const ImageFormat format);
+QString image_format_name(const ImageFormat format);
+
+#endif // IMAGEFORMAT_H
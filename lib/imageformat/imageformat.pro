@@ -0,0 +1,13 @@
+TEMPLATE = lib
+
+CONFIG += staticlib
+
+QT += core
+
+DESTDIR = ../
+
+HEADERS += imageformat.h
+
+SOURCES += imageformat.cpp
+
+QMAKE_MACOSX_DEPLOYMENT_TARGET = 10.9
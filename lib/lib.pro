@@ -1,3 +1,3 @@
 TEMPLATE = subdirs
 
-SUBDIRS = isomd5
+SUBDIRS = isomd5 imageformat
@@ -1,6 +1,7 @@
 TEMPLATE = subdirs
 
-SUBDIRS = lib app helper
+SUBDIRS = lib app helper bench
 
 app.depends = lib
 helper.depends = lib
+bench.depends = lib